@@ -22,6 +22,22 @@
 #include <iomanip>
 #include <vector>
 #include <stdlib.h>
+#include <utility>
+
+#include "allocation_counter.h"
+#include "memory_usage.h"
+#include "parallel_loader.h"
+#include "setup_arena.h"
+
+// Spike's AddSynapseGroup takes its own copy of the pairwise vectors, so the
+// parameter struct's copies are released as soon as a group has been added
+void release_pairwise_connectivity(
+    voltage_spiking_synapse_parameters_struct* SYN_PARAMS){
+  std::vector<int>().swap(SYN_PARAMS->pairwise_connect_presynaptic);
+  std::vector<int>().swap(SYN_PARAMS->pairwise_connect_postsynaptic);
+  std::vector<float>().swap(SYN_PARAMS->pairwise_connect_weight);
+  std::vector<float>().swap(SYN_PARAMS->pairwise_connect_delay);
+}
 
 void connect_with_sparsity(
     int input_layer,
@@ -41,6 +57,8 @@ void connect_with_sparsity(
     sparseness*num_pre_neurons;
   
   std::vector<int> prevec, postvec;
+  prevec.reserve(num_post_neurons*num_syns_per_post);
+  postvec.reserve(num_post_neurons*num_syns_per_post);
   for (int outid = 0; outid < num_post_neurons; outid++){
     for (int inid = 0; inid < num_syns_per_post; inid++){
       postvec.push_back(outid);
@@ -48,67 +66,89 @@ void connect_with_sparsity(
     }
   }
 
-  SYN_PARAMS->pairwise_connect_presynaptic = prevec;
-  SYN_PARAMS->pairwise_connect_postsynaptic = postvec;
+  SYN_PARAMS->pairwise_connect_presynaptic = std::move(prevec);
+  SYN_PARAMS->pairwise_connect_postsynaptic = std::move(postvec);
   SYN_PARAMS->connectivity_type = CONNECTIVITY_TYPE_PAIRWISE;
 
   Model->AddSynapseGroup(input_layer, output_layer, SYN_PARAMS);
+  release_pairwise_connectivity(SYN_PARAMS);
+
+}
+
+// Hands loaded connectivity over to Spike without an intermediate copy. Every
+// synapse in the group shares delay_range[0], so no per-synapse delay vector is
+// passed and Spike fills the delays in from the range
+int add_pairwise_synapse_group(
+    int layer1,
+    int layer2,
+    voltage_spiking_synapse_parameters_struct* SYN_PARAMS,
+    BenchUtils::PairwiseConnectivity&& connectivity,
+    SpikingModel* Model){
+  SYN_PARAMS->pairwise_connect_presynaptic = std::move(connectivity.pre);
+  SYN_PARAMS->pairwise_connect_postsynaptic = std::move(connectivity.post);
+  SYN_PARAMS->pairwise_connect_weight = std::move(connectivity.weight);
+  SYN_PARAMS->connectivity_type = CONNECTIVITY_TYPE_PAIRWISE;
+  int synapse_group_index = Model->AddSynapseGroup(layer1, layer2, SYN_PARAMS);
+  release_pairwise_connectivity(SYN_PARAMS);
+  return(synapse_group_index);
+}
 
+// Reads and decodes all of the given connectivity files concurrently.
+// Results come back in the order the files were given
+std::vector<BenchUtils::PairwiseConnectivity> load_connectivity(
+    const std::vector<std::string>& filenames){
+  try {
+    return(BenchUtils::loadWmatPairwiseConcurrently(filenames));
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    exit(-1);
+  }
 }
-int connect_from_mat(
+
+// Adds one synapse group per delay class. Synapse s (counting from line 2 of the
+// file, after the size line) has delay delay_range[0] - ((s + 2) % numskipgroups)
+// timesteps, so each class is a group with a single delay rather than every
+// synapse carrying its own. Returns the index of each group in class order
+std::vector<int> connect_from_mat(
     int layer1,
     int layer2,
     voltage_spiking_synapse_parameters_struct* SYN_PARAMS, 
-    std::string filename,
+    BenchUtils::PairwiseConnectivity&& connectivity,
     SpikingModel* Model,
     float timestep,
     int numskipgroups=1){
-  int synapse_group_index = -1;
+  std::vector<int> synapse_group_indices;
+  if (numskipgroups <= 1){
+    synapse_group_indices.push_back(
+      add_pairwise_synapse_group(layer1, layer2, SYN_PARAMS, std::move(connectivity), Model));
+    return(synapse_group_indices);
+  }
 
-  ifstream weightfile;
-  string line;
-  stringstream ss;
-  std::vector<int> prevec, postvec;
-  std::vector<float> weightvec;
-  std::vector<float> delayvec;
-  int pre, post;
-  float weight;
-  int linecount = 0;
-  weightfile.open(filename.c_str());
-
-  if (weightfile.is_open()){
-    printf("Loading weights from mat file: %s\n", filename.c_str());
-    while (getline(weightfile, line)){
-      if (line.c_str()[0] == '%'){
-        continue;
-      } else {
-        linecount++;
-        if (linecount == 1) continue;
-        //printf("%s\n", line.c_str());
-        ss.clear();
-        ss << line;
-        ss >> pre >> post >> weight;
-        prevec.push_back(pre - 1);
-        postvec.push_back(post - 1);
-        weightvec.push_back(weight);
-        delayvec.push_back(SYN_PARAMS->delay_range[0] - (linecount % numskipgroups)*timestep);
-        //printf("%d\n", (linecount % numskipgroups));
-
-        //printf("%d, %d, %f\n", pre, post, weight);
+  const float delay_range[2] = {SYN_PARAMS->delay_range[0], SYN_PARAMS->delay_range[1]};
+  for (int c = 0; c < numskipgroups; c++){
+    BenchUtils::PairwiseConnectivity classConnectivity;
+    classConnectivity.numPre = connectivity.numPre;
+    classConnectivity.numPost = connectivity.numPost;
+    const size_t numClassSynapses = (connectivity.getNumSynapses() + numskipgroups - 1) / numskipgroups;
+    classConnectivity.pre.reserve(numClassSynapses);
+    classConnectivity.post.reserve(numClassSynapses);
+    classConnectivity.weight.reserve(numClassSynapses);
+    for (size_t s = 0; s < connectivity.getNumSynapses(); s++){
+      if ((int)((s + 2) % numskipgroups) == c){
+        classConnectivity.pre.push_back(connectivity.pre[s]);
+        classConnectivity.post.push_back(connectivity.post[s]);
+        classConnectivity.weight.push_back(connectivity.weight[s]);
       }
     }
-    SYN_PARAMS->pairwise_connect_presynaptic = prevec;
-    SYN_PARAMS->pairwise_connect_postsynaptic = postvec;
-    SYN_PARAMS->pairwise_connect_weight = weightvec;
-    SYN_PARAMS->pairwise_connect_delay = delayvec;
-    SYN_PARAMS->connectivity_type = CONNECTIVITY_TYPE_PAIRWISE;
-    synapse_group_index = Model->AddSynapseGroup(layer1, layer2, SYN_PARAMS);
-  } else {
-    printf("Could not find weight matrices for loading! Have you created these as instructed in the README.md??\n");
-    exit(-1);
-  }
 
-  return(synapse_group_index);
+    SYN_PARAMS->delay_range[0] = delay_range[0] - c*timestep;
+    SYN_PARAMS->delay_range[1] = delay_range[0] - c*timestep;
+    synapse_group_indices.push_back(
+      add_pairwise_synapse_group(layer1, layer2, SYN_PARAMS, std::move(classConnectivity), Model));
+  }
+  SYN_PARAMS->delay_range[0] = delay_range[0];
+  SYN_PARAMS->delay_range[1] = delay_range[1];
+  return(synapse_group_indices);
 }
 
 
@@ -127,7 +167,10 @@ int main (int argc, char *argv[]){
     {"fast", 0, nullptr, 1},
     {"plastic", 0, nullptr, 4},
     {"NOTG", 0, nullptr, 5},
-    {"num_synapse_groups", 1, nullptr, 6}
+    {"num_synapse_groups", 1, nullptr, 6},
+    {"checkpoint", 1, nullptr, 7},
+    {"restore", 1, nullptr, 8},
+    {nullptr, 0, nullptr, 0}
   };
   // Check the set of options
   while (true) {
@@ -157,9 +200,24 @@ int main (int argc, char *argv[]){
         printf("Number of synapse groups; %s\n", optarg);
         numsyngroups = std::stoi(optarg);
         break;
+      case 7:
+      case 8:
+        // Spike has no interface to read or write its dynamic state, which
+        // lives in its backend's device arrays - only the weights can be
+        // saved (with --plastic) and reloaded
+        printf("Spike cannot checkpoint or restore this model: the membrane potentials, refractory state, "
+               "STDP traces, queued spikes and Poisson generator states are held by its backend\n");
+        return(-1);
     }
   };
   
+  BenchUtils::printMemoryUsage("Before setup");
+  const BenchUtils::AllocationCounts setupStart = BenchUtils::getAllocationCounts();
+
+  // Parameter structs are only read while the model is built, so they live
+  // in an arena which is released in one go once it has been finalised
+  BenchUtils::SetupArena setupArena;
+
   // TIMESTEP MUST BE SET BEFORE DATA IS IMPORTED. USED FOR ROUNDING.
   // The details below shall be used in a SpikingModel
   SpikingModel * BenchModel = new SpikingModel();
@@ -172,6 +230,7 @@ int main (int argc, char *argv[]){
   PoissonInputSpikingNeurons * poisson_input_spiking_neurons = new PoissonInputSpikingNeurons();
   VoltageSpikingSynapses * voltage_spiking_synapses = new VoltageSpikingSynapses(42);
 
+  // The STDP rule keeps a pointer to its parameters for the whole run
   weightdependent_stdp_plasticity_parameters_struct * WDSTDP_PARAMS = new weightdependent_stdp_plasticity_parameters_struct;
   WDSTDP_PARAMS->a_plus = 1.0;
   WDSTDP_PARAMS->a_minus = 1.0;
@@ -201,8 +260,8 @@ int main (int argc, char *argv[]){
 
 
   // Set up Neuron Parameters
-  lif_spiking_neuron_parameters_struct * EXC_NEURON_PARAMS = new lif_spiking_neuron_parameters_struct();
-  lif_spiking_neuron_parameters_struct * INH_NEURON_PARAMS = new lif_spiking_neuron_parameters_struct();
+  lif_spiking_neuron_parameters_struct * EXC_NEURON_PARAMS = setupArena.make<lif_spiking_neuron_parameters_struct>();
+  lif_spiking_neuron_parameters_struct * INH_NEURON_PARAMS = setupArena.make<lif_spiking_neuron_parameters_struct>();
 
   EXC_NEURON_PARAMS->somatic_capacitance_Cm = 200.0f*pow(10.0, -12);  // pF
   INH_NEURON_PARAMS->somatic_capacitance_Cm = 200.0f*pow(10.0, -12);  // pF
@@ -229,7 +288,7 @@ int main (int argc, char *argv[]){
     Setting up INPUT NEURONS
   */
   // Creating an input neuron parameter structure
-  poisson_input_spiking_neuron_parameters_struct* input_neuron_params = new poisson_input_spiking_neuron_parameters_struct();
+  poisson_input_spiking_neuron_parameters_struct* input_neuron_params = setupArena.make<poisson_input_spiking_neuron_parameters_struct>();
   // Setting the dimensions of the input neuron layer
   input_neuron_params->group_shape[0] = 1;    // x-dimension of the input neuron layer
   input_neuron_params->group_shape[1] = 10000;    // y-dimension of the input neuron layer
@@ -253,9 +312,9 @@ int main (int argc, char *argv[]){
   /*
     Setting up SYNAPSES
   */
-  voltage_spiking_synapse_parameters_struct * EXC_OUT_SYN_PARAMS = new voltage_spiking_synapse_parameters_struct();
-  voltage_spiking_synapse_parameters_struct * INH_OUT_SYN_PARAMS = new voltage_spiking_synapse_parameters_struct();
-  voltage_spiking_synapse_parameters_struct * INPUT_SYN_PARAMS = new voltage_spiking_synapse_parameters_struct();
+  voltage_spiking_synapse_parameters_struct * EXC_OUT_SYN_PARAMS = setupArena.make<voltage_spiking_synapse_parameters_struct>();
+  voltage_spiking_synapse_parameters_struct * INH_OUT_SYN_PARAMS = setupArena.make<voltage_spiking_synapse_parameters_struct>();
+  voltage_spiking_synapse_parameters_struct * INPUT_SYN_PARAMS = setupArena.make<voltage_spiking_synapse_parameters_struct>();
   // Setting delays
   EXC_OUT_SYN_PARAMS->delay_range[0] = delayval;
   EXC_OUT_SYN_PARAMS->delay_range[1] = delayval;
@@ -283,22 +342,26 @@ int main (int argc, char *argv[]){
   INPUT_SYN_PARAMS->weight_scaling_constant = weight_multiplier;
 
 
+  // The four projections are loaded together, then added in a fixed order
+  std::vector<BenchUtils::PairwiseConnectivity> connectivity = load_connectivity(
+    {"../../ie.wmat", "../../ii.wmat", "../../ei.wmat", "../../ee.wmat"});
+
   connect_from_mat(
     INHIBITORY_NEURONS[0], EXCITATORY_NEURONS[0],
     INH_OUT_SYN_PARAMS, 
-    "../../ie.wmat",
+    std::move(connectivity[0]),
     BenchModel,
     timestep);
   connect_from_mat(
     INHIBITORY_NEURONS[0], INHIBITORY_NEURONS[0],
     INH_OUT_SYN_PARAMS, 
-    "../../ii.wmat",
+    std::move(connectivity[1]),
     BenchModel,
     timestep);
   connect_from_mat(
     EXCITATORY_NEURONS[0], INHIBITORY_NEURONS[0],
     EXC_OUT_SYN_PARAMS, 
-    "../../ei.wmat",
+    std::move(connectivity[2]),
     BenchModel,
     timestep);
 
@@ -317,10 +380,10 @@ int main (int argc, char *argv[]){
     EXC_OUT_SYN_PARAMS->plasticity_vec.push_back(weightdependent_stdp);
 
 
-  int ee_syns = connect_from_mat(
+  std::vector<int> ee_syns = connect_from_mat(
     EXCITATORY_NEURONS[0], EXCITATORY_NEURONS[0],
     EXC_OUT_SYN_PARAMS, 
-    "../../ee.wmat",
+    std::move(connectivity[3]),
     BenchModel,
     timestep,
     numsyngroups);
@@ -366,6 +429,10 @@ int main (int argc, char *argv[]){
     COMPLETE NETWORK SETUP
   */
   BenchModel->finalise_model();
+  BenchUtils::printAllocationCounts("Setup", setupStart);
+  setupArena.printStats("Setup");
+  setupArena.release();
+  BenchUtils::printMemoryUsage("After setup");
   if (no_TG)
     BenchModel->timestep_grouping = 1;
 
@@ -380,8 +447,14 @@ int main (int argc, char *argv[]){
     timefile.close();
   }
   // Dump the weights if we are running in plasticity mode
-  if (plastic)
-    BenchModel->spiking_synapses->save_connectivity_as_binary("./", "BRUNELPLASTIC_", ee_syns);
+  if (plastic){
+    if (ee_syns.size() == 1)
+      BenchModel->spiking_synapses->save_connectivity_as_binary("./", "BRUNELPLASTIC_", ee_syns[0]);
+    else
+      for (size_t g = 0; g < ee_syns.size(); g++)
+        BenchModel->spiking_synapses->save_connectivity_as_binary(
+          "./", "BRUNELPLASTIC_" + std::to_string(g) + "_", ee_syns[g]);
+  }
   if (!fast){
     spike_monitor->save_spikes_as_binary("./", "BR");
     input_spike_monitor->save_spikes_as_binary("./", "INPUT_BR");
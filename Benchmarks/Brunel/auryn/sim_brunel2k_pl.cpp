@@ -37,6 +37,7 @@
  */
 
 #include "auryn.h"
+#include "mpi_perf_counters.h"
 
 using namespace auryn;
 
@@ -76,6 +77,7 @@ int main(int ac,char *av[]) {
   
   bool fast = false;
   bool plastic = false;
+  bool perf_counters = false;
 
   int errcode = 0;
 
@@ -88,6 +90,7 @@ int main(int ac,char *av[]) {
           ("simtime", po::value<double>(), "duration of simulation")
           ("fast", "turns off most monitoring to reduce IO")
           ("plastic", "turns on STDP")
+          ("perf_counters", "counts hardware events during the simulation")
           ("gamma", po::value<double>(), "gamma factor for inhibitory weight")
           ("lambda", po::value<double>(), "learning rate")
           ("nu", po::value<double>(), "the external firing rate nu")
@@ -155,6 +158,9 @@ int main(int ac,char *av[]) {
       if (vm.count("fast")) {
         fast = true;
       } 
+      if (vm.count("perf_counters")) {
+        perf_counters = true;
+      } 
       if (vm.count("plastic")) {
         plastic = true;
       } 
@@ -301,11 +307,25 @@ int main(int ac,char *av[]) {
   con_ie->sanity_check();
   con_ii->sanity_check();
 
+  // Unlike the CPU engine and GeNN runs, there is no step latency histogram:
+  // sys->run steps through the whole simulation internally, and running it a
+  // step at a time would add its per-call setup and progress reporting to
+  // every step being timed
   logger->msg("Simulating ..." ,PROGRESS,true);
+  BenchUtils::MPIPerfCounters counters;
+  if ( perf_counters )
+    counters.start();
   clock_t starttime = clock();
   if (!sys->run(simtime,true)) 
       errcode = 1;
   clock_t totaltime = clock() - starttime;
+  counters.stop();
+
+  // Auryn does not count the synaptic events it delivers, so only the
+  // totals and the metrics which do not need them are reported. Each rank
+  // prints its own counts and rank 0 writes their sum
+  if ( perf_counters )
+    counters.report((double)totaltime / CLOCKS_PER_SEC, "perfcounters.dat");
 
   if ( fast ){
     std::ofstream timefile;
@@ -0,0 +1,606 @@
+// Brunel 10,000 Neuron Network on the CPU engine
+//
+// Same network as the Spike and GeNN frontends - 10000 Poisson inputs driving
+// 8000 excitatory and 2000 inhibitory delta-synapse LIF neurons - with the
+// recurrent connectivity loaded from the Auryn .wmat files.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "allocation_counter.h"
+#include "huge_pages.h"
+#include "latency_histogram.h"
+#include "memory_usage.h"
+#include "neuron_mask.h"
+#include "parallel_loader.h"
+#include "perf_counters.h"
+#include "weight_file.h"
+#include "cpu/ensemble.h"
+#include "cpu/network.h"
+#include "cpu/pacer.h"
+#include "cpu/plastic_projection.h"
+#include "cpu/random_connectivity.h"
+#include "cpu/spike_recorder.h"
+#include "cpu/state_monitor.h"
+#include "cpu/weight_monitor.h"
+
+// Reads and decodes all of the given connectivity files concurrently.
+// Results come back in the order the files were given
+std::vector<BenchUtils::CSRConnectivity> load_connectivity(
+    const std::vector<std::string>& filenames){
+  try {
+    return(BenchUtils::loadWmatCSRConcurrently(filenames));
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    exit(-1);
+  }
+}
+
+// Adds the plastic E->E projection with the requested spike pairing scheme
+CPUEngine::PlasticProjectionBase* add_plastic_projection(
+    CPUEngine::Network& network,
+    CPUEngine::NeuronGroup& exc,
+    BenchUtils::CSRConnectivity&& csr,
+    unsigned int delay,
+    const CPUEngine::STDPParams& stdpParams,
+    double timestep,
+    const std::string& pairing){
+  if (pairing == CPUEngine::Pairing::AllToAll::getName())
+    return(&network.addProjection<CPUEngine::PlasticProjection<CPUEngine::Pairing::AllToAll>>(
+      exc, exc, 0, std::move(csr), delay, stdpParams, timestep));
+  else if (pairing == CPUEngine::Pairing::Nearest::getName())
+    return(&network.addProjection<CPUEngine::PlasticProjection<CPUEngine::Pairing::Nearest>>(
+      exc, exc, 0, std::move(csr), delay, stdpParams, timestep));
+  else if (pairing == CPUEngine::Pairing::PresynapticCentred::getName())
+    return(&network.addProjection<CPUEngine::PlasticProjection<CPUEngine::Pairing::PresynapticCentred>>(
+      exc, exc, 0, std::move(csr), delay, stdpParams, timestep));
+  else
+    throw std::runtime_error("Unknown pairing scheme '" + pairing + "' - use all_to_all, nearest or presynaptic_centred");
+}
+
+double milliseconds_since(std::chrono::steady_clock::time_point start){
+  return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
+
+// What each trial of an ensemble reports back to the parent process
+struct TrialResult
+{
+  double simulationTime;
+  unsigned long long numExcSpikes;
+  unsigned long long numPlasticEvents;
+};
+
+// The .wmat weights are in volts but the neurons work in mV
+void scale_weights(BenchUtils::CSRConnectivity& csr, float scale){
+  for (float& w : csr.weight)
+    w *= scale;
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  float simtime = 20.0;
+  float sparseness = 0.1;
+  bool fast = false;
+  bool plastic = false;
+  std::string pairing = CPUEngine::Pairing::AllToAll::getName();
+  float weight_interval = 0.0f;
+  std::string load_weights;
+  std::string checkpoint;
+  std::string restore;
+  unsigned int ensemble = 0;
+  unsigned int threads = 0;
+  std::string hugepages;
+  bool perf_counters = false;
+  double paced = 0.0;
+  unsigned int pace_batch = 1;
+  bool shed = false;
+  std::string spike_stream;
+  float state_interval = 0.0f;
+  std::string state_neurons = "first:50";
+  std::map<std::string, std::string> record_masks;
+  int numsyngroups = 1;
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"simtime", 1, nullptr, 0},
+    {"fast", 0, nullptr, 1},
+    {"plastic", 0, nullptr, 4},
+    {"pairing", 1, nullptr, 7},
+    {"weight_interval", 1, nullptr, 8},
+    {"load_weights", 1, nullptr, 9},
+    {"checkpoint", 1, nullptr, 10},
+    {"restore", 1, nullptr, 11},
+    {"ensemble", 1, nullptr, 12},
+    {"threads", 1, nullptr, 13},
+    {"hugepages", 1, nullptr, 14},
+    {"perf_counters", 0, nullptr, 15},
+    {"paced", 1, nullptr, 16},
+    {"pace_batch", 1, nullptr, 17},
+    {"shed", 0, nullptr, 18},
+    {"spike_stream", 1, nullptr, 19},
+    {"state_interval", 1, nullptr, 20},
+    {"state_neurons", 1, nullptr, 21},
+    {"record_mask", 1, nullptr, 22},
+    {"num_synapse_groups", 1, nullptr, 6},
+    {nullptr, 0, nullptr, 0}
+  };
+  // Check the set of options
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+
+    // If none
+    if (-1 == opt) break;
+
+    switch (opt){
+      case 0:
+        printf("Running with a simulation time of: %ss\n", optarg);
+        simtime = std::stof(optarg);
+        break;
+      case 1:
+        printf("Running in fast mode (no spike collection)\n");
+        fast = true;
+        break;
+      case 4:
+        printf("Running with plasticity ON\n");
+        plastic = true;
+        break;
+      case 6:
+        printf("Number of synapse groups; %s\n", optarg);
+        numsyngroups = std::stoi(optarg);
+        break;
+      case 7:
+        printf("STDP pairing scheme: %s\n", optarg);
+        pairing = optarg;
+        break;
+      case 8:
+        printf("Recording plastic weights every %sms\n", optarg);
+        weight_interval = std::stof(optarg);
+        break;
+      case 9:
+        printf("Starting from the plastic weights in %s\n", optarg);
+        load_weights = optarg;
+        break;
+      case 10:
+        printf("Saving a checkpoint of the final state to %s\n", optarg);
+        checkpoint = optarg;
+        break;
+      case 11:
+        printf("Restoring the network state from %s\n", optarg);
+        restore = optarg;
+        break;
+      case 12:
+        printf("Running an ensemble of %s trials\n", optarg);
+        ensemble = (unsigned int)std::stoul(optarg);
+        break;
+      case 13:
+        printf("Running on %s threads\n", optarg);
+        threads = (unsigned int)std::stoul(optarg);
+        break;
+      case 14:
+        printf("Huge pages for large arrays: %s\n", optarg);
+        hugepages = optarg;
+        break;
+      case 15:
+        printf("Collecting hardware performance counters\n");
+        perf_counters = true;
+        break;
+      case 16:
+        printf("Pacing the simulation at %s timesteps per real millisecond\n", optarg);
+        paced = std::stod(optarg);
+        break;
+      case 17:
+        printf("Waiting for the schedule every %s timesteps\n", optarg);
+        pace_batch = (unsigned int)std::stoul(optarg);
+        break;
+      case 18:
+        printf("Skipping recording on timesteps behind schedule\n");
+        shed = true;
+        break;
+      case 19:
+        printf("Publishing spikes to the shared-memory stream %s\n", optarg);
+        spike_stream = optarg;
+        break;
+      case 20:
+        printf("Recording neuron state every %sms\n", optarg);
+        state_interval = std::stof(optarg);
+        break;
+      case 21:
+        state_neurons = optarg;
+        break;
+      case 22:
+        printf("Recording spikes of the neurons in the mask %s\n", optarg);
+        try {
+          BenchUtils::addPopulationMask(optarg, record_masks);
+        } catch (const std::exception& e) {
+          printf("%s\n", e.what());
+          return(-1);
+        }
+        break;
+    }
+  };
+  if (pace_batch == 0){
+    printf("Pacing needs at least one timestep per batch\n");
+    return(-1);
+  }
+  if (numsyngroups < 1 || numsyngroups > 15){
+    printf("Number of synapse groups must be between 1 and the 15 timestep delay\n");
+    return(-1);
+  }
+  if (!load_weights.empty() && !plastic){
+    printf("Loading weights needs plasticity ON\n");
+    return(-1);
+  }
+  if (!load_weights.empty() && !restore.empty()){
+    printf("A checkpoint already holds the weights - use either --load_weights or --restore\n");
+    return(-1);
+  }
+  if (ensemble > 0 && threads > 0){
+    printf("Ensemble trials are forked processes - they cannot also run on several threads\n");
+    return(-1);
+  }
+  if (!spike_stream.empty() && (fast || ensemble > 0)){
+    printf("Spikes are streamed as they are recorded, by a single run - not with --fast or --ensemble\n");
+    return(-1);
+  }
+  if (plastic && numsyngroups != 1){
+    printf("Plasticity needs a uniform delay - use a single synapse group\n");
+    return(-1);
+  }
+  // Must be set before the connectivity is loaded
+  if (!hugepages.empty()){
+    try {
+      BenchUtils::setHugePageMode(BenchUtils::parseHugePageMode(hugepages));
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+
+  BenchUtils::printMemoryUsage("Before setup");
+  const BenchUtils::AllocationCounts setupStart = BenchUtils::getAllocationCounts();
+
+  const double timestep = 0.1;    // ms
+  const unsigned int delay = 15;  // 1.5ms in timesteps
+  CPUEngine::Network network(timestep);
+
+  const CPUEngine::LIFParams lifParams = {
+    20.0,   // tauM (ms)
+    0.0,    // vRest (mV)
+    0.0,    // vReset (mV)
+    20.0,   // vThresh (mV)
+    0.0,    // iOffset (mV)
+    2.0};   // tauRefrac (ms)
+
+  // Weight-dependent STDP on the excitatory recurrent synapses (weights in mV)
+  const CPUEngine::STDPParams stdpParams = {
+    20.0,   // tauPlus (ms)
+    20.0,   // tauMinus (ms)
+    1.0,    // aPlus
+    1.0,    // aMinus
+    0.0,    // wMin (mV)
+    0.3,    // wMax (mV)
+    0.01,   // lambda
+    2.02};  // alpha
+
+  auto& input = network.addGroup<CPUEngine::PoissonGroup>("P", 10000, 20.0, timestep, 42);
+  auto& exc = network.addGroup<CPUEngine::LIFDeltaGroup>("E", 8000, lifParams, timestep);
+  auto& inh = network.addGroup<CPUEngine::LIFDeltaGroup>("I", 2000, lifParams, timestep);
+
+  // The four projections are loaded together, then added in a fixed order
+  std::vector<BenchUtils::CSRConnectivity> connectivity = load_connectivity(
+    {"../../ie.wmat", "../../ii.wmat", "../../ei.wmat", "../../ee.wmat"});
+  for (auto& csr : connectivity)
+    scale_weights(csr, 1000.0f);
+  BenchUtils::printMemoryUsage("After loading");
+
+  CPUEngine::PlasticProjectionBase* ee = nullptr;
+  try {
+    network.addProjection<CPUEngine::Projection>(inh, exc, 0, std::move(connectivity[0]), delay);
+    network.addProjection<CPUEngine::Projection>(inh, inh, 0, std::move(connectivity[1]), delay);
+    network.addProjection<CPUEngine::Projection>(exc, inh, 0, std::move(connectivity[2]), delay);
+
+    // Poisson inputs - each neuron receives from a fixed number of randomly chosen sources
+    CPUEngine::Rng connectRng(1234);
+    const unsigned int numPerPost = (unsigned int)(sparseness*input.getSize());
+    network.addProjection<CPUEngine::Projection>(
+      input, exc, 0, CPUEngine::fixedNumberPreCSR(input.getSize(), exc.getSize(), numPerPost, 0.1f, connectRng), delay);
+    network.addProjection<CPUEngine::Projection>(
+      input, inh, 0, CPUEngine::fixedNumberPreCSR(input.getSize(), inh.getSize(), numPerPost, 0.1f, connectRng), delay);
+
+    // Excitatory recurrent synapses are split into delay classes as in the
+    // Spike frontend: synapse s has delay (delay - ((s + 2) % numsyngroups))
+    if (plastic){
+      ee = add_plastic_projection(network, exc, std::move(connectivity[3]), delay, stdpParams, timestep, pairing);
+    }
+    else if (numsyngroups == 1){
+      network.addProjection<CPUEngine::Projection>(exc, exc, 0, std::move(connectivity[3]), delay);
+    }
+    else {
+      std::vector<unsigned int> classDelays;
+      for (int c = 0; c < numsyngroups; c++)
+        classDelays.push_back(delay - c);
+      network.addProjection<CPUEngine::Projection>(
+        exc, exc, 0, std::move(connectivity[3]), classDelays,
+        [numsyngroups](size_t s){ return (unsigned int)((s + 2) % numsyngroups); });
+    }
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+  connectivity.clear();
+
+  // Resume from the weights saved by an earlier plastic run
+  if (!load_weights.empty()){
+    try {
+      const auto loadStart = std::chrono::steady_clock::now();
+      auto& weights = ee->getWeight();
+      BenchUtils::loadWeights(load_weights, weights.data(), weights.size(), ee->getConnectivityHash());
+      printf("Loaded %zu weights in %fms\n", weights.size(), milliseconds_since(loadStart));
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+
+  /*
+    COMPLETE NETWORK SETUP
+  */
+  network.finalise();
+  printf("Network has %zu synapses\n", network.getNumSynapses());
+
+  // Split the neurons, and the synapses onto them, between NUMA-local threads
+  if (threads > 0){
+    try {
+      network.partition(CPUEngine::makePartitions(threads));
+      network.printPartitions();
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+
+  // Continue from an earlier run's final state, e.g. after the initial transient
+  if (!restore.empty()){
+    try {
+      const auto restoreStart = std::chrono::steady_clock::now();
+      network.restoreCheckpoint(restore);
+      printf("Restored step %llu in %fms\n", network.getStep(), milliseconds_since(restoreStart));
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+  BenchUtils::printAllocationCounts("Setup", setupStart);
+  BenchUtils::printMemoryUsage("After setup");
+  if (!hugepages.empty())
+    BenchUtils::printHugePageUsage();
+
+  // Which neurons of each population E, I and P have their spikes recorded, and which of E and I their state
+  BenchUtils::NeuronMask excMask, inhMask, inputMask, excStateMask, inhStateMask;
+  try {
+    BenchUtils::checkPopulationMasks(record_masks, {"E", "I", "P"});
+    excMask = BenchUtils::getPopulationMask(record_masks, "E", exc.getSize());
+    inhMask = BenchUtils::getPopulationMask(record_masks, "I", inh.getSize());
+    inputMask = BenchUtils::getPopulationMask(record_masks, "P", input.getSize());
+    if (state_interval > 0.0f){
+      excStateMask = BenchUtils::NeuronMask(state_neurons, exc.getSize());
+      inhStateMask = BenchUtils::NeuronMask(state_neurons, inh.getSize());
+      if (excStateMask.getNumSelected() == 0 || inhStateMask.getNumSelected() == 0)
+        throw std::runtime_error("State neurons '" + state_neurons + "' select no neurons of a population");
+      printf("Recording the state of %u excitatory and %u inhibitory neurons\n",
+             excStateMask.getNumSelected(), inhStateMask.getNumSelected());
+    }
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+
+  // One run from the network's current state, writing its outputs to the working directory
+  auto simulate = [&]() -> TrialResult {
+    CPUEngine::SpikeRecorder excSpikes("exc_spikes.csv", exc, timestep);
+    CPUEngine::SpikeRecorder inhSpikes("inh_spikes.csv", inh, timestep);
+    CPUEngine::SpikeRecorder inputSpikes("pois_spikes.csv", input, timestep);
+    excSpikes.setMask(excMask);
+    inhSpikes.setMask(inhMask);
+    inputSpikes.setMask(inputMask);
+
+    // Live consumers, such as spike_stream/RateMonitor, see each step's spikes as they are recorded
+    std::unique_ptr<BenchUtils::SpikeStreamPublisher> stream;
+    if (!spike_stream.empty()){
+      stream.reset(new BenchUtils::SpikeStreamPublisher(spike_stream, {{"E", excMask.getNumSelected()}, {"I", inhMask.getNumSelected()},
+                                                                       {"P", inputMask.getNumSelected()}}, timestep));
+      excSpikes.setStream(*stream, 0);
+      inhSpikes.setStream(*stream, 1);
+      inputSpikes.setStream(*stream, 2);
+    }
+
+    // Snapshots of the plastic weights are encoded and written in the background
+    std::unique_ptr<CPUEngine::WeightMonitor> weightMonitor;
+    if (plastic && weight_interval > 0.0f){
+      const unsigned int intervalSteps = std::max(1u, (unsigned int)std::round(weight_interval / timestep));
+      weightMonitor.reset(new CPUEngine::WeightMonitor("Weights.wmon", *ee, timestep, intervalSteps));
+      weightMonitor->snapshot(network.getStep());
+    }
+
+    // Membrane potentials, and the STDP traces of the excitatory neurons, of the selected neurons of each population
+    std::unique_ptr<CPUEngine::StateMonitor> excState;
+    std::unique_ptr<CPUEngine::StateMonitor> inhState;
+    if (state_interval > 0.0f){
+      const unsigned int intervalSteps = std::max(1u, (unsigned int)std::round(state_interval / timestep));
+      std::vector<CPUEngine::StateVariable> excVariables = {CPUEngine::StateVariable::array("V", exc.getV().data())};
+      if (plastic){
+        excVariables.push_back(CPUEngine::StateVariable::trace("pre_trace", ee->getPreTrace()));
+        excVariables.push_back(CPUEngine::StateVariable::trace("post_trace", ee->getPostTrace()));
+      }
+      excState.reset(new CPUEngine::StateMonitor("exc_state.smon", excStateMask.getSelected(), excVariables, timestep, intervalSteps));
+      inhState.reset(new CPUEngine::StateMonitor("inh_state.smon", inhStateMask.getSelected(),
+                                                 {CPUEngine::StateVariable::array("V", inh.getV().data())},
+                                                 timestep, intervalSteps));
+      excState->sample(network.getStep());
+      inhState->sample(network.getStep());
+    }
+
+    TrialResult result = {0.0, 0, 0};
+    const unsigned long long numTimesteps = (unsigned long long)std::round(simtime * 1000.0 / timestep);
+    const unsigned long long endStep = network.getStep() + numTimesteps;
+    BenchUtils::PerfCounters counters;
+    const uint64_t startSynapticEvents = network.getNumSynapticEvents();
+    CPUEngine::Instrumentation::reset();
+    if (perf_counters)
+      counters.start();
+    BenchUtils::LatencyHistogram stepLatency;
+    std::unique_ptr<CPUEngine::Pacer> pacer;
+    if (paced > 0.0)
+      pacer.reset(new CPUEngine::Pacer(paced, pace_batch, shed));
+    clock_t starttime = clock();
+    const auto wallStart = std::chrono::steady_clock::now();
+    auto stepStart = pacer ? pacer->start() : wallStart;
+    while (network.getStep() < endStep){
+      const unsigned long long t = network.getStep();
+      network.step();
+      result.numExcSpikes += exc.getSpikes().size();
+      const bool shedding = pacer && pacer->shouldShed();
+      if (!fast && !shedding){
+        excSpikes.record(t);
+        inhSpikes.record(t);
+        inputSpikes.record(t);
+      }
+      if (weightMonitor && !shedding)
+        weightMonitor->record(network.getStep());
+      if (excState && !shedding){
+        excState->record(network.getStep());
+        inhState->record(network.getStep());
+      }
+
+      // Each step is timed with its recording, which is where much of the jitter
+      // comes from, but not with any wait for the schedule
+      const auto stepEnd = std::chrono::steady_clock::now();
+      stepLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stepEnd - stepStart).count());
+      stepStart = pacer ? pacer->endStep(stepEnd) : stepEnd;
+    }
+    // CPU time would count every thread and miss the waits for the schedule, so
+    // threaded and paced runs are timed by the wall clock
+    clock_t totaltime = clock() - starttime;
+    counters.stop();
+    result.simulationTime = (threads > 0 || pacer) ? milliseconds_since(wallStart) / 1000.0 : (double)totaltime / CLOCKS_PER_SEC;
+    printf("Simulated %llu timesteps in %fs\n", numTimesteps, result.simulationTime);
+    stepLatency.printSteps("Step", timestep);
+    if (pacer){
+      pacer->print();
+      pacer->write("deadlines.dat");
+    }
+    CPUEngine::Instrumentation::printReport(result.simulationTime);
+    if (perf_counters){
+      const uint64_t synapticEvents = network.getNumSynapticEvents() - startSynapticEvents;
+      counters.print(result.simulationTime, synapticEvents);
+      counters.write("perfcounters.dat", result.simulationTime, synapticEvents);
+    }
+
+    // What the engine itself holds, then what the process as a whole used
+    CPUEngine::MemoryFootprint footprint = network.getMemoryFootprint();
+    excSpikes.addMemoryFootprint(footprint);
+    inhSpikes.addMemoryFootprint(footprint);
+    inputSpikes.addMemoryFootprint(footprint);
+    if (weightMonitor)
+      weightMonitor->addMemoryFootprint(footprint);
+    if (excState){
+      excState->addMemoryFootprint(footprint);
+      inhState->addMemoryFootprint(footprint);
+    }
+    footprint.print("Final", network.getNumNeurons(), network.getNumSynapses());
+    BenchUtils::printMemoryUsage("After simulation");
+    printf("Peak RSS: %.2f bytes per synapse\n", (double)BenchUtils::getPeakRSS() / (double)network.getNumSynapses());
+    if (weightMonitor){
+      if (endStep % weightMonitor->getIntervalSteps() != 0)
+        weightMonitor->snapshot(endStep);
+      printf("%llu weight snapshots, %llu waited for the writer\n",
+             weightMonitor->getNumSnapshots(), weightMonitor->getNumStalls());
+    }
+    if (excState){
+      printf("%llu state samples, %llu waited for the writer\n",
+             excState->getNumSamples() + inhState->getNumSamples(), excState->getNumStalls() + inhState->getNumStalls());
+    }
+    if (plastic){
+      result.numPlasticEvents = ee->getNumDepressions() + ee->getNumPotentiations();
+      printf("%llu plastic synaptic events (%llu depression, %llu potentiation) - %g events/s using %s kernels\n",
+             result.numPlasticEvents, ee->getNumDepressions(), ee->getNumPotentiations(),
+             (double)result.numPlasticEvents / result.simulationTime, CPUEngine::STDPKernels::getISA());
+      printf("%s pairing: %fs in plasticity, %g ns per plastic synaptic event\n",
+             ee->getPairingName(), ee->getPlasticityTime(), 1.0E9 * ee->getPlasticityTime() / (double)result.numPlasticEvents);
+    }
+    if (!checkpoint.empty()){
+      const auto checkpointStart = std::chrono::steady_clock::now();
+      network.saveCheckpoint(checkpoint);
+      printf("Saved checkpoint at step %llu in %fms\n", network.getStep(), milliseconds_since(checkpointStart));
+    }
+    if ( fast ){
+      std::ofstream timefile;
+      timefile.open("timefile.dat");
+      timefile << std::setprecision(10) << (float)result.simulationTime;
+      timefile.close();
+    }
+    // Dump the weights if we are running in plasticity mode, in the same
+    // row-major layout as the GeNN benchmark's Weights.bin
+    if (plastic){
+      const auto saveStart = std::chrono::steady_clock::now();
+      const auto& weights = ee->getWeight();
+      BenchUtils::saveWeights("./Weights.bin", weights.data(), weights.size(), ee->getConnectivityHash());
+      printf("Saved %zu weights in %fms\n", weights.size(), milliseconds_since(saveStart));
+    }
+    return(result);
+  };
+
+  try {
+    if (ensemble == 0){
+      simulate();
+      return(0);
+    }
+
+    // Every trial shares the network built above copy-on-write and differs
+    // only in its Poisson input. Trial 0 runs exactly as a single run would:
+    // from seed 42 or, after --restore, from the restored generator. The other
+    // trials reseed or, after --restore, branch onto their own stream from the
+    // restored position, so the checkpointed state is kept.
+    network.setConnectivityReadOnly(true);
+    CPUEngine::EnsembleMemory memory;
+    const std::vector<TrialResult> results = CPUEngine::runEnsemble<TrialResult>(
+      ensemble,
+      [&](unsigned int trial){
+        const std::string dir = "trial_" + std::to_string(trial);
+        if ((mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) || chdir(dir.c_str()) != 0)
+          throw std::runtime_error("Cannot create trial directory " + dir);
+        if (restore.empty())
+          input.setSeed(42 + trial);
+        else if (trial > 0)
+          input.setStream(trial);
+        return(simulate());
+      },
+      memory);
+
+    for (unsigned int trial = 0; trial < ensemble; trial++){
+      printf("Trial %u: %fs, excitatory rate %gHz, %llu plastic synaptic events\n", trial, results[trial].simulationTime,
+             (double)results[trial].numExcSpikes / (exc.getSize() * simtime), results[trial].numPlasticEvents);
+    }
+    const double mb = 1024.0 * 1024.0;
+    printf("Ensemble of %u trials: %f MB in total (PSS), %f MB private to each trial; "
+           "as separate processes the trials would need %f MB (sum of RSS)\n",
+           ensemble, memory.getTotalPSS() / mb, memory.trialsPrivate / (mb * ensemble), memory.trialsRSS / mb);
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+  return(0);
+}
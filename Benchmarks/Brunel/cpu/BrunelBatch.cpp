@@ -0,0 +1,225 @@
+// Brunel 10,000 Neuron Network, batched, on the CPU engine
+//
+// Simulates B instances of the Brunel10K network together, sharing one copy
+// of the connectivity (see cpu/batch.h). Instances can differ in the strength
+// of inhibition and the Poisson input rate, each spread evenly across the
+// batch, and always differ in their Poisson seeds (instance b uses 42 + b,
+// so with no spread instance 0 reproduces a static Brunel10K run).
+
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "memory_usage.h"
+#include "parallel_loader.h"
+#include "cpu/batch.h"
+#include "cpu/network.h"
+#include "cpu/random_connectivity.h"
+#include "cpu/spike_recorder.h"
+
+struct Range
+{
+  double lo;
+  double hi;
+
+  // Value for instance b of a batch of size n
+  double get(unsigned int b, unsigned int n) const{
+    return((n > 1) ? lo + (hi - lo) * (double)b / (double)(n - 1) : lo);
+  }
+};
+
+// Parses "LO:HI", or a single value for no spread
+Range parse_range(const std::string& s){
+  const size_t colon = s.find(':');
+  if (colon == std::string::npos)
+    return(Range{std::stod(s), std::stod(s)});
+  return(Range{std::stod(s.substr(0, colon)), std::stod(s.substr(colon + 1))});
+}
+
+template<unsigned int B>
+int run_batch(float simtime, bool fast, const Range& inhScale, const Range& inputRate){
+  BenchUtils::printMemoryUsage("Before setup");
+
+  const double timestep = 0.1;    // ms
+  const unsigned int delay = 15;  // 1.5ms in timesteps
+  const float sparseness = 0.1f;
+  CPUEngine::Network network(timestep);
+
+  const CPUEngine::LIFParams lifParams = {
+    20.0,   // tauM (ms)
+    0.0,    // vRest (mV)
+    0.0,    // vReset (mV)
+    20.0,   // vThresh (mV)
+    0.0,    // iOffset (mV)
+    2.0};   // tauRefrac (ms)
+
+  std::array<CPUEngine::LIFParams, B> instanceParams;
+  std::array<double, B> instanceRates;
+  std::array<uint64_t, B> instanceSeeds;
+  std::array<float, B> unitScale;
+  std::array<float, B> instanceInhScale;
+  for (unsigned int b = 0; b < B; b++){
+    instanceParams[b] = lifParams;
+    instanceRates[b] = inputRate.get(b, B);
+    instanceSeeds[b] = 42 + b;
+    unitScale[b] = 1.0f;
+    instanceInhScale[b] = (float)inhScale.get(b, B);
+    printf("Instance %u: Poisson input %gHz, inhibition scaled by %g\n", b, instanceRates[b], instanceInhScale[b]);
+  }
+
+  auto& input = network.addGroup<CPUEngine::BatchPoissonGroup<B>>("P", 10000, instanceRates, timestep, instanceSeeds);
+  auto& exc = network.addGroup<CPUEngine::BatchLIFDeltaGroup<B>>("E", 8000, instanceParams, timestep);
+  auto& inh = network.addGroup<CPUEngine::BatchLIFDeltaGroup<B>>("I", 2000, instanceParams, timestep);
+
+  // The four projections are loaded together, then added in a fixed order
+  std::vector<BenchUtils::CSRConnectivity> connectivity;
+  try {
+    connectivity = BenchUtils::loadWmatCSRConcurrently({"../../ie.wmat", "../../ii.wmat", "../../ei.wmat", "../../ee.wmat"});
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+
+  // The .wmat weights are in volts but the neurons work in mV
+  for (auto& csr : connectivity)
+    for (float& w : csr.weight)
+      w *= 1000.0f;
+
+  try {
+    network.addProjection<CPUEngine::BatchProjection<B>>(inh, exc, 0, std::move(connectivity[0]), delay, instanceInhScale);
+    network.addProjection<CPUEngine::BatchProjection<B>>(inh, inh, 0, std::move(connectivity[1]), delay, instanceInhScale);
+    network.addProjection<CPUEngine::BatchProjection<B>>(exc, inh, 0, std::move(connectivity[2]), delay, unitScale);
+
+    // Poisson inputs - drawn exactly as in Brunel10K so the connectivity matches
+    CPUEngine::Rng connectRng(1234);
+    const unsigned int numPerPost = (unsigned int)(sparseness*input.getSize());
+    network.addProjection<CPUEngine::BatchProjection<B>>(
+      input, exc, 0, CPUEngine::fixedNumberPreCSR(input.getSize(), exc.getSize(), numPerPost, 0.1f, connectRng), delay, unitScale);
+    network.addProjection<CPUEngine::BatchProjection<B>>(
+      input, inh, 0, CPUEngine::fixedNumberPreCSR(input.getSize(), inh.getSize(), numPerPost, 0.1f, connectRng), delay, unitScale);
+
+    network.addProjection<CPUEngine::BatchProjection<B>>(exc, exc, 0, std::move(connectivity[3]), delay, unitScale);
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+  connectivity.clear();
+
+  /*
+    COMPLETE NETWORK SETUP
+  */
+  network.finalise();
+  printf("Network has %zu synapses, shared by %u instances\n", network.getNumSynapses(), B);
+  BenchUtils::printMemoryUsage("After setup");
+
+  // One set of spike files per instance
+  std::vector<std::unique_ptr<CPUEngine::SpikeRecorder>> recorders;
+  if (!fast){
+    for (unsigned int b = 0; b < B; b++){
+      const std::string suffix = "_" + std::to_string(b) + ".csv";
+      recorders.emplace_back(new CPUEngine::SpikeRecorder("exc_spikes" + suffix, exc.getInstanceSpikes(b), timestep));
+      recorders.emplace_back(new CPUEngine::SpikeRecorder("inh_spikes" + suffix, inh.getInstanceSpikes(b), timestep));
+      recorders.emplace_back(new CPUEngine::SpikeRecorder("pois_spikes" + suffix, input.getInstanceSpikes(b), timestep));
+    }
+  }
+
+  std::array<unsigned long long, B> numExcSpikes = {};
+  const unsigned long long numTimesteps = (unsigned long long)std::round(simtime * 1000.0 / timestep);
+  CPUEngine::Instrumentation::reset();
+  clock_t starttime = clock();
+  for (unsigned long long t = 0; t < numTimesteps; t++){
+    network.step();
+    for (unsigned int b = 0; b < B; b++)
+      numExcSpikes[b] += exc.getInstanceSpikes(b).size();
+    for (auto& r : recorders)
+      r->record(t);
+  }
+  clock_t totaltime = clock() - starttime;
+  printf("Simulated %llu timesteps of %u instances in %fs (%fs per instance)\n",
+         numTimesteps, B, (float)totaltime / CLOCKS_PER_SEC, (float)totaltime / (CLOCKS_PER_SEC * B));
+  CPUEngine::Instrumentation::printReport((double)totaltime / CLOCKS_PER_SEC);
+  for (unsigned int b = 0; b < B; b++)
+    printf("Instance %u: excitatory rate %gHz\n", b, (double)numExcSpikes[b] / (exc.getSize() * simtime));
+
+  // Neurons are counted once per instance, synapses once as they are shared
+  CPUEngine::MemoryFootprint footprint = network.getMemoryFootprint();
+  for (const auto& r : recorders)
+    r->addMemoryFootprint(footprint);
+  footprint.print("Final", network.getNumNeurons() * B, network.getNumSynapses());
+  BenchUtils::printMemoryUsage("After simulation");
+
+  if ( fast ){
+    std::ofstream timefile;
+    timefile.open("timefile.dat");
+    timefile << std::setprecision(10) << ((float)totaltime / CLOCKS_PER_SEC);
+    timefile.close();
+  }
+  return(0);
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  float simtime = 20.0;
+  bool fast = false;
+  unsigned int batch = 8;
+  Range inhScale = {1.0, 1.0};
+  Range inputRate = {20.0, 20.0};
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"simtime", 1, nullptr, 0},
+    {"fast", 0, nullptr, 1},
+    {"batch", 1, nullptr, 2},
+    {"inh_scale", 1, nullptr, 3},
+    {"input_rate", 1, nullptr, 4},
+    {nullptr, 0, nullptr, 0}
+  };
+  // Check the set of options
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+
+    // If none
+    if (-1 == opt) break;
+
+    switch (opt){
+      case 0:
+        printf("Running with a simulation time of: %ss\n", optarg);
+        simtime = std::stof(optarg);
+        break;
+      case 1:
+        printf("Running in fast mode (no spike collection)\n");
+        fast = true;
+        break;
+      case 2:
+        printf("Batch size: %s\n", optarg);
+        batch = (unsigned int)std::stoul(optarg);
+        break;
+      case 3:
+        printf("Inhibitory weight scale: %s\n", optarg);
+        inhScale = parse_range(optarg);
+        break;
+      case 4:
+        printf("Poisson input rate: %sHz\n", optarg);
+        inputRate = parse_range(optarg);
+        break;
+    }
+  };
+
+  // Batch sizes are compiled in so the per-instance loops vectorise
+  switch (batch){
+    case 1: return(run_batch<1>(simtime, fast, inhScale, inputRate));
+    case 4: return(run_batch<4>(simtime, fast, inhScale, inputRate));
+    case 8: return(run_batch<8>(simtime, fast, inhScale, inputRate));
+    case 16: return(run_batch<16>(simtime, fast, inhScale, inputRate));
+    default:
+      printf("Batch size must be 1, 4, 8 or 16\n");
+      return(-1);
+  }
+}
@@ -0,0 +1,152 @@
+// Checks the SIMD STDP weight update kernels against the scalar rule and
+// measures their throughput in plastic synaptic events per second.
+//
+// Rows and columns are shaped like the Brunel E->E projection: 8000 neurons
+// with rows of up to 884 synapses. Both versions start from the same weights
+// and traces and must leave bitwise identical weights, including where
+// updates clamp to Wmin or Wmax.
+
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "cpu/rng.h"
+#include "cpu/stdp_kernels.h"
+
+using namespace CPUEngine;
+
+// Row lengths cover every SIMD tail as well as the longest Brunel rows
+const std::vector<size_t> lengths = {0, 1, 7, 8, 9, 15, 16, 17, 31, 33, 100, 800, 884};
+
+struct Problem
+{
+  std::vector<float> weight;
+  std::vector<unsigned int> ind;    // row: postsynaptic index of each synapse
+  std::vector<unsigned int> syn;    // column: distinct synapse slots
+  std::vector<unsigned int> pre;    // column: presynaptic index of each slot
+  std::vector<float> trace;
+};
+
+// Weights spread over [Wmin, Wmax] and traces large enough that some updates clamp
+Problem make_problem(size_t numNeurons, size_t numSynapses, float wMax, Rng& rng){
+  Problem p;
+  p.weight.resize(numSynapses);
+  p.ind.resize(numSynapses);
+  p.trace.resize(numNeurons);
+  for (size_t s = 0; s < numSynapses; s++){
+    p.weight[s] = wMax * (float)rng.uniform();
+    p.ind[s] = rng.uniformInt((unsigned int)numNeurons);
+  }
+  for (float& t : p.trace)
+    t = 100.0f * (float)rng.uniform() * (float)rng.uniform() * (float)rng.uniform();
+
+  // A random permutation of the slots stands in for a column of the transposed index
+  p.syn.resize(numSynapses);
+  p.pre.resize(numSynapses);
+  for (size_t s = 0; s < numSynapses; s++)
+    p.syn[s] = (unsigned int)s;
+  for (size_t s = numSynapses; s > 1; s--)
+    std::swap(p.syn[s - 1], p.syn[rng.uniformInt((unsigned int)s)]);
+  for (size_t s = 0; s < numSynapses; s++)
+    p.pre[s] = rng.uniformInt((unsigned int)numNeurons);
+  return(p);
+}
+
+bool check_depression(const Problem& p, float depression, float wMin){
+  for (size_t n : lengths){
+    if (n > p.weight.size())
+      continue;
+    std::vector<float> scalar(p.weight), simd(p.weight);
+    STDPKernels::depressRowScalar(scalar.data(), p.ind.data(), n, p.trace.data(), depression, wMin);
+    STDPKernels::depressRow(simd.data(), p.ind.data(), n, p.trace.data(), depression, wMin);
+    if (memcmp(scalar.data(), simd.data(), scalar.size() * sizeof(float)) != 0){
+      printf("Depression kernel differs from scalar rule for row of %zu synapses\n", n);
+      return(false);
+    }
+  }
+  return(true);
+}
+
+bool check_potentiation(const Problem& p, float lambda, float wMax){
+  for (size_t n : lengths){
+    if (n > p.weight.size())
+      continue;
+    std::vector<float> scalar(p.weight), simd(p.weight);
+    STDPKernels::potentiateColumnScalar(scalar.data(), p.syn.data(), p.pre.data(), n, p.trace.data(), lambda, wMax);
+    STDPKernels::potentiateColumn(simd.data(), p.syn.data(), p.pre.data(), n, p.trace.data(), lambda, wMax);
+    if (memcmp(scalar.data(), simd.data(), scalar.size() * sizeof(float)) != 0){
+      printf("Potentiation kernel differs from scalar rule for column of %zu synapses\n", n);
+      return(false);
+    }
+  }
+  return(true);
+}
+
+double seconds_since(clock_t start){
+  return((double)(clock() - start) / CLOCKS_PER_SEC);
+}
+
+// Applies a kernel to consecutive rows of rowLength until every synapse has been
+// updated numPasses times and returns the events per second
+template<typename Kernel>
+double measure(size_t numSynapses, size_t rowLength, unsigned int numPasses, Kernel kernel){
+  const clock_t start = clock();
+  for (unsigned int p = 0; p < numPasses; p++)
+    for (size_t s = 0; s + rowLength <= numSynapses; s += rowLength)
+      kernel(s, rowLength);
+  return((double)numPasses * (double)(numSynapses - numSynapses % rowLength) / seconds_since(start));
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  int numPasses = 20;
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"passes", 1, nullptr, 0},
+    {nullptr, 0, nullptr, 0}
+  };
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+    if (-1 == opt) break;
+    if (opt == 0)
+      numPasses = std::stoi(optarg);
+  };
+
+  // Brunel parameters, with weights in mV
+  const float wMin = 0.0f;
+  const float wMax = 0.3f;
+  const float lambda = 0.01f;
+  const float depression = lambda * 2.02f;
+
+  Rng rng(42);
+  printf("SIMD kernels: %s\n", STDPKernels::getISA());
+  for (int trial = 0; trial < 100; trial++){
+    const Problem p = make_problem(8000, 1000, wMax, rng);
+    if (!check_depression(p, depression, wMin) || !check_potentiation(p, lambda, wMax))
+      return(-1);
+  }
+  printf("SIMD kernels match the scalar rule bitwise\n");
+
+  // Throughput over a whole Brunel-sized E->E projection
+  const size_t numSynapses = 8000 * 800;
+  const size_t rowLength = 800;
+  Problem p = make_problem(8000, numSynapses, wMax, rng);
+  for (float& t : p.trace)
+    t *= 0.01f;
+
+  const double scalarDepression = measure(numSynapses, rowLength, numPasses, [&](size_t s, size_t n){
+    STDPKernels::depressRowScalar(&p.weight[s], &p.ind[s], n, p.trace.data(), depression, wMin); });
+  const double simdDepression = measure(numSynapses, rowLength, numPasses, [&](size_t s, size_t n){
+    STDPKernels::depressRow(&p.weight[s], &p.ind[s], n, p.trace.data(), depression, wMin); });
+  const double scalarPotentiation = measure(numSynapses, rowLength, numPasses, [&](size_t s, size_t n){
+    STDPKernels::potentiateColumnScalar(p.weight.data(), &p.syn[s], &p.pre[s], n, p.trace.data(), lambda, wMax); });
+  const double simdPotentiation = measure(numSynapses, rowLength, numPasses, [&](size_t s, size_t n){
+    STDPKernels::potentiateColumn(p.weight.data(), &p.syn[s], &p.pre[s], n, p.trace.data(), lambda, wMax); });
+
+  printf("Depression:   scalar %g events/s, %s %g events/s\n", scalarDepression, STDPKernels::getISA(), simdDepression);
+  printf("Potentiation: scalar %g events/s, %s %g events/s\n", scalarPotentiation, STDPKernels::getISA(), simdPotentiation);
+  return(0);
+}
@@ -0,0 +1,21 @@
+# Make a Build directory
+mkdir -p Build
+cd ./Build
+
+# Now run cmake init
+cmake ../
+
+# Finally compile the example
+make Brunel10K -j8
+
+# The batched version, for parameter sweeps
+make BrunelBatch -j8
+
+# And the check and throughput measurement for the SIMD STDP kernels
+make STDPKernels -j8
+
+# In order to run the model;
+# Ensure you are in the Build folder, and run the compiled file
+# ./Brunel10K --simtime 100.0 --fast
+# ./BrunelBatch --simtime 100.0 --fast --batch 8 --inh_scale 0.5:1.5
+# ./STDPKernels
@@ -2,7 +2,8 @@
 # You must ensure that GeNN has been installed correctly
 
 # First, allow the code generation;
-genn-buildmodel.sh model.cc 
+# (the connectivity files must exist at this point as they determine the maximum row lengths)
+genn-buildmodel.sh -i ../../common model.cc 
 
 # Finally compile the example
 make -j8
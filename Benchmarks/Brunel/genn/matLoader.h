@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "sparseProjection.h"
+#include "parallel_loader.h"
 
 void reset_array(
     float* array,
@@ -34,61 +35,27 @@ void random_connectivity(
   }
 };
 
-void ragged_connectivity_from_mat(
-    std::string filename,
+void ragged_connectivity_from_csr(
+    const std::string& filename,
+    const BenchUtils::CSRConnectivity& csr,
     unsigned int* ind,
     unsigned int* rowLength,
     unsigned int numPre,
-    unsigned int maxRows)
+    unsigned int maxRowLength)
 {
-
-  ifstream weightfile;
-  string line;
-  stringstream ss;
-  std::vector<int> prevec, postvec;
-  std::vector<float> weightvec;
-  int pre, post;
-  float weight;
-  int linecount = 0;
-  weightfile.open(filename.c_str());
-
-  if (weightfile.is_open()){
-    printf("Loading weights from mat file: %s\n", filename.c_str());
-    while (getline(weightfile, line)){
-      if (line.c_str()[0] == '%'){
-        continue;
-      } else {
-        linecount++;
-        if (linecount == 1) continue;
-        //printf("%s\n", line.c_str());
-        ss.clear();
-        ss << line;
-        ss >> pre >> post >> weight;
-        prevec.push_back(pre - 1);
-        postvec.push_back(post - 1);
-        weightvec.push_back(weight);
-        //printf("%d, %d, %f\n", pre, post, weight);
-      }
-    }
+  if (csr.numPre != numPre){
+    printf("%s has %u presynaptic neurons but the model expects %u\n", filename.c_str(), csr.numPre, numPre);
+    exit(-1);
   }
-
-  
-  std::vector<int> precount;
-  for (int pre = 0; pre < numPre; pre++)
-    precount.push_back(0);
-
-  // Placing loaded values into array
-  for (int indx = 0; indx < prevec.size(); indx++){
-    ind[prevec[indx]*maxRows + precount[prevec[indx]]] = postvec[indx];
-    precount[prevec[indx]]++;
-  }
-  int MaxRow = 0;
-  for (int pre = 0; pre < numPre; pre++){
-    rowLength[pre] = precount[pre];
-    if (precount[pre] > MaxRow)
-      MaxRow = precount[pre];
+  if (csr.maxRowLength > maxRowLength){
+    printf("%s has rows of length %u but the model was built for at most %u - rerun genn-buildmodel.sh\n",
+           filename.c_str(), csr.maxRowLength, maxRowLength);
+    exit(-1);
   }
-  printf("Number of Weights Loaded from %s; %d\n", filename.c_str(), weightvec.size());
-  printf("Max Row Length: %d\n", MaxRow);
 
+  // Copying each exact-length row into the padded ragged layout
+  for (unsigned int pre = 0; pre < numPre; pre++){
+    rowLength[pre] = csr.getRowLength(pre);
+    std::copy(csr.ind.begin() + csr.rowStart[pre], csr.ind.begin() + csr.rowStart[pre + 1], &ind[pre*maxRowLength]);
+  }
 };
@@ -11,6 +11,7 @@
 //#include "connectors.h"
 
 #include "parameters.h"
+#include "wmat_loader.h"
 
 void modelDefinition(NNmodel &model)
 {
@@ -120,28 +121,28 @@ void modelDefinition(NNmodel &model)
         stdp_params, stdp_ini,
         //{}, excs_ini, //Uncomment for no STDP
         {}, {});
-    ee->setMaxConnections(Parameters::EEMaxRow);
+    ee->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::eeConnectivity));
 
     auto *ei = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::DeltaCurr>(
         "EI", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "E", "I",
         {}, excs_ini,
         {}, {});
-    ei->setMaxConnections(Parameters::EIMaxRow);
+    ei->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::eiConnectivity));
 
     auto *ii = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::DeltaCurr>(
         "II", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "I", "I",
         {}, inhibs_ini,
         {}, {});
-    ii->setMaxConnections(Parameters::IIMaxRow);
+    ii->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::iiConnectivity));
 
     auto *ie = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::DeltaCurr>(
         "IE", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "I", "E",
         {}, inhibs_ini,
         {}, {});
-    ie->setMaxConnections(Parameters::IEMaxRow);
+    ie->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::ieConnectivity));
 
 
     // Configure spike variables so that they can be downloaded to host
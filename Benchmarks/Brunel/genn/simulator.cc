@@ -3,37 +3,183 @@
 
 // GeNN robotics includes
 //#include "common/timer.h"
-//#include "genn_utils/spike_csv_recorder.h"
 #include "timer.h"
-#include "spike_csv_recorder.h"
+#include "cpu/weight_monitor.h"
+#include "genn_utils/checkpoint.h"
+#include "genn_utils/spike_csv_recorder.h"
 
 // Model parameters
 #include "parameters.h"
 
 // Connectivity functions
+#include "latency_histogram.h"
 #include "matLoader.h"
+#include "memory_usage.h"
+#include "neuron_mask.h"
+#include "weight_file.h"
 
 // Auto-generated model code
 #include "brunel_benchmark_CODE/definitions.h"
 
+#ifndef CPU_ONLY
+#include <cuda_runtime.h>
+#endif
+
 #include <getopt.h>
+#include <chrono>
+#include <cmath>
+#include <memory>
 #include <time.h>
 #include <iomanip>
 #include <sstream>
 #include <stdio.h>
 #include <fstream>
+#include <map>
 
 using namespace BoBRobotics;
 
+// Populations with delayed outgoing synapses keep a spike queue of this many slots
+const unsigned int numDelaySlots = Parameters::synapticDelay + 1;
+
+// Compact the padded rows of the E->E weights into presynaptic-major order,
+// the order of weight files and weight monitor snapshots
+void get_ee_weights(std::vector<float> &weights)
+{
+    weights.clear();
+    for (unsigned int pre = 0; pre < Parameters::numExcitatory; pre++){
+      weights.insert(weights.end(), &gEE[pre*CEE.maxRowLength], &gEE[pre*CEE.maxRowLength + CEE.rowLength[pre]]);
+    }
+}
+
+// Checkpoints hold everything which evolves during a run: the time, the
+// neurons' variables, the Poisson sources' timers, the spikes waiting in each
+// population's delay queue, the synaptic input and the plastic E->E weights
+// and traces. The connectivity is rebuilt from the same files, which the E->E
+// hash checks. The Poisson sources' random number generators live inside
+// GeNN's generated code and are not saved, so a restored run draws fresh
+// Poisson spikes rather than those an uninterrupted run would have
+void save_checkpoint(const std::string &filename, uint64_t eeHash)
+{
+    pullPStateFromDevice();
+    pullEStateFromDevice();
+    pullIStateFromDevice();
+    pullPSpikesFromDevice();
+    pullESpikesFromDevice();
+    pullISpikesFromDevice();
+    pullPEStateFromDevice();
+    pullPIStateFromDevice();
+    pullEEStateFromDevice();
+    pullEIStateFromDevice();
+    pullIIStateFromDevice();
+    pullIEStateFromDevice();
+
+    CPUEngine::CheckpointWriter writer;
+    writer.beginSection("time");
+    writer.write(iT);
+    writer.write(t);
+    writer.beginSection("EE connectivity");
+    writer.write(eeHash);
+
+    GeNNUtils::saveArray(writer, "P timeStepToSpike", timeStepToSpikeP, Parameters::numPoisson);
+    GeNNUtils::saveArray(writer, "E V", VE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "E RefracTime", RefracTimeE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "I V", VI, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "I RefracTime", RefracTimeI, Parameters::numInhibitory);
+    GeNNUtils::saveSpikeQueue(writer, "P spikes", Parameters::numPoisson, numDelaySlots, spkQuePtrP, glbSpkCntP, glbSpkP);
+    GeNNUtils::saveSpikeQueue(writer, "E spikes", Parameters::numExcitatory, numDelaySlots, spkQuePtrE, glbSpkCntE, glbSpkE);
+    GeNNUtils::saveSpikeQueue(writer, "I spikes", Parameters::numInhibitory, numDelaySlots, spkQuePtrI, glbSpkCntI, glbSpkI);
+
+    GeNNUtils::saveArray(writer, "PE inSyn", inSynPE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "PI inSyn", inSynPI, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "EE inSyn", inSynEE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "EI inSyn", inSynEI, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "II inSyn", inSynII, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "IE inSyn", inSynIE, Parameters::numExcitatory);
+
+    const size_t numEE = (size_t)Parameters::numExcitatory * CEE.maxRowLength;
+    GeNNUtils::saveArray(writer, "EE g", gEE, numEE);
+    GeNNUtils::saveArray(writer, "EE pre_trace", pre_traceEE, numEE);
+    GeNNUtils::saveArray(writer, "EE post_trace", post_traceEE, numEE);
+    GeNNUtils::saveArray(writer, "EE t_preUpdate", t_preUpdateEE, numEE);
+    GeNNUtils::saveArray(writer, "EE t_postUpdate", t_postUpdateEE, numEE);
+    writer.save(filename);
+}
+
+//! Restore a checkpoint into a freshly initialised model with the same connectivity
+void restore_checkpoint(const std::string &filename, uint64_t eeHash)
+{
+    CPUEngine::CheckpointReader reader(filename);
+    reader.beginSection("time");
+    reader.read(iT);
+    reader.read(t);
+    reader.beginSection("EE connectivity");
+    uint64_t savedEEHash;
+    reader.read(savedEEHash);
+    if (savedEEHash != eeHash){
+      throw std::runtime_error("Checkpoint " + filename + " was saved with different E->E connectivity");
+    }
+
+    // The queues of a freshly initialised model start at slot 0 on the host and the device alike
+    GeNNUtils::restoreArray(reader, "P timeStepToSpike", timeStepToSpikeP, Parameters::numPoisson);
+    GeNNUtils::restoreArray(reader, "E V", VE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "E RefracTime", RefracTimeE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "I V", VI, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "I RefracTime", RefracTimeI, Parameters::numInhibitory);
+    GeNNUtils::restoreSpikeQueue(reader, "P spikes", Parameters::numPoisson, numDelaySlots, spkQuePtrP, glbSpkCntP, glbSpkP);
+    GeNNUtils::restoreSpikeQueue(reader, "E spikes", Parameters::numExcitatory, numDelaySlots, spkQuePtrE, glbSpkCntE, glbSpkE);
+    GeNNUtils::restoreSpikeQueue(reader, "I spikes", Parameters::numInhibitory, numDelaySlots, spkQuePtrI, glbSpkCntI, glbSpkI);
+
+    GeNNUtils::restoreArray(reader, "PE inSyn", inSynPE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "PI inSyn", inSynPI, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "EE inSyn", inSynEE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "EI inSyn", inSynEI, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "II inSyn", inSynII, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "IE inSyn", inSynIE, Parameters::numExcitatory);
+
+    const size_t numEE = (size_t)Parameters::numExcitatory * CEE.maxRowLength;
+    GeNNUtils::restoreArray(reader, "EE g", gEE, numEE);
+    GeNNUtils::restoreArray(reader, "EE pre_trace", pre_traceEE, numEE);
+    GeNNUtils::restoreArray(reader, "EE post_trace", post_traceEE, numEE);
+    GeNNUtils::restoreArray(reader, "EE t_preUpdate", t_preUpdateEE, numEE);
+    GeNNUtils::restoreArray(reader, "EE t_postUpdate", t_postUpdateEE, numEE);
+    reader.finish();
+
+    pushPStateToDevice();
+    pushEStateToDevice();
+    pushIStateToDevice();
+    pushPSpikesToDevice();
+    pushESpikesToDevice();
+    pushISpikesToDevice();
+    pushPEStateToDevice();
+    pushPIStateToDevice();
+    pushEEStateToDevice();
+    pushEIStateToDevice();
+    pushIIStateToDevice();
+    pushIEStateToDevice();
+}
+
 int main (int argc, char *argv[])
 {
     // Getting options:
     float simtime = 20.0;
     bool fast = false;
+    bool step_latency = false;
+    float weight_interval = 0.0f;
+    std::string load_weights;
+    std::string checkpoint;
+    std::string restore;
+    std::map<std::string, std::string> record_masks;
     const char* const short_opts = "";
     const option long_opts[] = {
       {"simtime", 1, nullptr, 0},
       {"fast", 0, nullptr, 1},
+      {"load_weights", 1, nullptr, 2},
+      {"record_mask", 1, nullptr, 3},
+      {"checkpoint", 1, nullptr, 4},
+      {"restore", 1, nullptr, 5},
+      {"step_latency", 0, nullptr, 6},
+      {"weight_interval", 1, nullptr, 7},
+      {nullptr, 0, nullptr, 0}
     };
     // Check the set of options
     while (true) {
@@ -51,10 +197,43 @@ int main (int argc, char *argv[])
           printf("Running in fast mode (no spike collection)\n");
           fast = true;
           break;
+        case 2:
+          printf("Starting from the plastic weights in %s\n", optarg);
+          load_weights = optarg;
+          break;
+        case 3:
+          printf("Recording spikes of the neurons in the mask %s\n", optarg);
+          try {
+            BenchUtils::addPopulationMask(optarg, record_masks);
+          } catch (const std::exception& e) {
+            printf("%s\n", e.what());
+            return -1;
+          }
+          break;
+        case 4:
+          printf("Saving a checkpoint to %s at the end of the run\n", optarg);
+          checkpoint = optarg;
+          break;
+        case 5:
+          printf("Restoring the checkpoint %s\n", optarg);
+          restore = optarg;
+          break;
+        case 6:
+          printf("Timing every step, waiting for the device at the end of each\n");
+          step_latency = true;
+          break;
+        case 7:
+          printf("Recording plastic weights every %sms\n", optarg);
+          weight_interval = std::stof(optarg);
+          break;
         default:
           break;
       }
     };
+    if (!load_weights.empty() && !restore.empty()){
+      printf("A checkpoint already holds the weights - use either --load_weights or --restore\n");
+      return -1;
+    }
     {
         Timer<> t("Allocation:");
         allocateMem();
@@ -65,6 +244,8 @@ int main (int argc, char *argv[])
         initialize();
     }
     
+    BenchUtils::printMemoryUsage("Before setup");
+
     // Loading Synapses
     {
         Timer<> t("Synapse setup:");
@@ -76,35 +257,119 @@ int main (int argc, char *argv[])
         pushPIStateToDevice();
 
 
-        ragged_connectivity_from_mat("../ee.wmat", CEE.ind, CEE.rowLength, Parameters::numExcitatory, Parameters::EEMaxRow);
+        // Decoding all four projections concurrently, then registering them in a fixed order
+        std::vector<BenchUtils::CSRConnectivity> csr;
+        try {
+          csr = BenchUtils::loadWmatCSRConcurrently(
+              {Parameters::eeConnectivity, Parameters::eiConnectivity, Parameters::iiConnectivity, Parameters::ieConnectivity});
+        } catch (const std::exception& e) {
+          printf("%s\n", e.what());
+          return -1;
+        }
+
+        ragged_connectivity_from_csr(Parameters::eeConnectivity, csr[0], CEE.ind, CEE.rowLength, Parameters::numExcitatory, CEE.maxRowLength);
         reset_array(inSynEE, Parameters::numExcitatory);
         pushEEStateToDevice();
 
-        ragged_connectivity_from_mat("../ei.wmat", CEI.ind, CEI.rowLength, Parameters::numExcitatory, Parameters::EIMaxRow);
+        ragged_connectivity_from_csr(Parameters::eiConnectivity, csr[1], CEI.ind, CEI.rowLength, Parameters::numExcitatory, CEI.maxRowLength);
         reset_array(inSynEI, Parameters::numInhibitory);
         pushEIStateToDevice();
 
-        ragged_connectivity_from_mat("../ii.wmat", CII.ind, CII.rowLength, Parameters::numInhibitory, Parameters::IIMaxRow);
+        ragged_connectivity_from_csr(Parameters::iiConnectivity, csr[2], CII.ind, CII.rowLength, Parameters::numInhibitory, CII.maxRowLength);
         reset_array(inSynII, Parameters::numInhibitory);
         pushIIStateToDevice();
 
-        ragged_connectivity_from_mat("../ie.wmat", CIE.ind, CIE.rowLength, Parameters::numInhibitory, Parameters::IEMaxRow);
+        ragged_connectivity_from_csr(Parameters::ieConnectivity, csr[3], CIE.ind, CIE.rowLength, Parameters::numInhibitory, CIE.maxRowLength);
         reset_array(inSynIE, Parameters::numExcitatory);
         pushIEStateToDevice();
     }
 
+    // Weight files are tagged with the E->E connectivity so they can only be applied to the same network
+    BenchUtils::ConnectivityHash eeHash(Parameters::numExcitatory, Parameters::numExcitatory);
+    size_t numEESynapses = 0;
+    for (unsigned int pre = 0; pre < Parameters::numExcitatory; pre++){
+      eeHash.addRow(&CEE.ind[pre*CEE.maxRowLength], CEE.rowLength[pre]);
+      numEESynapses += CEE.rowLength[pre];
+    }
+
     // Final setup
     {
         Timer<> t("Sparse init:");
         initbrunel_benchmark();
     }
 
+    // Resume from the weights saved by an earlier run, scattering the
+    // mapped rows straight into the padded ragged weight array
+    if (!load_weights.empty()){
+      Timer<> t("Weight loading:");
+      try {
+        const BenchUtils::MappedWeightFile weightfile(load_weights);
+        BenchUtils::checkWeightFile(weightfile, load_weights, numEESynapses, eeHash.getValue());
+        const float* weights = weightfile.getWeights();
+        for (unsigned int pre = 0; pre < Parameters::numExcitatory; pre++){
+          std::copy_n(weights, CEE.rowLength[pre], &gEE[pre*CEE.maxRowLength]);
+          weights += CEE.rowLength[pre];
+        }
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+      }
+      pushEEStateToDevice();
+    }
+
+    // Continue from the state saved at the end of an earlier run
+    if (!restore.empty()){
+      try {
+        Timer<> t("Restoring:");
+        restore_checkpoint(restore, eeHash.getValue());
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+      }
+      printf("Restored step %llu\n", iT);
+    }
+
+    BenchUtils::printMemoryUsage("After setup");
+
+    // Which neurons of each population E, I and P have their spikes recorded
+    BenchUtils::NeuronMask e_mask, i_mask, p_mask;
+    try {
+      BenchUtils::checkPopulationMasks(record_masks, {"E", "I", "P"});
+      e_mask = BenchUtils::getPopulationMask(record_masks, "E", 8000);
+      i_mask = BenchUtils::getPopulationMask(record_masks, "I", 2000);
+      p_mask = BenchUtils::getPopulationMask(record_masks, "P", 10000);
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return -1;
+    }
+
     // Open CSV output files
-    GeNNUtils::SpikeCSVRecorderDelay spikes("spikes.csv", 8000, spkQuePtrE, glbSpkCntE, glbSpkE);
-    GeNNUtils::SpikeCSVRecorderDelay i_spikes("inh_spikes.csv", 2000, spkQuePtrI, glbSpkCntI, glbSpkI);
-    GeNNUtils::SpikeCSVRecorderDelay p_spikes("pois_spikes.csv", 10000, spkQuePtrP, glbSpkCntP, glbSpkP);
+    GeNNUtils::SpikeCSVRecorderDelay spikes("spikes.csv", 8000, spkQuePtrE, glbSpkCntE, glbSpkE, e_mask);
+    GeNNUtils::SpikeCSVRecorderDelay i_spikes("inh_spikes.csv", 2000, spkQuePtrI, glbSpkCntI, glbSpkI, i_mask);
+    GeNNUtils::SpikeCSVRecorderDelay p_spikes("pois_spikes.csv", 10000, spkQuePtrP, glbSpkCntP, glbSpkP, p_mask);
+
+    // Spike times continue from a restored step
+    const unsigned long long startStep = iT;
 
+    // Snapshots of the plastic weights are pulled from the device and
+    // compacted on the simulation thread, then encoded and written in the background
+    std::unique_ptr<CPUEngine::WeightMonitor> weightMonitor;
+    std::vector<float> snapshotWeights;
+    snapshotWeights.reserve(numEESynapses);
+    if (weight_interval > 0.0f){
+      const unsigned int intervalSteps = std::max(1u, (unsigned int)std::round(weight_interval / Parameters::timestep));
+      try {
+        weightMonitor.reset(new CPUEngine::WeightMonitor("Weights.wmon", numEESynapses, Parameters::timestep, intervalSteps));
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+      }
+      pullEEStateFromDevice();
+      get_ee_weights(snapshotWeights);
+      weightMonitor->snapshot(startStep, snapshotWeights.data());
+    }
     clock_t totaltime;
+    BenchUtils::LatencyHistogram stepLatency;
     {
         Timer<> t("Simulation:");
         // Loop through timesteps
@@ -112,6 +377,8 @@ int main (int argc, char *argv[])
         clock_t starttime = clock();
         for(unsigned int t = 0; t < (int)(simtime*timesteps_per_second); t++)
         {
+            const auto stepStart = step_latency ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
             // Simulate
 #ifndef CPU_ONLY
             stepTimeGPU();
@@ -119,16 +386,32 @@ int main (int argc, char *argv[])
             if (!fast) pullECurrentSpikesFromDevice();
             if (!fast) pullPCurrentSpikesFromDevice();
             if (!fast) pullICurrentSpikesFromDevice();
+
+            // Kernels are only launched by stepTimeGPU, so wait for them to time the whole step.
+            // Otherwise steps stay asynchronous, so the timings match the plain benchmark
+            if (step_latency) cudaDeviceSynchronize();
 #else
             stepTimeCPU();
 #endif
 
-            if (!fast) spikes.record(t);
-            if (!fast) p_spikes.record(t);
-            if (!fast) i_spikes.record(t);
+            if (!fast) spikes.record(startStep + t);
+            if (!fast) p_spikes.record(startStep + t);
+            if (!fast) i_spikes.record(startStep + t);
+
+            if (weightMonitor && weightMonitor->isSnapshotStep(startStep + t + 1)){
+              pullEEStateFromDevice();
+              get_ee_weights(snapshotWeights);
+              weightMonitor->snapshot(startStep + t + 1, snapshotWeights.data());
+            }
+
+            if (step_latency) {
+                const auto stepEnd = std::chrono::steady_clock::now();
+                stepLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stepEnd - stepStart).count());
+            }
         }
         totaltime = clock() - starttime;
     }
+    if (step_latency) stepLatency.printSteps("Step", Parameters::timestep);
     if ( fast ){
       std::ofstream timefile;
       timefile.open("timefile.dat");
@@ -139,16 +422,33 @@ int main (int argc, char *argv[])
     // Get weights back
     pullEEStateFromDevice();
 
-    ofstream weightfile;
-    weightfile.open(("./Weights.bin"), ios::out | ios::binary);
+    // Compact the padded rows so the file is written with a single call
+    {
+      Timer<> t("Weight saving:");
+      std::vector<float> weights;
+      weights.reserve(numEESynapses);
+      get_ee_weights(weights);
+      BenchUtils::saveWeights("./Weights.bin", weights.data(), weights.size(), eeHash.getValue());
 
-    for (int pre = 0; pre < 8000; pre++){
-      for (int post = 0; post < CEE.rowLength[pre]; post++){
-        weightfile.write((char*)&gEE[pre*Parameters::EEMaxRow + post], sizeof(scalar));
+      // Finish the snapshots with the final weights
+      if (weightMonitor && !weightMonitor->isSnapshotStep(iT)){
+        weightMonitor->snapshot(iT, weights.data());
+      }
+    }
+    if (weightMonitor){
+      printf("%llu weight snapshots, %llu waited for the writer\n",
+             weightMonitor->getNumSnapshots(), weightMonitor->getNumStalls());
+    }
+
+    if (!checkpoint.empty()){
+      try {
+        Timer<> t("Checkpoint saving:");
+        save_checkpoint(checkpoint, eeHash.getValue());
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
       }
     }
-    weightfile.close();
-    
 
     return 0;
 }
@@ -24,53 +24,61 @@
 #include <time.h>
 #include <iomanip>
 #include <vector>
+#include <utility>
+
+#include "allocation_counter.h"
+#include "memory_usage.h"
+#include "parallel_loader.h"
+#include "setup_arena.h"
+
+// Spike's AddSynapseGroup takes its own copy of the pairwise vectors, so the
+// parameter struct's copies are released as soon as a group has been added
+void release_pairwise_connectivity(
+    conductance_spiking_synapse_parameters_struct* SYN_PARAMS){
+  std::vector<int>().swap(SYN_PARAMS->pairwise_connect_presynaptic);
+  std::vector<int>().swap(SYN_PARAMS->pairwise_connect_postsynaptic);
+  std::vector<float>().swap(SYN_PARAMS->pairwise_connect_weight);
+  std::vector<float>().swap(SYN_PARAMS->pairwise_connect_delay);
+}
+
+// Hands loaded connectivity over to Spike without an intermediate copy. Every
+// synapse in the group shares delay_range[0], so no per-synapse delay vector is
+// passed and Spike fills the delays in from the range
+int add_pairwise_synapse_group(
+    int layer1,
+    int layer2,
+    conductance_spiking_synapse_parameters_struct* SYN_PARAMS,
+    BenchUtils::PairwiseConnectivity&& connectivity,
+    SpikingModel* Model){
+  SYN_PARAMS->pairwise_connect_presynaptic = std::move(connectivity.pre);
+  SYN_PARAMS->pairwise_connect_postsynaptic = std::move(connectivity.post);
+  SYN_PARAMS->pairwise_connect_weight = std::move(connectivity.weight);
+  SYN_PARAMS->connectivity_type = CONNECTIVITY_TYPE_PAIRWISE;
+  int synapse_group_index = Model->AddSynapseGroup(layer1, layer2, SYN_PARAMS);
+  release_pairwise_connectivity(SYN_PARAMS);
+  return(synapse_group_index);
+}
+
+// Reads and decodes all of the given connectivity files concurrently.
+// Results come back in the order the files were given
+std::vector<BenchUtils::PairwiseConnectivity> load_connectivity(
+    const std::vector<std::string>& filenames){
+  try {
+    return(BenchUtils::loadWmatPairwiseConcurrently(filenames));
+  } catch (const std::exception& e) {
+    printf("Could not load connectivity matrix: %s\n", e.what());
+    exit(-1);
+  }
+}
 
 void connect_from_mat(
     int layer1,
     int layer2,
     conductance_spiking_synapse_parameters_struct* SYN_PARAMS, 
-    std::string filename,
+    BenchUtils::PairwiseConnectivity&& connectivity,
     SpikingModel* Model,
     float timestep){
-
-  ifstream weightfile;
-  string line;
-  stringstream ss;
-  std::vector<int> prevec, postvec;
-  std::vector<float> weightvec;
-  std::vector<float> delayvec;
-  int pre, post;
-  float weight;
-  int linecount = 0;
-  weightfile.open(filename.c_str());
-
-  if (weightfile.is_open()){
-    printf("Loading weights from mat file: %s\n", filename.c_str());
-    while (getline(weightfile, line)){
-      if (line.c_str()[0] == '%'){
-        continue;
-      } else {
-        linecount++;
-        if (linecount == 1) continue; // Ignore Header
-        ss.clear();
-        ss << line;
-        ss >> pre >> post >> weight;
-        prevec.push_back(pre - 1);
-        postvec.push_back(post - 1);
-        weightvec.push_back(weight);
-        delayvec.push_back(SYN_PARAMS->delay_range[0]);
-      }
-    }
-    SYN_PARAMS->pairwise_connect_presynaptic = prevec;
-    SYN_PARAMS->pairwise_connect_postsynaptic = postvec;
-    SYN_PARAMS->pairwise_connect_weight = weightvec;
-    SYN_PARAMS->pairwise_connect_delay = delayvec;
-    SYN_PARAMS->connectivity_type = CONNECTIVITY_TYPE_PAIRWISE;
-    Model->AddSynapseGroup(layer1, layer2, SYN_PARAMS);
-  } else {
-    printf("Could not load connectivity matrix: %s\n", filename.c_str());
-    exit(-1);
-  }
+  add_pairwise_synapse_group(layer1, layer2, SYN_PARAMS, std::move(connectivity), Model);
 }
 
 
@@ -88,7 +96,10 @@ int main (int argc, char *argv[]){
     {"fast", 0, nullptr, 1},
     {"num_timesteps_delay", 1, nullptr, 2},
     {"NOTG", 0, nullptr, 3},
-    {"networkscale", 1, nullptr, 4}
+    {"networkscale", 1, nullptr, 4},
+    {"checkpoint", 1, nullptr, 5},
+    {"restore", 1, nullptr, 6},
+    {nullptr, 0, nullptr, 0}
   };
   // Check the set of options
   while (true) {
@@ -118,9 +129,23 @@ int main (int argc, char *argv[]){
         printf("Running with Network Scaled by: %s\n", optarg);
         networkscale = std::stoi(optarg);
         break;
+      case 5:
+      case 6:
+        // Spike has no interface to read or write its dynamic state, which
+        // lives in its backend's device arrays
+        printf("Spike cannot checkpoint or restore this model: the membrane potentials, refractory state, "
+               "conductances and queued spikes are held by its backend\n");
+        return(-1);
     }
   };
   
+  BenchUtils::printMemoryUsage("Before setup");
+  const BenchUtils::AllocationCounts setupStart = BenchUtils::getAllocationCounts();
+
+  // Parameter structs are only read while the model is built, so they live
+  // in an arena which is released in one go once it has been finalised
+  BenchUtils::SetupArena setupArena;
+
   // TIMESTEP MUST BE SET BEFORE DATA IS IMPORTED. USED FOR ROUNDING.
   // The details below shall be used in a SpikingModel
   SpikingModel * BenchModel = new SpikingModel();
@@ -140,8 +165,8 @@ int main (int argc, char *argv[]){
     BenchModel->AddActivityMonitor(spike_monitor);
 
   // Set up Neuron Parameters
-  lif_spiking_neuron_parameters_struct * EXC_NEURON_PARAMS = new lif_spiking_neuron_parameters_struct();
-  lif_spiking_neuron_parameters_struct * INH_NEURON_PARAMS = new lif_spiking_neuron_parameters_struct();
+  lif_spiking_neuron_parameters_struct * EXC_NEURON_PARAMS = setupArena.make<lif_spiking_neuron_parameters_struct>();
+  lif_spiking_neuron_parameters_struct * INH_NEURON_PARAMS = setupArena.make<lif_spiking_neuron_parameters_struct>();
 
   EXC_NEURON_PARAMS->somatic_capacitance_Cm = 20.0f*pow(10.0, -3);//200.0f*pow(10.0, -12);  // pF
   INH_NEURON_PARAMS->somatic_capacitance_Cm = 20.0f*pow(10.0, -3);//200.0f*pow(10.0, -12);  // pF
@@ -180,8 +205,8 @@ int main (int argc, char *argv[]){
   /*
     Setting up SYNAPSES
   */
-  conductance_spiking_synapse_parameters_struct * EXC_OUT_SYN_PARAMS = new conductance_spiking_synapse_parameters_struct();
-  conductance_spiking_synapse_parameters_struct * INH_OUT_SYN_PARAMS = new conductance_spiking_synapse_parameters_struct();
+  conductance_spiking_synapse_parameters_struct * EXC_OUT_SYN_PARAMS = setupArena.make<conductance_spiking_synapse_parameters_struct>();
+  conductance_spiking_synapse_parameters_struct * INH_OUT_SYN_PARAMS = setupArena.make<conductance_spiking_synapse_parameters_struct>();
   // Setting delays
   EXC_OUT_SYN_PARAMS->delay_range[0] = num_timesteps_delay*timestep;
   EXC_OUT_SYN_PARAMS->delay_range[1] = num_timesteps_delay*timestep;
@@ -225,47 +250,37 @@ int main (int argc, char *argv[]){
   */
 
   // Adding connections based upon matrices given
-  std::string connFile = "../../ee.wmat";
+  std::vector<std::string> connFiles = {
+    "../../ee.wmat", "../../ei.wmat", "../../ie.wmat", "../../ii.wmat"};
   if (networkscale != 1){
-    connFile = "../../auryn/" + std::to_string(networkscale) + ".0.0.wmat";
+    for (int f = 0; f < connFiles.size(); f++)
+      connFiles[f] = "../../auryn/" + std::to_string(networkscale) + "." + std::to_string(f) + ".0.wmat";
   }
+  // The four projections are loaded together, then added in a fixed order
+  std::vector<BenchUtils::PairwiseConnectivity> connectivity = load_connectivity(connFiles);
+
   connect_from_mat(
       EXCITATORY_NEURONS[0], EXCITATORY_NEURONS[0],
       EXC_OUT_SYN_PARAMS, 
-      connFile.c_str(),
+      std::move(connectivity[0]),
       BenchModel,
       timestep);
-
-  connFile = "../../ei.wmat";
-  if (networkscale != 1){
-    connFile = "../../auryn/" + std::to_string(networkscale) + ".1.0.wmat";
-  }
   connect_from_mat(
     EXCITATORY_NEURONS[0], INHIBITORY_NEURONS[0],
     EXC_OUT_SYN_PARAMS, 
-    connFile.c_str(),
+    std::move(connectivity[1]),
     BenchModel,
     timestep);
-  
-  connFile = "../../ie.wmat";
-  if (networkscale != 1){
-    connFile = "../../auryn/" + std::to_string(networkscale) + ".2.0.wmat";
-  }
   connect_from_mat(
     INHIBITORY_NEURONS[0], EXCITATORY_NEURONS[0],
     INH_OUT_SYN_PARAMS, 
-    connFile.c_str(),
+    std::move(connectivity[2]),
     BenchModel,
     timestep);
-  
-  connFile = "../../ii.wmat";
-  if (networkscale != 1){
-    connFile = "../../auryn/" + std::to_string(networkscale) + ".3.0.wmat";
-  }
   connect_from_mat(
     INHIBITORY_NEURONS[0], INHIBITORY_NEURONS[0],
     INH_OUT_SYN_PARAMS, 
-    connFile.c_str(),
+    std::move(connectivity[3]),
     BenchModel,
     timestep);
 
@@ -276,6 +291,10 @@ int main (int argc, char *argv[]){
     COMPLETE NETWORK SETUP
   */
   BenchModel->finalise_model();
+  BenchUtils::printAllocationCounts("Setup", setupStart);
+  setupArena.printStats("Setup");
+  setupArena.release();
+  BenchUtils::printMemoryUsage("After setup");
   if (no_TG)
     BenchModel->timestep_grouping = 1;
 
@@ -42,6 +42,7 @@
 // This file is re-used by the SNNSimulatorComparison Repository for benchmarking
 
 #include "auryn.h"
+#include "mpi_perf_counters.h"
 #include <fstream>
 #include <string>
 #include <iostream>
@@ -76,6 +77,7 @@ int main(int ac,char *av[]) {
   int networkscale = 1;
 
   bool fast = false;
+  bool perf_counters = false;
 
   int num_timesteps_delay = 1;
 
@@ -92,6 +94,7 @@ int main(int ac,char *av[]) {
             ("save", po::value<string>(), "Name for Network Saving")
             ("num_timesteps_delay", po::value<int>(), "the number of timesteps of synaptic delay")
             ("fast", "turns off most monitoring to reduce IO")
+            ("perf_counters", "counts hardware events during the simulation")
             ("dir", po::value<string>(), "load/save directory")
             ("fee", po::value<string>(), "file with EE connections")
             ("fei", po::value<string>(), "file with EI connections")
@@ -123,6 +126,9 @@ int main(int ac,char *av[]) {
         if (vm.count("fast")) {
           fast = true;
         } 
+        if (vm.count("perf_counters")) {
+          perf_counters = true;
+        } 
         
         if (vm.count("save")) {
           save = vm["save"].as<string>();
@@ -241,11 +247,25 @@ int main(int ac,char *av[]) {
   //RateChecker * chk = new RateChecker( neurons_e , -0.1 , 1000. , 100e-3);
   //printf("Auryn timestep: %f", sys->auryn_timestep);
   
+  // Unlike the CPU engine and GeNN runs, there is no step latency histogram:
+  // sys->run steps through the whole simulation internally, and running it a
+  // step at a time would add its per-call setup and progress reporting to
+  // every step being timed
   logger->msg("Simulating ..." ,PROGRESS,true);
+  BenchUtils::MPIPerfCounters counters;
+  if ( perf_counters )
+    counters.start();
   clock_t starttime = clock();
   if (!sys->run(simtime,true)) 
       errcode = 1;
   clock_t totaltime = clock() - starttime;
+  counters.stop();
+
+  // Auryn does not count the synaptic events it delivers, so only the
+  // totals and the metrics which do not need them are reported. Each rank
+  // prints its own counts and rank 0 writes their sum
+  if ( perf_counters )
+    counters.report((double)totaltime / CLOCKS_PER_SEC, "perfcounters.dat");
 
   if ( fast ){
     std::ofstream timefile;
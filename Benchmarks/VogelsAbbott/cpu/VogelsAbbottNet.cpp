@@ -0,0 +1,387 @@
+// Vogels Abbott Benchmark Network on the CPU engine
+//
+// Same network as the Spike and GeNN frontends - conductance-based LIF neurons,
+// 80% excitatory, with the connectivity loaded from the Auryn .wmat files.
+//
+// Publications:
+// Vogels, Tim P., and L. F. Abbott. 2005. "Signal Propagation and Logic Gating in Networks of Integrate-and-Fire Neurons." The Journal of Neuroscience 25 (46): 10786-95.
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "allocation_counter.h"
+#include "huge_pages.h"
+#include "latency_histogram.h"
+#include "memory_usage.h"
+#include "neuron_mask.h"
+#include "parallel_loader.h"
+#include "perf_counters.h"
+#include "cpu/network.h"
+#include "cpu/pacer.h"
+#include "cpu/spike_recorder.h"
+#include "cpu/state_monitor.h"
+
+// Reads and decodes all of the given connectivity files concurrently.
+// Results come back in the order the files were given
+std::vector<BenchUtils::CSRConnectivity> load_connectivity(
+    const std::vector<std::string>& filenames){
+  try {
+    return(BenchUtils::loadWmatCSRConcurrently(filenames));
+  } catch (const std::exception& e) {
+    printf("Could not load connectivity matrix: %s\n", e.what());
+    exit(-1);
+  }
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  float simtime = 20.0;
+  bool fast = false;
+  int num_timesteps_delay = 8;
+  int networkscale = 1;
+  std::string checkpoint;
+  std::string restore;
+  unsigned int threads = 0;
+  std::string hugepages;
+  bool perf_counters = false;
+  double paced = 0.0;
+  unsigned int pace_batch = 1;
+  bool shed = false;
+  std::string spike_stream;
+  float state_interval = 0.0f;
+  std::string state_neurons = "first:50";
+  std::map<std::string, std::string> record_masks;
+
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"simtime", 1, nullptr, 0},
+    {"fast", 0, nullptr, 1},
+    {"num_timesteps_delay", 1, nullptr, 2},
+    {"networkscale", 1, nullptr, 4},
+    {"checkpoint", 1, nullptr, 5},
+    {"restore", 1, nullptr, 6},
+    {"threads", 1, nullptr, 7},
+    {"hugepages", 1, nullptr, 8},
+    {"perf_counters", 0, nullptr, 9},
+    {"paced", 1, nullptr, 10},
+    {"pace_batch", 1, nullptr, 11},
+    {"shed", 0, nullptr, 12},
+    {"spike_stream", 1, nullptr, 13},
+    {"state_interval", 1, nullptr, 14},
+    {"state_neurons", 1, nullptr, 15},
+    {"record_mask", 1, nullptr, 16},
+    {nullptr, 0, nullptr, 0}
+  };
+  // Check the set of options
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+
+    // If none
+    if (-1 == opt) break;
+
+    switch (opt){
+      case 0:
+        printf("Running with a simulation time of: %ss\n", optarg);
+        simtime = std::stof(optarg);
+        break;
+      case 1:
+        printf("Running in fast mode (no spike collection)\n");
+        fast = true;
+        break;
+      case 2:
+        printf("Running with delay: %s timesteps\n", optarg);
+        num_timesteps_delay = std::stoi(optarg);
+        break;
+      case 4:
+        printf("Running with Network Scaled by: %s\n", optarg);
+        networkscale = std::stoi(optarg);
+        break;
+      case 5:
+        printf("Saving a checkpoint of the final state to %s\n", optarg);
+        checkpoint = optarg;
+        break;
+      case 6:
+        printf("Restoring the network state from %s\n", optarg);
+        restore = optarg;
+        break;
+      case 7:
+        printf("Running on %s threads\n", optarg);
+        threads = (unsigned int)std::stoul(optarg);
+        break;
+      case 8:
+        printf("Huge pages for large arrays: %s\n", optarg);
+        hugepages = optarg;
+        break;
+      case 9:
+        printf("Collecting hardware performance counters\n");
+        perf_counters = true;
+        break;
+      case 10:
+        printf("Pacing the simulation at %s timesteps per real millisecond\n", optarg);
+        paced = std::stod(optarg);
+        break;
+      case 11:
+        printf("Waiting for the schedule every %s timesteps\n", optarg);
+        pace_batch = (unsigned int)std::stoul(optarg);
+        break;
+      case 12:
+        printf("Skipping recording on timesteps behind schedule\n");
+        shed = true;
+        break;
+      case 13:
+        printf("Publishing spikes to the shared-memory stream %s\n", optarg);
+        spike_stream = optarg;
+        break;
+      case 14:
+        printf("Recording neuron state every %sms\n", optarg);
+        state_interval = std::stof(optarg);
+        break;
+      case 15:
+        state_neurons = optarg;
+        break;
+      case 16:
+        printf("Recording spikes of the neurons in the mask %s\n", optarg);
+        try {
+          BenchUtils::addPopulationMask(optarg, record_masks);
+        } catch (const std::exception& e) {
+          printf("%s\n", e.what());
+          return(-1);
+        }
+        break;
+    }
+  };
+  if (pace_batch == 0){
+    printf("Pacing needs at least one timestep per batch\n");
+    return(-1);
+  }
+  if (!spike_stream.empty() && fast){
+    printf("Spikes are streamed as they are recorded - not with --fast\n");
+    return(-1);
+  }
+  // Must be set before the connectivity is loaded
+  if (!hugepages.empty()){
+    try {
+      BenchUtils::setHugePageMode(BenchUtils::parseHugePageMode(hugepages));
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+
+  BenchUtils::printMemoryUsage("Before setup");
+  const BenchUtils::AllocationCounts setupStart = BenchUtils::getAllocationCounts();
+
+  const double timestep = 0.1;    // ms
+  CPUEngine::Network network(timestep);
+
+  const CPUEngine::LIFParams lifParams = {
+    20.0,   // tauM (ms)
+    -60.0,  // vRest (mV)
+    -60.0,  // vReset (mV)
+    -50.0,  // vThresh (mV)
+    20.0,   // iOffset (mV)
+    5.0};   // tauRefrac (ms)
+
+  auto& exc = network.addGroup<CPUEngine::LIFCondGroup>(
+    "E", 3200*networkscale, lifParams, 5.0, 0.0, 10.0, -80.0, timestep);
+  auto& inh = network.addGroup<CPUEngine::LIFCondGroup>(
+    "I", 800*networkscale, lifParams, 5.0, 0.0, 10.0, -80.0, timestep);
+
+  // Adding connections based upon matrices given
+  std::vector<std::string> connFiles = {
+    "../../ee.wmat", "../../ei.wmat", "../../ie.wmat", "../../ii.wmat"};
+  if (networkscale != 1){
+    for (size_t f = 0; f < connFiles.size(); f++)
+      connFiles[f] = "../../auryn/" + std::to_string(networkscale) + "." + std::to_string(f) + ".0.wmat";
+  }
+  // The four projections are loaded together, then added in a fixed order.
+  // Every synapse has the same delay so it is stored once per projection
+  std::vector<BenchUtils::CSRConnectivity> connectivity = load_connectivity(connFiles);
+  BenchUtils::printMemoryUsage("After loading");
+  try {
+    network.addProjection<CPUEngine::Projection>(
+      exc, exc, CPUEngine::LIFCondGroup::RECEPTOR_EXC, std::move(connectivity[0]), num_timesteps_delay);
+    network.addProjection<CPUEngine::Projection>(
+      exc, inh, CPUEngine::LIFCondGroup::RECEPTOR_EXC, std::move(connectivity[1]), num_timesteps_delay);
+    network.addProjection<CPUEngine::Projection>(
+      inh, exc, CPUEngine::LIFCondGroup::RECEPTOR_INH, std::move(connectivity[2]), num_timesteps_delay);
+    network.addProjection<CPUEngine::Projection>(
+      inh, inh, CPUEngine::LIFCondGroup::RECEPTOR_INH, std::move(connectivity[3]), num_timesteps_delay);
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+  connectivity.clear();
+
+  /*
+    COMPLETE NETWORK SETUP
+  */
+  network.finalise();
+  printf("Network has %zu synapses\n", network.getNumSynapses());
+
+  // Split the neurons, and the synapses onto them, between NUMA-local threads
+  if (threads > 0){
+    try {
+      network.partition(CPUEngine::makePartitions(threads));
+      network.printPartitions();
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+
+  // Continue from an earlier run's final state, e.g. after the initial transient
+  if (!restore.empty()){
+    try {
+      network.restoreCheckpoint(restore);
+      printf("Restored step %llu\n", network.getStep());
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+  BenchUtils::printAllocationCounts("Setup", setupStart);
+  BenchUtils::printMemoryUsage("After setup");
+  if (!hugepages.empty())
+    BenchUtils::printHugePageUsage();
+
+  // Which neurons of each population E and I have their spikes, and their state, recorded
+  BenchUtils::NeuronMask excMask, inhMask, excStateMask, inhStateMask;
+  try {
+    BenchUtils::checkPopulationMasks(record_masks, {"E", "I"});
+    excMask = BenchUtils::getPopulationMask(record_masks, "E", exc.getSize());
+    inhMask = BenchUtils::getPopulationMask(record_masks, "I", inh.getSize());
+    if (state_interval > 0.0f){
+      excStateMask = BenchUtils::NeuronMask(state_neurons, exc.getSize());
+      inhStateMask = BenchUtils::NeuronMask(state_neurons, inh.getSize());
+      if (excStateMask.getNumSelected() == 0 || inhStateMask.getNumSelected() == 0)
+        throw std::runtime_error("State neurons '" + state_neurons + "' select no neurons of a population");
+      printf("Recording the state of %u excitatory and %u inhibitory neurons\n",
+             excStateMask.getNumSelected(), inhStateMask.getNumSelected());
+    }
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+
+  CPUEngine::SpikeRecorder excSpikes("exc_spikes.csv", exc, timestep);
+  CPUEngine::SpikeRecorder inhSpikes("inh_spikes.csv", inh, timestep);
+  excSpikes.setMask(excMask);
+  inhSpikes.setMask(inhMask);
+
+  // Live consumers, such as spike_stream/RateMonitor, see each step's spikes as they are recorded
+  std::unique_ptr<BenchUtils::SpikeStreamPublisher> stream;
+  if (!spike_stream.empty()){
+    stream.reset(new BenchUtils::SpikeStreamPublisher(spike_stream, {{"E", excMask.getNumSelected()}, {"I", inhMask.getNumSelected()}}, timestep));
+    excSpikes.setStream(*stream, 0);
+    inhSpikes.setStream(*stream, 1);
+  }
+
+  // Membrane potentials and conductances of the selected neurons of each population
+  std::vector<std::unique_ptr<CPUEngine::StateMonitor>> stateMonitors;
+  if (state_interval > 0.0f){
+    const unsigned int intervalSteps = std::max(1u, (unsigned int)std::round(state_interval / timestep));
+    for (auto group : {&exc, &inh}){
+      stateMonitors.emplace_back(new CPUEngine::StateMonitor(
+        (group == &exc) ? "exc_state.smon" : "inh_state.smon", ((group == &exc) ? excStateMask : inhStateMask).getSelected(),
+        {CPUEngine::StateVariable::array("V", group->getV().data()),
+         CPUEngine::StateVariable::array("g_exc", group->getGExc().data()),
+         CPUEngine::StateVariable::array("g_inh", group->getGInh().data())},
+        timestep, intervalSteps));
+      stateMonitors.back()->sample(network.getStep());
+    }
+  }
+
+  const unsigned long long numTimesteps = (unsigned long long)std::round(simtime * 1000.0 / timestep);
+  const unsigned long long endStep = network.getStep() + numTimesteps;
+  BenchUtils::PerfCounters counters;
+  const uint64_t startSynapticEvents = network.getNumSynapticEvents();
+  CPUEngine::Instrumentation::reset();
+  if (perf_counters)
+    counters.start();
+  BenchUtils::LatencyHistogram stepLatency;
+  std::unique_ptr<CPUEngine::Pacer> pacer;
+  if (paced > 0.0)
+    pacer.reset(new CPUEngine::Pacer(paced, pace_batch, shed));
+  clock_t starttime = clock();
+  const auto wallStart = std::chrono::steady_clock::now();
+  auto stepStart = pacer ? pacer->start() : wallStart;
+  while (network.getStep() < endStep){
+    const unsigned long long t = network.getStep();
+    network.step();
+    const bool shedding = pacer && pacer->shouldShed();
+    if (!fast && !shedding){
+      excSpikes.record(t);
+      inhSpikes.record(t);
+    }
+    if (!shedding){
+      for (auto& monitor : stateMonitors)
+        monitor->record(network.getStep());
+    }
+
+    // Each step is timed with its recording but not with any wait for the schedule
+    const auto stepEnd = std::chrono::steady_clock::now();
+    stepLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stepEnd - stepStart).count());
+    stepStart = pacer ? pacer->endStep(stepEnd) : stepEnd;
+  }
+  // CPU time would count every thread and miss the waits for the schedule, so
+  // threaded and paced runs are timed by the wall clock
+  clock_t totaltime = clock() - starttime;
+  counters.stop();
+  const float simulationTime = (threads > 0 || pacer)
+    ? std::chrono::duration<float>(std::chrono::steady_clock::now() - wallStart).count() : (float)totaltime / CLOCKS_PER_SEC;
+  printf("Simulated %llu timesteps in %fs\n", numTimesteps, simulationTime);
+  stepLatency.printSteps("Step", timestep);
+  if (pacer){
+    pacer->print();
+    pacer->write("deadlines.dat");
+  }
+  CPUEngine::Instrumentation::printReport(simulationTime);
+  if (perf_counters){
+    const uint64_t synapticEvents = network.getNumSynapticEvents() - startSynapticEvents;
+    counters.print(simulationTime, synapticEvents);
+    counters.write("perfcounters.dat", simulationTime, synapticEvents);
+  }
+
+  // What the engine itself holds, then what the process as a whole used
+  CPUEngine::MemoryFootprint footprint = network.getMemoryFootprint();
+  excSpikes.addMemoryFootprint(footprint);
+  inhSpikes.addMemoryFootprint(footprint);
+  for (const auto& monitor : stateMonitors)
+    monitor->addMemoryFootprint(footprint);
+  footprint.print("Final", network.getNumNeurons(), network.getNumSynapses());
+  BenchUtils::printMemoryUsage("After simulation");
+  printf("Peak RSS: %.2f bytes per synapse\n", (double)BenchUtils::getPeakRSS() / (double)network.getNumSynapses());
+  if (!stateMonitors.empty()){
+    unsigned long long numSamples = 0, numStalls = 0;
+    for (const auto& monitor : stateMonitors){
+      numSamples += monitor->getNumSamples();
+      numStalls += monitor->getNumStalls();
+    }
+    printf("%llu state samples, %llu waited for the writer\n", numSamples, numStalls);
+  }
+  if (!checkpoint.empty()){
+    try {
+      network.saveCheckpoint(checkpoint);
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return(-1);
+    }
+  }
+  if ( fast ){
+    std::ofstream timefile;
+    timefile.open("timefile.dat");
+    timefile << std::setprecision(10) << simulationTime;
+    timefile.close();
+  }
+  return(0);
+}
@@ -10,6 +10,7 @@
 //#include "connectors.h"
 
 #include "parameters.h"
+#include "wmat_loader.h"
 
 void modelDefinition(NNmodel &model)
 {
@@ -69,28 +70,28 @@ void modelDefinition(NNmodel &model)
         "E", "E",
         {}, excs_ini,
         excitatorySyns, {});
-    ee->setMaxConnections(Parameters::EEMaxRow);
+    ee->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::eeConnectivity));
 
     auto *ei = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::ExpCond>(
         "EI", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "E", "I",
         {}, excs_ini,
         excitatorySyns, {});
-    ei->setMaxConnections(Parameters::EIMaxRow);
+    ei->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::eiConnectivity));
 
     auto *ii = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::ExpCond>(
         "II", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "I", "I",
         {}, inhibs_ini,
         inhibitorySyns, {});
-    ii->setMaxConnections(Parameters::IIMaxRow);
+    ii->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::iiConnectivity));
 
     auto *ie = model.addSynapsePopulation<WeightUpdateModels::StaticPulse, PostsynapticModels::ExpCond>(
         "IE", SynapseMatrixType::RAGGED_INDIVIDUALG, DELAY,
         "I", "E",
         {}, inhibs_ini,
         inhibitorySyns, {});
-    ie->setMaxConnections(Parameters::IEMaxRow);
+    ie->setMaxConnections(BenchUtils::getMaxRowLength(Parameters::ieConnectivity));
 
 
     // Configure spike variables so that they can be downloaded to host
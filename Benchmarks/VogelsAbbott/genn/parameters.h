@@ -26,10 +26,11 @@ namespace Parameters
     const unsigned int numExcitatory = (unsigned int)std::round(((double)numNeurons * excitatoryInhibitoryRatio) / (1.0 + excitatoryInhibitoryRatio));
     const unsigned int numInhibitory = numNeurons - numExcitatory;
 
-    const unsigned int EEMaxRow = 95;
-    const unsigned int EIMaxRow = 31;
-    const unsigned int IIMaxRow = 31;
-    const unsigned int IEMaxRow = 87;
+    // Connectivity matrices - maximum row lengths are derived from these when the model is built
+    const char *const eeConnectivity = "../ee.wmat";
+    const char *const eiConnectivity = "../ei.wmat";
+    const char *const iiConnectivity = "../ii.wmat";
+    const char *const ieConnectivity = "../ie.wmat";
 
     const unsigned int synapticDelay = 8; //1;
 
@@ -3,34 +3,121 @@
 
 // GeNN robotics includes
 //#include "common/timer.h"
-//#include "genn_utils/spike_csv_recorder.h"
 #include "timer.h"
-#include "spike_csv_recorder.h"
+#include "genn_utils/checkpoint.h"
+#include "genn_utils/spike_csv_recorder.h"
 
 // Model parameters
 #include "parameters.h"
 
 // Connectivity functions
+#include "latency_histogram.h"
 #include "matLoader.h"
+#include "neuron_mask.h"
 
 // Auto-generated model code
 #include "va_benchmark_CODE/definitions.h"
 
+#ifndef CPU_ONLY
+#include <cuda_runtime.h>
+#endif
+
 #include <getopt.h>
+#include <chrono>
 #include <time.h>
 #include <iomanip>
+#include <map>
 
 using namespace BoBRobotics;
 
+// Populations with delayed outgoing synapses keep a spike queue of this many slots
+const unsigned int numDelaySlots = Parameters::synapticDelay + 1;
+
+// Checkpoints hold everything which evolves during a run: the time, the
+// neurons' variables, the spikes waiting in each population's delay queue and
+// the synaptic conductances. The static connectivity and weights are rebuilt
+// from the same files. No random numbers are drawn during a run, so a
+// restored run continues exactly as an uninterrupted one would
+void save_checkpoint(const std::string &filename)
+{
+    pullEStateFromDevice();
+    pullIStateFromDevice();
+    pullESpikesFromDevice();
+    pullISpikesFromDevice();
+    pullEEStateFromDevice();
+    pullEIStateFromDevice();
+    pullIIStateFromDevice();
+    pullIEStateFromDevice();
+
+    CPUEngine::CheckpointWriter writer;
+    writer.beginSection("time");
+    writer.write(iT);
+    writer.write(t);
+
+    GeNNUtils::saveArray(writer, "E V", VE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "E RefracTime", RefracTimeE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "I V", VI, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "I RefracTime", RefracTimeI, Parameters::numInhibitory);
+    GeNNUtils::saveSpikeQueue(writer, "E spikes", Parameters::numExcitatory, numDelaySlots, spkQuePtrE, glbSpkCntE, glbSpkE);
+    GeNNUtils::saveSpikeQueue(writer, "I spikes", Parameters::numInhibitory, numDelaySlots, spkQuePtrI, glbSpkCntI, glbSpkI);
+
+    GeNNUtils::saveArray(writer, "EE inSyn", inSynEE, Parameters::numExcitatory);
+    GeNNUtils::saveArray(writer, "EI inSyn", inSynEI, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "II inSyn", inSynII, Parameters::numInhibitory);
+    GeNNUtils::saveArray(writer, "IE inSyn", inSynIE, Parameters::numExcitatory);
+    writer.save(filename);
+}
+
+//! Restore a checkpoint into a freshly initialised model with the same connectivity
+void restore_checkpoint(const std::string &filename)
+{
+    CPUEngine::CheckpointReader reader(filename);
+    reader.beginSection("time");
+    reader.read(iT);
+    reader.read(t);
+
+    // The queues of a freshly initialised model start at slot 0 on the host and the device alike
+    GeNNUtils::restoreArray(reader, "E V", VE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "E RefracTime", RefracTimeE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "I V", VI, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "I RefracTime", RefracTimeI, Parameters::numInhibitory);
+    GeNNUtils::restoreSpikeQueue(reader, "E spikes", Parameters::numExcitatory, numDelaySlots, spkQuePtrE, glbSpkCntE, glbSpkE);
+    GeNNUtils::restoreSpikeQueue(reader, "I spikes", Parameters::numInhibitory, numDelaySlots, spkQuePtrI, glbSpkCntI, glbSpkI);
+
+    GeNNUtils::restoreArray(reader, "EE inSyn", inSynEE, Parameters::numExcitatory);
+    GeNNUtils::restoreArray(reader, "EI inSyn", inSynEI, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "II inSyn", inSynII, Parameters::numInhibitory);
+    GeNNUtils::restoreArray(reader, "IE inSyn", inSynIE, Parameters::numExcitatory);
+    reader.finish();
+
+    pushEStateToDevice();
+    pushIStateToDevice();
+    pushESpikesToDevice();
+    pushISpikesToDevice();
+    pushEEStateToDevice();
+    pushEIStateToDevice();
+    pushIIStateToDevice();
+    pushIEStateToDevice();
+}
+
 int main (int argc, char *argv[])
 {
     // Getting options:
     float simtime = 20.0;
     bool fast = false;
+    bool step_latency = false;
+    std::string checkpoint;
+    std::string restore;
+    std::map<std::string, std::string> record_masks;
     const char* const short_opts = "";
     const option long_opts[] = {
       {"simtime", 1, nullptr, 0},
       {"fast", 0, nullptr, 1},
+      {"record_mask", 1, nullptr, 2},
+      {"checkpoint", 1, nullptr, 3},
+      {"restore", 1, nullptr, 4},
+      {"step_latency", 0, nullptr, 5},
+      {nullptr, 0, nullptr, 0}
     };
     // Check the set of options
     while (true) {
@@ -48,6 +135,27 @@ int main (int argc, char *argv[])
           printf("Running in fast mode (no spike collection)\n");
           fast = true;
           break;
+        case 2:
+          printf("Recording spikes of the neurons in the mask %s\n", optarg);
+          try {
+            BenchUtils::addPopulationMask(optarg, record_masks);
+          } catch (const std::exception& e) {
+            printf("%s\n", e.what());
+            return -1;
+          }
+          break;
+        case 3:
+          printf("Saving a checkpoint to %s at the end of the run\n", optarg);
+          checkpoint = optarg;
+          break;
+        case 4:
+          printf("Restoring the checkpoint %s\n", optarg);
+          restore = optarg;
+          break;
+        case 5:
+          printf("Timing every step, waiting for the device at the end of each\n");
+          step_latency = true;
+          break;
         default:
           break;
       }
@@ -65,19 +173,29 @@ int main (int argc, char *argv[])
     // Loading Synapses
     {
         Timer<> t("Synapse setup:");
-        ragged_connectivity_from_mat("../ee.wmat", gEE, CEE.ind, CEE.rowLength, Parameters::numExcitatory, Parameters::EEMaxRow);
+        // Decoding all four projections concurrently, then registering them in a fixed order
+        std::vector<BenchUtils::CSRConnectivity> csr;
+        try {
+          csr = BenchUtils::loadWmatCSRConcurrently(
+              {Parameters::eeConnectivity, Parameters::eiConnectivity, Parameters::iiConnectivity, Parameters::ieConnectivity});
+        } catch (const std::exception& e) {
+          printf("%s\n", e.what());
+          return -1;
+        }
+
+        ragged_connectivity_from_csr(Parameters::eeConnectivity, csr[0], gEE, CEE.ind, CEE.rowLength, Parameters::numExcitatory, CEE.maxRowLength);
         reset_array(inSynEE, Parameters::numExcitatory);
         pushEEStateToDevice();
 
-        ragged_connectivity_from_mat("../ei.wmat", gEI, CEI.ind, CEI.rowLength, Parameters::numExcitatory, Parameters::EIMaxRow);
+        ragged_connectivity_from_csr(Parameters::eiConnectivity, csr[1], gEI, CEI.ind, CEI.rowLength, Parameters::numExcitatory, CEI.maxRowLength);
         reset_array(inSynEI, Parameters::numInhibitory);
         pushEIStateToDevice();
 
-        ragged_connectivity_from_mat("../ii.wmat", gII, CII.ind, CII.rowLength, Parameters::numInhibitory, Parameters::IIMaxRow);
+        ragged_connectivity_from_csr(Parameters::iiConnectivity, csr[2], gII, CII.ind, CII.rowLength, Parameters::numInhibitory, CII.maxRowLength);
         reset_array(inSynII, Parameters::numInhibitory);
         pushIIStateToDevice();
 
-        ragged_connectivity_from_mat("../ie.wmat", gIE, CIE.ind, CIE.rowLength, Parameters::numInhibitory, Parameters::IEMaxRow);
+        ragged_connectivity_from_csr(Parameters::ieConnectivity, csr[3], gIE, CIE.ind, CIE.rowLength, Parameters::numInhibitory, CIE.maxRowLength);
         reset_array(inSynIE, Parameters::numExcitatory);
         pushIEStateToDevice();
     }
@@ -88,10 +206,35 @@ int main (int argc, char *argv[])
         initva_benchmark();
     }
 
+    // Continue from the state saved at the end of an earlier run
+    if (!restore.empty()){
+      try {
+        Timer<> t("Restoring:");
+        restore_checkpoint(restore);
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+      }
+      printf("Restored step %llu\n", iT);
+    }
+
+    // Which excitatory neurons have their spikes recorded
+    BenchUtils::NeuronMask e_mask;
+    try {
+      BenchUtils::checkPopulationMasks(record_masks, {"E"});
+      e_mask = BenchUtils::getPopulationMask(record_masks, "E", 3200);
+    } catch (const std::exception& e) {
+      printf("%s\n", e.what());
+      return -1;
+    }
+
     // Open CSV output files
-    GeNNUtils::SpikeCSVRecorderDelay spikes("spikes.csv", 3200, spkQuePtrE, glbSpkCntE, glbSpkE);
+    GeNNUtils::SpikeCSVRecorderDelay spikes("spikes.csv", 3200, spkQuePtrE, glbSpkCntE, glbSpkE, e_mask);
 
+    // Spike times continue from a restored step
+    const unsigned long long startStep = iT;
     clock_t totaltime;
+    BenchUtils::LatencyHistogram stepLatency;
     {
         Timer<> t("Simulation:");
         // Loop through timesteps
@@ -99,19 +242,31 @@ int main (int argc, char *argv[])
         clock_t starttime = clock();
         for(unsigned int t = 0; t < (int)(simtime*timesteps_per_second); t++)
         {
+            const auto stepStart = step_latency ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
             // Simulate
 #ifndef CPU_ONLY
             stepTimeGPU();
 
             if (!fast) pullECurrentSpikesFromDevice();
+
+            // Kernels are only launched by stepTimeGPU, so wait for them to time the whole step.
+            // Otherwise steps stay asynchronous, so the timings match the plain benchmark
+            if (step_latency) cudaDeviceSynchronize();
 #else
             stepTimeCPU();
 #endif
 
-            if (!fast) spikes.record(t);
+            if (!fast) spikes.record(startStep + t);
+
+            if (step_latency) {
+                const auto stepEnd = std::chrono::steady_clock::now();
+                stepLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(stepEnd - stepStart).count());
+            }
         }
         totaltime = clock() - starttime;
     }
+    if (step_latency) stepLatency.printSteps("Step", Parameters::timestep);
     if ( fast ){
       std::ofstream timefile;
       timefile.open("timefile.dat");
@@ -119,5 +274,15 @@ int main (int argc, char *argv[])
       timefile.close();
     }
 
+    if (!checkpoint.empty()){
+      try {
+        Timer<> t("Checkpoint saving:");
+        save_checkpoint(checkpoint);
+      } catch (const std::exception& e) {
+        printf("%s\n", e.what());
+        return -1;
+      }
+    }
+
     return 0;
 }
@@ -0,0 +1,89 @@
+#pragma once
+
+// Standard C++ includes
+#include <atomic>
+#include <new>
+#include <string>
+
+// Standard C includes
+#include <cstdio>
+#include <cstdlib>
+
+//----------------------------------------------------------------------------
+// Heap allocation counting
+//----------------------------------------------------------------------------
+// Replaces the global operator new and delete to count calls, so a frontend
+// can report how much heap traffic building a model causes - including that
+// of a simulator library linked into it. The replacements are definitions,
+// so include this header in exactly one translation unit of a program: the
+// frontend's main file.
+namespace BenchUtils {
+namespace Detail {
+inline std::atomic<size_t> &getNumHeapAllocations(){ static std::atomic<size_t> n(0); return n; }
+inline std::atomic<size_t> &getNumHeapFrees(){ static std::atomic<size_t> n(0); return n; }
+inline std::atomic<size_t> &getHeapBytesAllocated(){ static std::atomic<size_t> n(0); return n; }
+}   // namespace Detail
+
+//----------------------------------------------------------------------------
+// BenchUtils::AllocationCounts
+//----------------------------------------------------------------------------
+//! Heap operations since the start of the program
+struct AllocationCounts
+{
+    size_t numAllocations;
+    size_t numFrees;
+    size_t bytesAllocated;
+
+    AllocationCounts operator-(const AllocationCounts &other) const
+    {
+        return AllocationCounts{numAllocations - other.numAllocations, numFrees - other.numFrees,
+                                bytesAllocated - other.bytesAllocated};
+    }
+};
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+inline AllocationCounts getAllocationCounts()
+{
+    return AllocationCounts{Detail::getNumHeapAllocations().load(std::memory_order_relaxed),
+                            Detail::getNumHeapFrees().load(std::memory_order_relaxed),
+                            Detail::getHeapBytesAllocated().load(std::memory_order_relaxed)};
+}
+
+//! Print the heap operations made since start with a label
+inline void printAllocationCounts(const std::string &title, const AllocationCounts &start)
+{
+    const AllocationCounts counts = getAllocationCounts() - start;
+    printf("%s heap: %zu allocations of %.2f MB in total, %zu frees\n",
+           title.c_str(), counts.numAllocations, (double)counts.bytesAllocated / (1024.0 * 1024.0), counts.numFrees);
+}
+}   // namespace BenchUtils
+
+// Array, nothrow and sized forms all end up in these two
+void *operator new(std::size_t bytes)
+{
+    BenchUtils::Detail::getNumHeapAllocations().fetch_add(1, std::memory_order_relaxed);
+    BenchUtils::Detail::getHeapBytesAllocated().fetch_add(bytes, std::memory_order_relaxed);
+    void *data = malloc((bytes == 0) ? 1 : bytes);
+    if(data == nullptr) {
+        throw std::bad_alloc();
+    }
+    return data;
+}
+
+// GCC pairs the free below with inlined new-expressions and warns of a mismatch
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void *data) noexcept
+{
+    if(data != nullptr) {
+        BenchUtils::Detail::getNumHeapFrees().fetch_add(1, std::memory_order_relaxed);
+        free(data);
+    }
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
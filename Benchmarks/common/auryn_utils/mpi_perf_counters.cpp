@@ -0,0 +1,78 @@
+#include "mpi_perf_counters.h"
+
+// Standard C++ includes
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+// Boost includes
+#include <boost/mpi/collectives.hpp>
+#include <boost/mpi/communicator.hpp>
+#include <boost/mpi/environment.hpp>
+#include <boost/serialization/string.hpp>
+
+// Shared includes
+#include "../perf_counters.h"
+
+//----------------------------------------------------------------------------
+// BenchUtils::MPIPerfCounters
+//----------------------------------------------------------------------------
+namespace BenchUtils {
+MPIPerfCounters::MPIPerfCounters() : m_Counters(new PerfCounters)
+{
+}
+//----------------------------------------------------------------------------
+MPIPerfCounters::~MPIPerfCounters()
+{
+    delete m_Counters;
+}
+//----------------------------------------------------------------------------
+void MPIPerfCounters::start()
+{
+    m_Counters->start();
+}
+//----------------------------------------------------------------------------
+void MPIPerfCounters::stop()
+{
+    m_Counters->stop();
+}
+//----------------------------------------------------------------------------
+void MPIPerfCounters::report(double seconds, const std::string &filename)
+{
+    // Auryn does not count the synaptic events it delivers
+    m_Counters->print(seconds, 0);
+
+    boost::mpi::communicator world;
+
+    // The memory controllers are counted system-wide, so only the lowest
+    // rank on each node contributes its node's traffic to the sum
+    std::vector<std::string> nodes;
+    boost::mpi::all_gather(world, boost::mpi::environment::processor_name(), nodes);
+    const bool countMemory = (std::find(nodes.begin(), nodes.end(), nodes[world.rank()]) - nodes.begin()) == world.rank();
+
+    std::vector<double> counts(PerfCounters::EVENT_MAX + 1);
+    std::vector<int> available(PerfCounters::EVENT_MAX + 1);
+    for(unsigned int e = 0; e < PerfCounters::EVENT_MAX; e++) {
+        counts[e] = m_Counters->getCount((PerfCounters::Event)e);
+        available[e] = m_Counters->isAvailable((PerfCounters::Event)e) ? 1 : 0;
+    }
+    counts[PerfCounters::EVENT_MAX] = countMemory ? m_Counters->getMemoryBytes() : 0.0;
+    available[PerfCounters::EVENT_MAX] = (!countMemory || m_Counters->isMemoryTrafficAvailable()) ? 1 : 0;
+
+    // A total is only available if every rank could count it
+    std::vector<double> totalCounts(counts.size());
+    std::vector<int> totalAvailable(available.size());
+    boost::mpi::reduce(world, counts.data(), (int)counts.size(), totalCounts.data(), std::plus<double>(), 0);
+    boost::mpi::reduce(world, available.data(), (int)available.size(), totalAvailable.data(), boost::mpi::minimum<int>(), 0);
+
+    if(world.rank() == 0) {
+        bool totalIsAvailable[PerfCounters::EVENT_MAX];
+        for(unsigned int e = 0; e < PerfCounters::EVENT_MAX; e++) {
+            totalIsAvailable[e] = (totalAvailable[e] != 0);
+        }
+        m_Counters->setTotals(totalCounts.data(), totalIsAvailable,
+                              totalCounts[PerfCounters::EVENT_MAX], totalAvailable[PerfCounters::EVENT_MAX] != 0);
+        m_Counters->write(filename, seconds, 0);
+    }
+}
+}   // namespace BenchUtils
@@ -0,0 +1,44 @@
+#pragma once
+
+// Standard C++ includes
+#include <string>
+
+//----------------------------------------------------------------------------
+// BenchUtils::MPIPerfCounters
+//----------------------------------------------------------------------------
+// Hardware performance counters for the Auryn simulations. These are built
+// with -ansi, while PerfCounters needs C++11, so this header only exposes a
+// C++98 interface and mpi_perf_counters.cpp is compiled separately.
+namespace BenchUtils {
+class PerfCounters;
+
+class MPIPerfCounters
+{
+public:
+    MPIPerfCounters();
+    ~MPIPerfCounters();
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Open and enable the counters on every current thread of this rank
+    void start();
+
+    //! Disable the counters and total them over this rank's threads
+    void stop();
+
+    //! Print this rank's counts, then sum them over every rank of
+    //! MPI_COMM_WORLD and write the sum to filename on rank 0. Must be
+    //! called on every rank.
+    void report(double seconds, const std::string &filename);
+
+private:
+    MPIPerfCounters(const MPIPerfCounters&);
+    MPIPerfCounters &operator=(const MPIPerfCounters&);
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    PerfCounters *m_Counters;
+};
+}   // namespace BenchUtils
@@ -0,0 +1,364 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cmath>
+#include <cstdint>
+
+// CPU engine includes
+#include "neuron_groups.h"
+#include "projection.h"
+
+//----------------------------------------------------------------------------
+// Batched simulation
+//----------------------------------------------------------------------------
+// B instances of one network - differing in parameters, input rates or seeds
+// - simulated together from a single copy of the connectivity. Neuron state
+// and input rings are laid out [neuron][instance], so neuron updates are B
+// wide vector operations as B is a compile-time constant, and a row is
+// walked once per step however many instances it spiked in, every synapse
+// feeding those instances' adjacent accumulators. With uncorrelated low-rate
+// activity a row rarely spikes in several instances on the same step, so
+// this saves little time: what batching saves is the memory of B - 1 copies
+// of the connectivity.
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::BatchGroup
+//----------------------------------------------------------------------------
+//! Base class for B instances of a population. getSpikes() lists the neurons
+//! which spiked in any instance and getSpikeMask() holds, for each of those,
+//! B flags of 1.0f or 0.0f saying which instances they spiked in.
+template<unsigned int B>
+class BatchGroup : public NeuronGroup
+{
+public:
+    BatchGroup(const std::string &name, unsigned int size, unsigned int numReceptors)
+    : NeuronGroup(name, size, numReceptors, B), m_InstanceSpikes(B)
+    {}
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        NeuronGroup::addMemoryFootprint(footprint);
+        footprint.add(MEMORY_NEURON_STATE, m_SpikeMask);
+        footprint.add(MEMORY_NEURON_STATE, m_InstanceSpikes);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    const std::vector<float> &getSpikeMask() const{ return m_SpikeMask; }
+
+    //! Spikes of one instance in the most recent update
+    const std::vector<unsigned int> &getInstanceSpikes(unsigned int b) const{ return m_InstanceSpikes[b]; }
+
+protected:
+    void clearSpikes()
+    {
+        m_Spikes.clear();
+        m_SpikeMask.clear();
+        for(auto &spikes : m_InstanceSpikes) {
+            spikes.clear();
+        }
+    }
+
+    //! Record neuron i as having spiked in the instances flagged in spiked
+    void addSpike(unsigned int i, const bool *spiked)
+    {
+        m_Spikes.push_back(i);
+        for(unsigned int b = 0; b < B; b++) {
+            m_SpikeMask.push_back(spiked[b] ? 1.0f : 0.0f);
+            if(spiked[b]) {
+                m_InstanceSpikes[b].push_back(i);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<float> m_SpikeMask;
+    std::vector<std::vector<unsigned int>> m_InstanceSpikes;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::BatchPoissonGroup
+//----------------------------------------------------------------------------
+//! B instances of PoissonGroup, each with its own rate and generator. Each
+//! instance draws exactly the numbers a PoissonGroup with its seed would.
+template<unsigned int B>
+class BatchPoissonGroup : public BatchGroup<B>
+{
+public:
+    BatchPoissonGroup(const std::string &name, unsigned int size, const std::array<double, B> &ratesHz,
+                      double dtMs, const std::array<uint64_t, B> &seeds)
+    : BatchGroup<B>(name, size, 0)
+    {
+        for(unsigned int b = 0; b < B; b++) {
+            m_LogOneMinusP[b] = std::log(1.0 - (ratesHz[b] * dtMs / 1000.0));
+            m_Rng.emplace_back(seeds[b]);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void update(unsigned long long) override
+    {
+        this->clearSpikes();
+
+        // Draw each instance's spikes, then merge them by neuron index
+        m_Merge.clear();
+        for(unsigned int b = 0; b < B; b++) {
+            if(m_LogOneMinusP[b] == 0.0) {
+                continue;
+            }
+            for(uint64_t i = m_Rng[b].geometric(m_LogOneMinusP[b]); i < this->m_Size; i += 1 + m_Rng[b].geometric(m_LogOneMinusP[b])) {
+                m_Merge.emplace_back((unsigned int)i, b);
+            }
+        }
+        std::sort(m_Merge.begin(), m_Merge.end());
+
+        bool spiked[B];
+        for(size_t m = 0; m < m_Merge.size();) {
+            const unsigned int i = m_Merge[m].first;
+            std::fill_n(spiked, B, false);
+            for(; m < m_Merge.size() && m_Merge[m].first == i; m++) {
+                spiked[m_Merge[m].second] = true;
+            }
+            this->addSpike(i, spiked);
+        }
+    }
+
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        NeuronGroup::saveState(writer);
+        writer.write(m_Rng);
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        NeuronGroup::restoreState(reader);
+        reader.read(m_Rng);
+    }
+
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        BatchGroup<B>::addMemoryFootprint(footprint);
+        footprint.add(MEMORY_NEURON_STATE, m_Rng);
+        footprint.add(MEMORY_NEURON_STATE, m_Merge);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::array<double, B> m_LogOneMinusP;
+    std::vector<Rng> m_Rng;
+
+    //! (neuron, instance) pairs of this step's spikes
+    std::vector<std::pair<unsigned int, unsigned int>> m_Merge;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::BatchLIFDeltaGroup
+//----------------------------------------------------------------------------
+//! B instances of LIFDeltaGroup, each with its own parameters. The update is
+//! written without branches on the state so the instance loop vectorises,
+//! but performs the same float operations as LIFDeltaGroup::update.
+template<unsigned int B>
+class BatchLIFDeltaGroup : public BatchGroup<B>
+{
+public:
+    BatchLIFDeltaGroup(const std::string &name, unsigned int size, const std::array<LIFParams, B> &params, double dtMs)
+    : BatchGroup<B>(name, size, 1), m_RefracRemain(size * B, 0)
+    {
+        m_V.reserve(size * B);
+        for(unsigned int i = 0; i < size; i++) {
+            for(unsigned int b = 0; b < B; b++) {
+                m_V.push_back((float)params[b].vRest);
+            }
+        }
+        for(unsigned int b = 0; b < B; b++) {
+            m_Alpha[b] = (float)(dtMs / params[b].tauM);
+            m_VRest[b] = (float)params[b].vRest;
+            m_VReset[b] = (float)params[b].vReset;
+            m_VThresh[b] = (float)params[b].vThresh;
+            m_IOffset[b] = (float)params[b].iOffset;
+            m_RefracSteps[b] = (unsigned int)std::round(params[b].tauRefrac / dtMs);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void update(unsigned long long step) override
+    {
+        this->clearSpikes();
+        float *input = this->m_Inputs[0].getSlot(step);
+        for(unsigned int i = 0; i < this->m_Size; i++) {
+            float *v = &m_V[(size_t)i * B];
+            unsigned int *refracRemain = &m_RefracRemain[(size_t)i * B];
+            float *in = &input[(size_t)i * B];
+
+            // Inputs arriving during the refractory period are discarded
+            bool spiked[B];
+            bool anySpiked = false;
+            for(unsigned int b = 0; b < B; b++) {
+                const bool active = (refracRemain[b] == 0);
+                const float newV = v[b] + (m_Alpha[b] * ((m_VRest[b] - v[b]) + m_IOffset[b]) + in[b]);
+                spiked[b] = active && (newV >= m_VThresh[b]);
+                v[b] = spiked[b] ? m_VReset[b] : (active ? newV : v[b]);
+                refracRemain[b] = spiked[b] ? m_RefracSteps[b] : (active ? 0 : refracRemain[b] - 1);
+                in[b] = 0.0f;
+                anySpiked |= spiked[b];
+            }
+            if(anySpiked) {
+                this->addSpike(i, spiked);
+            }
+        }
+    }
+
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        NeuronGroup::saveState(writer);
+        writer.write(m_V);
+        writer.write(m_RefracRemain);
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        NeuronGroup::restoreState(reader);
+        reader.read(m_V);
+        reader.read(m_RefracRemain);
+    }
+
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        BatchGroup<B>::addMemoryFootprint(footprint);
+        footprint.add(MEMORY_NEURON_STATE, m_V);
+        footprint.add(MEMORY_NEURON_STATE, m_RefracRemain);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    BenchUtils::HugePageVector<float> m_V;
+    BenchUtils::HugePageVector<unsigned int> m_RefracRemain;
+
+    std::array<float, B> m_Alpha;
+    std::array<float, B> m_VRest;
+    std::array<float, B> m_VReset;
+    std::array<float, B> m_VThresh;
+    std::array<float, B> m_IOffset;
+    std::array<unsigned int, B> m_RefracSteps;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::BatchProjection
+//----------------------------------------------------------------------------
+//! Static projection between two batched groups with shared connectivity and
+//! a uniform delay. Instance b's weights are the shared weights times
+//! instanceScale[b], so e.g. the relative strength of inhibition can be swept.
+template<unsigned int B>
+class BatchProjection : public Projection
+{
+public:
+    BatchProjection(BatchGroup<B> &pre, BatchGroup<B> &post, unsigned int receptor,
+                    BenchUtils::CSRConnectivity &&csr, unsigned int delay, const std::array<float, B> &instanceScale)
+    : Projection(pre, post, receptor, std::move(csr), delay), m_BatchPre(pre), m_InstanceScale(instanceScale)
+    {}
+
+    //------------------------------------------------------------------------
+    // Projection virtuals
+    //------------------------------------------------------------------------
+    //! Batched groups are not partitionable, so neither are their projections
+    virtual bool isPartitionable() const override{ return false; }
+
+    //! Each row which spiked in any instance is walked once. Rows which spiked
+    //! in many instances update all B accumulators of each target, with a
+    //! scale of zero for the instances they did not spike in; rows which
+    //! spiked in only a few just update those instances' accumulators
+    virtual void propagate(unsigned long long step) override
+    {
+        const auto &spikes = m_BatchPre.getSpikes();
+        if(spikes.empty()) {
+            return;
+        }
+
+        const float *spikeMask = m_BatchPre.getSpikeMask().data();
+        float *out = m_Post.getInput(m_Receptor).getSlot(step + m_Delays[0]);
+        for(size_t k = 0; k < spikes.size(); k++) {
+            const unsigned int i = spikes[k];
+            const unsigned int rowStart = m_RowStart[i];
+            const unsigned int rowEnd = m_RowStart[i + 1];
+
+            unsigned int instances[B];
+            unsigned int numInstances = 0;
+            for(unsigned int b = 0; b < B; b++) {
+                if(spikeMask[k * B + b] != 0.0f) {
+                    instances[numInstances++] = b;
+                }
+            }
+
+            if(numInstances > s_SparseInstances) {
+                float scale[B];
+                for(unsigned int b = 0; b < B; b++) {
+                    scale[b] = spikeMask[k * B + b] * m_InstanceScale[b];
+                }
+                for(unsigned int s = rowStart; s < rowEnd; s++) {
+                    const float weight = m_Weight[s];
+                    float *postOut = &out[(size_t)m_Ind[s] * B];
+                    for(unsigned int b = 0; b < B; b++) {
+                        postOut[b] += weight * scale[b];
+                    }
+                }
+                CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, (uint64_t)numInstances * (rowEnd - rowStart));
+            }
+            else if(numInstances == 1) {
+                const unsigned int b = instances[0];
+                const float scale = m_InstanceScale[b];
+                for(unsigned int s = rowStart; s < rowEnd; s++) {
+                    out[(size_t)m_Ind[s] * B + b] += m_Weight[s] * scale;
+                }
+                CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, (uint64_t)(rowEnd - rowStart));
+            }
+            else {
+                float scale[B];
+                for(unsigned int n = 0; n < numInstances; n++) {
+                    scale[n] = m_InstanceScale[instances[n]];
+                }
+                for(unsigned int s = rowStart; s < rowEnd; s++) {
+                    const float weight = m_Weight[s];
+                    float *postOut = &out[(size_t)m_Ind[s] * B];
+                    for(unsigned int n = 0; n < numInstances; n++) {
+                        postOut[instances[n]] += weight * scale[n];
+                    }
+                }
+                CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, (uint64_t)numInstances * (rowEnd - rowStart));
+            }
+            m_NumSynapticEvents += (uint64_t)numInstances * (rowEnd - rowStart);
+        }
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    BatchGroup<B> &m_BatchPre;
+    const std::array<float, B> m_InstanceScale;
+
+    //! Rows which spiked in at most this many instances are propagated
+    //! instance by instance rather than to all B accumulators
+    static constexpr unsigned int s_SparseInstances = 2;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,197 @@
+#pragma once
+
+// Standard C++ includes
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+#include <cstring>
+
+//----------------------------------------------------------------------------
+// Checkpoint file format
+//----------------------------------------------------------------------------
+// A header:
+//   char[4] "CKPT", uint32 version
+// followed by named sections, each written by one stateful object:
+//   uint64 nameLength, name, the object's values
+// Values are stored raw in native byte order and vectors are prefixed with
+// their uint64 length, so a checkpoint is only meant to be restored by the
+// same build of the same model. Section names are checked on restore, which
+// catches a checkpoint from a network with different groups or projections.
+namespace CPUEngine {
+namespace CheckpointFormat {
+const char magic[4] = {'C', 'K', 'P', 'T'};
+const uint32_t version = 1;
+}
+
+//----------------------------------------------------------------------------
+// CPUEngine::CheckpointWriter
+//----------------------------------------------------------------------------
+//! Serialises state into memory so the file is written with a single call
+class CheckpointWriter
+{
+public:
+    CheckpointWriter()
+    {
+        append(CheckpointFormat::magic, sizeof(CheckpointFormat::magic));
+        write(CheckpointFormat::version);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void beginSection(const std::string &name)
+    {
+        write(std::vector<char>(name.begin(), name.end()));
+    }
+
+    template<typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be checkpointed");
+        append(&value, sizeof(T));
+    }
+
+    template<typename T, typename A>
+    void write(const std::vector<T, A> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be checkpointed");
+        write((uint64_t)values.size());
+        append(values.data(), values.size() * sizeof(T));
+    }
+
+    void save(const std::string &filename) const
+    {
+        std::ofstream stream(filename, std::ios::binary);
+        if(!stream.write(m_Data.data(), m_Data.size()) || !stream.flush()) {
+            throw std::runtime_error("Could not write checkpoint file: " + filename);
+        }
+    }
+
+    size_t getNumBytes() const{ return m_Data.size(); }
+
+private:
+    void append(const void *data, size_t numBytes)
+    {
+        const char *bytes = static_cast<const char*>(data);
+        m_Data.insert(m_Data.end(), bytes, bytes + numBytes);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<char> m_Data;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::CheckpointReader
+//----------------------------------------------------------------------------
+//! Reads a whole checkpoint with a single call and hands its values back in
+//! the order they were written
+class CheckpointReader
+{
+public:
+    CheckpointReader(const std::string &filename) : m_Filename(filename), m_Position(0)
+    {
+        std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+        if(!stream.good()) {
+            throw std::runtime_error("Could not open checkpoint file: " + filename);
+        }
+        m_Data.resize((size_t)stream.tellg());
+        stream.seekg(0);
+        if(!stream.read(m_Data.data(), m_Data.size())) {
+            throw std::runtime_error("Could not read checkpoint file: " + filename);
+        }
+
+        char magic[4];
+        uint32_t version;
+        if(m_Data.size() < sizeof(magic) + sizeof(version)) {
+            throw std::runtime_error(filename + " is not a checkpoint file");
+        }
+        consume(magic, sizeof(magic));
+        read(version);
+        if(memcmp(magic, CheckpointFormat::magic, sizeof(magic)) != 0 || version != CheckpointFormat::version) {
+            throw std::runtime_error(filename + " is not a checkpoint file");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void beginSection(const std::string &name)
+    {
+        std::vector<char> fileName;
+        readResize(fileName);
+        if(std::string(fileName.begin(), fileName.end()) != name) {
+            throw std::runtime_error("Checkpoint " + m_Filename + " has state for '" + std::string(fileName.begin(), fileName.end())
+                                     + "' where '" + name + "' was expected - was it saved from this model?");
+        }
+    }
+
+    template<typename T>
+    void read(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be checkpointed");
+        consume(&value, sizeof(T));
+    }
+
+    //! Read into a vector which must already have the saved length
+    template<typename T, typename A>
+    void read(std::vector<T, A> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be checkpointed");
+        uint64_t size;
+        read(size);
+        if(size != values.size()) {
+            throw std::runtime_error("Checkpoint " + m_Filename + " has " + std::to_string(size)
+                                     + " values where the model has " + std::to_string(values.size()));
+        }
+        consume(values.data(), values.size() * sizeof(T));
+    }
+
+    //! Read into a vector of variable length, such as a spike list
+    template<typename T, typename A>
+    void readResize(std::vector<T, A> &values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be checkpointed");
+        uint64_t size;
+        read(size);
+        if(size > (m_Data.size() - m_Position) / sizeof(T)) {
+            throw std::runtime_error("Checkpoint " + m_Filename + " is truncated");
+        }
+        values.resize((size_t)size);
+        consume(values.data(), values.size() * sizeof(T));
+    }
+
+    //! Check every saved value has been restored
+    void finish() const
+    {
+        if(m_Position != m_Data.size()) {
+            throw std::runtime_error("Checkpoint " + m_Filename + " has more state than the model");
+        }
+    }
+
+private:
+    void consume(void *data, size_t numBytes)
+    {
+        if(numBytes > m_Data.size() - m_Position) {
+            throw std::runtime_error("Checkpoint " + m_Filename + " is truncated");
+        }
+        if(numBytes > 0) {
+            memcpy(data, &m_Data[m_Position], numBytes);
+        }
+        m_Position += numBytes;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Filename;
+    std::vector<char> m_Data;
+    size_t m_Position;
+};
+}   // namespace CPUEngine
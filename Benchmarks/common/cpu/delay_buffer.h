@@ -0,0 +1,69 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <vector>
+
+// Shared includes
+#include "../huge_pages.h"
+
+// CPU engine includes
+#include "checkpoint.h"
+#include "memory_footprint.h"
+
+//----------------------------------------------------------------------------
+// CPUEngine::DelayBuffer
+//----------------------------------------------------------------------------
+//! Ring of per-neuron input accumulators, one slot per timestep of delay. Projections
+//! add into the slot their spikes arrive in; the neuron group consumes and clears the
+//! slot for the current step. Delay therefore costs one ring per receptor rather than
+//! any per-synapse storage.
+namespace CPUEngine {
+class DelayBuffer
+{
+public:
+    DelayBuffer(unsigned int numNeurons)
+    : m_NumNeurons(numNeurons), m_NumSlots(1)
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Make sure inputs can be scheduled this many steps ahead - call before allocate()
+    void requireDelay(unsigned int delay)
+    {
+        m_NumSlots = std::max(m_NumSlots, delay + 1);
+    }
+
+    void allocate()
+    {
+        m_Data.assign((size_t)m_NumSlots * m_NumNeurons, 0.0f);
+    }
+
+    //! Accumulators for inputs arriving at step
+    float *getSlot(unsigned long long step)
+    {
+        return &m_Data[(size_t)(step % m_NumSlots) * m_NumNeurons];
+    }
+
+    //! Inputs already scheduled for future steps
+    void saveState(CheckpointWriter &writer) const{ writer.write(m_Data); }
+    void restoreState(CheckpointReader &reader){ reader.read(m_Data); }
+
+    void addMemoryFootprint(MemoryFootprint &footprint) const{ footprint.add(MEMORY_DELAY_BUFFERS, m_Data); }
+
+    //! The whole ring, slot-major
+    float *getData(){ return m_Data.data(); }
+
+    unsigned int getNumSlots() const{ return m_NumSlots; }
+    unsigned int getNumNeurons() const{ return m_NumNeurons; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const unsigned int m_NumNeurons;
+    unsigned int m_NumSlots;
+    BenchUtils::HugePageVector<float> m_Data;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,160 @@
+#pragma once
+
+// Standard C++ includes
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Standard C includes
+#include <cerrno>
+#include <cstdio>
+
+// POSIX includes
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Shared includes
+#include "../memory_usage.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::EnsembleMemory
+//----------------------------------------------------------------------------
+//! Footprint of an ensemble, measured once every trial has finished but
+//! before any has exited so shared pages are counted exactly once
+struct EnsembleMemory
+{
+    //! PSS of the process which built the network
+    size_t parentPSS;
+
+    //! Sum of the trials' PSS - their private state plus their shares of the network
+    size_t trialsPSS;
+
+    //! Sum of the trials' private pages i.e. what each trial adds to the shared network
+    size_t trialsPrivate;
+
+    //! Sum of the trials' RSS - roughly what the trials would need as separate runs
+    size_t trialsRSS;
+
+    size_t getTotalPSS() const{ return parentPSS + trialsPSS; }
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::runEnsemble
+//----------------------------------------------------------------------------
+//! Run numTrials trials of an already built model concurrently, each in a
+//! process forked from this one. Connectivity loaded before the fork is
+//! shared copy-on-write, so as long as trials do not write to it (see
+//! Network::setConnectivityReadOnly) each trial only costs its own state.
+//! trial(i) runs in the child and its Result is sent back to the parent.
+template<typename Result>
+std::vector<Result> runEnsemble(unsigned int numTrials, const std::function<Result(unsigned int)> &trial, EnsembleMemory &memory)
+{
+    struct Message
+    {
+        unsigned int trial;
+        Result result;
+    };
+    static_assert(std::is_trivially_copyable<Result>::value, "Trial results are sent back through a pipe");
+    static_assert(sizeof(Message) <= PIPE_BUF, "Trial results must be written atomically");
+
+    // Trials send their results through one pipe and then wait for the
+    // other to close, which keeps them alive until memory has been measured
+    int resultPipe[2];
+    int releasePipe[2];
+    if(pipe(resultPipe) != 0 || pipe(releasePipe) != 0) {
+        throw std::runtime_error("Cannot create ensemble pipes");
+    }
+
+    // Anything still buffered would otherwise be printed once per trial
+    fflush(nullptr);
+
+    std::vector<pid_t> pids;
+    for(unsigned int i = 0; i < numTrials; i++) {
+        const pid_t pid = fork();
+        if(pid < 0) {
+            // Trials already started see the release pipe close and exit
+            close(resultPipe[0]);
+            close(resultPipe[1]);
+            close(releasePipe[1]);
+            close(releasePipe[0]);
+            for(pid_t p : pids) {
+                waitpid(p, nullptr, 0);
+            }
+            throw std::runtime_error("Cannot fork trial " + std::to_string(i));
+        }
+        else if(pid == 0) {
+            close(resultPipe[0]);
+            close(releasePipe[1]);
+
+            int status = 1;
+            try {
+                const Message message = {i, trial(i)};
+                if(write(resultPipe[1], &message, sizeof(Message)) == (ssize_t)sizeof(Message)) {
+                    status = 0;
+                }
+            }
+            catch(const std::exception &e) {
+                printf("Trial %u failed: %s\n", i, e.what());
+            }
+            close(resultPipe[1]);
+            fflush(nullptr);
+
+            char c;
+            while(read(releasePipe[0], &c, 1) < 0 && errno == EINTR) {
+            }
+            _exit(status);
+        }
+        pids.push_back(pid);
+    }
+    close(resultPipe[1]);
+    close(releasePipe[0]);
+
+    // Collect results until every trial has finished or died
+    std::vector<Result> results(numTrials);
+    std::vector<bool> received(numTrials, false);
+    Message message;
+    while(true) {
+        const ssize_t bytes = read(resultPipe[0], &message, sizeof(Message));
+        if(bytes == (ssize_t)sizeof(Message) && message.trial < numTrials) {
+            results[message.trial] = message.result;
+            received[message.trial] = true;
+        }
+        else if(bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        else if(bytes <= 0) {
+            break;
+        }
+    }
+    close(resultPipe[0]);
+
+    // Every trial is now idle so this is the ensemble's peak footprint
+    memory.parentPSS = BenchUtils::getPSS();
+    memory.trialsPSS = 0;
+    memory.trialsPrivate = 0;
+    memory.trialsRSS = 0;
+    for(pid_t p : pids) {
+        memory.trialsPSS += BenchUtils::getPSS(std::to_string(p));
+        memory.trialsPrivate += BenchUtils::getPrivateBytes(std::to_string(p));
+        memory.trialsRSS += BenchUtils::getProcFieldBytes("/proc/" + std::to_string(p) + "/status", "VmRSS");
+    }
+
+    close(releasePipe[1]);
+    unsigned int numFailed = 0;
+    for(unsigned int i = 0; i < numTrials; i++) {
+        int status;
+        if(waitpid(pids[i], &status, 0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || !received[i]) {
+            numFailed++;
+        }
+    }
+    if(numFailed > 0) {
+        throw std::runtime_error(std::to_string(numFailed) + " of " + std::to_string(numTrials) + " trials failed");
+    }
+    return results;
+}
+}   // namespace CPUEngine
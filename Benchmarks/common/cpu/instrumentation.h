@@ -0,0 +1,231 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+// Standard C includes
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// POSIX includes
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//----------------------------------------------------------------------------
+// Step instrumentation
+//----------------------------------------------------------------------------
+// Built with CPU_ENGINE_INSTRUMENT defined (cmake -DINSTRUMENT=ON), the engine
+// times each phase of a step with the cycle counter and counts spikes and
+// synaptic events. Every thread accumulates into its own cache-line aligned
+// slot, so nothing is shared or locked while simulating; printReport() sums
+// the slots once the threads are idle. Phases nest and time is charged only
+// to the innermost one, so e.g. plasticity inside a projection's propagate()
+// is not counted as propagation too. Without CPU_ENGINE_INSTRUMENT the
+// macros expand to nothing, and their arguments are not evaluated.
+#ifdef CPU_ENGINE_INSTRUMENT
+#define CPU_ENGINE_PHASE(PHASE) CPUEngine::Instrumentation::ScopedPhase cpuEnginePhase(CPUEngine::Instrumentation::PHASE)
+#define CPU_ENGINE_COUNT(COUNTER, N) (CPUEngine::Instrumentation::getThreadSlot().counts[CPUEngine::Instrumentation::COUNTER] += (N))
+#else
+#define CPU_ENGINE_PHASE(PHASE)
+#define CPU_ENGINE_COUNT(COUNTER, N)
+#endif
+
+namespace CPUEngine {
+namespace Instrumentation {
+enum Phase
+{
+    PHASE_NEURON_UPDATE,
+    PHASE_GATHER,
+    PHASE_PROPAGATION,
+    PHASE_PLASTICITY,
+    PHASE_RECORDING,
+    PHASE_WAIT,
+    PHASE_MAX,
+};
+
+enum Counter
+{
+    COUNTER_STEPS,
+    COUNTER_SPIKES,
+    COUNTER_SYNAPTIC_EVENTS,
+    COUNTER_MAX,
+};
+
+#ifdef CPU_ENGINE_INSTRUMENT
+//! Cycle counter where there is one, otherwise nanoseconds
+inline uint64_t readTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+//----------------------------------------------------------------------------
+// CPUEngine::Instrumentation::ThreadSlot
+//----------------------------------------------------------------------------
+//! One thread's totals. Only its own thread writes to it.
+struct alignas(64) ThreadSlot
+{
+    uint64_t ticks[PHASE_MAX];
+    uint64_t counts[COUNTER_MAX];
+
+    //! Innermost phase being timed, or -1, and when it was last charged
+    int current;
+    uint64_t lastTicks;
+};
+
+constexpr unsigned int maxThreads = 256;
+
+//! Every thread's slot and how many have been claimed
+struct Slots
+{
+    ThreadSlot slots[maxThreads];
+    std::atomic<unsigned int> numClaimed;
+
+    //! Clock readings which calibrate ticks against seconds
+    uint64_t startTicks;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+inline Slots &getSlots()
+{
+    static Slots slots;
+    return slots;
+}
+
+//! The calling thread's slot, claimed on its first use
+inline ThreadSlot &getThreadSlot()
+{
+    static thread_local ThreadSlot *slot = nullptr;
+    if(slot == nullptr) {
+        const unsigned int index = getSlots().numClaimed.fetch_add(1, std::memory_order_relaxed);
+        if(index >= maxThreads) {
+            throw std::runtime_error("More than " + std::to_string(maxThreads) + " threads are instrumented");
+        }
+        slot = &getSlots().slots[index];
+        slot->current = -1;
+    }
+    return *slot;
+}
+
+//----------------------------------------------------------------------------
+// CPUEngine::Instrumentation::ScopedPhase
+//----------------------------------------------------------------------------
+//! Charges the time until it is destroyed to phase, pausing any enclosing phase
+class ScopedPhase
+{
+public:
+    ScopedPhase(Phase phase) : m_Slot(getThreadSlot()), m_Parent(m_Slot.current)
+    {
+        charge();
+        m_Slot.current = phase;
+    }
+
+    ~ScopedPhase()
+    {
+        charge();
+        m_Slot.current = m_Parent;
+    }
+
+private:
+    void charge()
+    {
+        const uint64_t now = readTicks();
+        if(m_Slot.current >= 0) {
+            m_Slot.ticks[m_Slot.current] += now - m_Slot.lastTicks;
+        }
+        m_Slot.lastTicks = now;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    ThreadSlot &m_Slot;
+    const int m_Parent;
+};
+#endif  // CPU_ENGINE_INSTRUMENT
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Zero every thread's totals, e.g. once the model is built - only call while
+//! no instrumented code is running
+inline void reset()
+{
+#ifdef CPU_ENGINE_INSTRUMENT
+    Slots &slots = getSlots();
+    for(unsigned int t = 0; t < std::min(slots.numClaimed.load(), maxThreads); t++) {
+        std::fill_n(slots.slots[t].ticks, PHASE_MAX, 0);
+        std::fill_n(slots.slots[t].counts, COUNTER_MAX, 0);
+    }
+    slots.startTicks = readTicks();
+    slots.startTime = std::chrono::steady_clock::now();
+#endif
+}
+
+//! Print the time each phase took, as the mean and maximum over the threads
+//! which ran it, and the event counts and rates since reset(). Rates are per
+//! second of simulationSeconds. Only call while no instrumented code is running.
+inline void printReport(double simulationSeconds)
+{
+#ifdef CPU_ENGINE_INSTRUMENT
+    static const char *phaseNames[PHASE_MAX] = {"neuron update", "spike gather", "propagation",
+                                                "plasticity", "recording", "waiting"};
+
+    Slots &slots = getSlots();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - slots.startTime).count();
+    const double ticksPerSecond = (double)(readTicks() - slots.startTicks) / elapsed;
+    const unsigned int numThreads = std::min(slots.numClaimed.load(), maxThreads);
+
+    uint64_t counts[COUNTER_MAX] = {};
+    double totalSeconds = 0.0;
+    double meanSeconds[PHASE_MAX] = {};
+    double maxSeconds[PHASE_MAX] = {};
+    for(unsigned int p = 0; p < PHASE_MAX; p++) {
+        unsigned int numRan = 0;
+        for(unsigned int t = 0; t < numThreads; t++) {
+            const double seconds = (double)slots.slots[t].ticks[p] / ticksPerSecond;
+            if(seconds > 0.0) {
+                numRan++;
+                meanSeconds[p] += seconds;
+                maxSeconds[p] = std::max(maxSeconds[p], seconds);
+            }
+        }
+        meanSeconds[p] /= std::max(1u, numRan);
+        totalSeconds += meanSeconds[p];
+    }
+    for(unsigned int t = 0; t < numThreads; t++) {
+        for(unsigned int c = 0; c < COUNTER_MAX; c++) {
+            counts[c] += slots.slots[t].counts[c];
+        }
+    }
+
+    const double steps = (double)std::max<uint64_t>(1, counts[COUNTER_STEPS]);
+    printf("Phase           Mean (s)   Max (s)  Share  Per step (us)\n");
+    for(unsigned int p = 0; p < PHASE_MAX; p++) {
+        printf("%-14s %9.4f %9.4f %5.1f%% %14.3f\n", phaseNames[p], meanSeconds[p], maxSeconds[p],
+               (totalSeconds > 0.0) ? 100.0 * meanSeconds[p] / totalSeconds : 0.0, 1.0E6 * meanSeconds[p] / steps);
+    }
+    printf("%llu steps on %u threads: %llu spikes (%.1f per step), %llu synaptic events (%.1f per step), %.4g events/s\n",
+           (unsigned long long)counts[COUNTER_STEPS], numThreads,
+           (unsigned long long)counts[COUNTER_SPIKES], (double)counts[COUNTER_SPIKES] / steps,
+           (unsigned long long)counts[COUNTER_SYNAPTIC_EVENTS], (double)counts[COUNTER_SYNAPTIC_EVENTS] / steps,
+           (double)counts[COUNTER_SYNAPTIC_EVENTS] / simulationSeconds);
+#else
+    (void)simulationSeconds;
+#endif
+}
+}   // namespace Instrumentation
+}   // namespace CPUEngine
@@ -0,0 +1,101 @@
+#pragma once
+
+// Standard C++ includes
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cstddef>
+#include <cstdio>
+
+//----------------------------------------------------------------------------
+// CPUEngine::MemoryFootprint
+//----------------------------------------------------------------------------
+//! Bytes held by the engine's arrays, by what they are for. Arrays are counted
+//! by capacity, so slack left by growing a vector shows up. Containers' own
+//! headers and small fixed-size members are not counted.
+namespace CPUEngine {
+enum MemoryCategory
+{
+    MEMORY_NEURON_STATE,
+    MEMORY_DELAY_BUFFERS,
+    MEMORY_SYNAPSES,
+    MEMORY_PLASTICITY,
+    MEMORY_RECORDERS,
+    MEMORY_MAX,
+};
+
+class MemoryFootprint
+{
+public:
+    MemoryFootprint() : m_Bytes()
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void add(MemoryCategory category, size_t bytes){ m_Bytes[category] += bytes; }
+
+    template<typename T, typename A>
+    void add(MemoryCategory category, const std::vector<T, A> &data)
+    {
+        m_Bytes[category] += data.capacity() * sizeof(T);
+    }
+
+    //! Arrays of arrays, such as per-partition spike lists, count their elements' storage too
+    template<typename T, typename A, typename B>
+    void add(MemoryCategory category, const std::vector<std::vector<T, A>, B> &data)
+    {
+        m_Bytes[category] += data.capacity() * sizeof(std::vector<T, A>);
+        for(const auto &d : data) {
+            add(category, d);
+        }
+    }
+
+    size_t getBytes(MemoryCategory category) const{ return m_Bytes[category]; }
+
+    size_t getTotalBytes() const
+    {
+        size_t total = 0;
+        for(unsigned int c = 0; c < MEMORY_MAX; c++) {
+            total += m_Bytes[c];
+        }
+        return total;
+    }
+
+    //! Print each category and the bytes per neuron of the neuron state and
+    //! delay buffers, and per synapse of the synapses and plasticity
+    void print(const std::string &title, size_t numNeurons, size_t numSynapses) const
+    {
+        static const char *categoryNames[MEMORY_MAX] = {"neuron state", "delay buffers", "synapses",
+                                                        "plasticity", "recorders"};
+
+        const double mb = 1024.0 * 1024.0;
+        printf("%s engine memory: %.2f MB", title.c_str(), (double)getTotalBytes() / mb);
+        for(unsigned int c = 0; c < MEMORY_MAX; c++) {
+            printf("%s %.2f MB %s", (c == 0) ? " -" : ",", (double)m_Bytes[c] / mb, categoryNames[c]);
+        }
+        printf("\n");
+
+        if(numNeurons > 0) {
+            printf("  %.1f bytes per neuron (%.1f state, %.1f delay buffers)\n",
+                   (double)(m_Bytes[MEMORY_NEURON_STATE] + m_Bytes[MEMORY_DELAY_BUFFERS]) / (double)numNeurons,
+                   (double)m_Bytes[MEMORY_NEURON_STATE] / (double)numNeurons,
+                   (double)m_Bytes[MEMORY_DELAY_BUFFERS] / (double)numNeurons);
+        }
+        if(numSynapses > 0) {
+            printf("  %.2f bytes per synapse (%.2f connectivity, %.2f plasticity), %.2f including everything else\n",
+                   (double)(m_Bytes[MEMORY_SYNAPSES] + m_Bytes[MEMORY_PLASTICITY]) / (double)numSynapses,
+                   (double)m_Bytes[MEMORY_SYNAPSES] / (double)numSynapses,
+                   (double)m_Bytes[MEMORY_PLASTICITY] / (double)numSynapses,
+                   (double)getTotalBytes() / (double)numSynapses);
+        }
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    size_t m_Bytes[MEMORY_MAX];
+};
+}   // namespace CPUEngine
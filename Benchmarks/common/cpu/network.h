@@ -0,0 +1,417 @@
+#pragma once
+
+// Standard C++ includes
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstdio>
+#include <cstring>
+
+// POSIX includes
+#include <sys/mman.h>
+#include <unistd.h>
+
+// CPU engine includes
+#include "checkpoint.h"
+#include "instrumentation.h"
+#include "memory_footprint.h"
+#include "neuron_groups.h"
+#include "partition.h"
+#include "projection.h"
+
+//----------------------------------------------------------------------------
+// CPUEngine::Network
+//----------------------------------------------------------------------------
+//! Owns the groups and projections of a model and advances them together.
+//! Each step, groups first consume the inputs arriving at that step and then
+//! every projection schedules the resulting spikes at least one step ahead.
+namespace CPUEngine {
+class Network
+{
+public:
+    Network(double dtMs)
+    : m_DT(dtMs), m_Step(0), m_ConnectivityReadOnly(false)
+    {}
+
+    ~Network()
+    {
+        // The allocator may reuse protected pages once the projections free them
+        if(m_ConnectivityReadOnly) {
+            setConnectivityReadOnly(false);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    template<typename G, typename... Args>
+    G &addGroup(Args&&... args)
+    {
+        G *group = new G(std::forward<Args>(args)...);
+        m_Groups.emplace_back(group);
+        return *group;
+    }
+
+    template<typename P, typename... Args>
+    P &addProjection(Args&&... args)
+    {
+        P *projection = new P(std::forward<Args>(args)...);
+        m_Projections.emplace_back(projection);
+        return *projection;
+    }
+
+    //! Size every input ring for the longest delay feeding it - call once all projections are added
+    void finalise()
+    {
+        for(auto &p : m_Projections) {
+            p->getPost().getInput(p->getReceptor()).requireDelay(p->getMaxDelay());
+        }
+        for(auto &g : m_Groups) {
+            g->allocate();
+        }
+    }
+
+    void step()
+    {
+        if(m_Workers) {
+            m_Workers->run(m_StepPartition);
+        }
+        else {
+            for(auto &g : m_Groups) {
+                CPU_ENGINE_PHASE(PHASE_NEURON_UPDATE);
+                g->update(m_Step);
+                CPU_ENGINE_COUNT(COUNTER_SPIKES, g->getSpikes().size());
+            }
+            for(auto &p : m_Projections) {
+                CPU_ENGINE_PHASE(PHASE_PROPAGATION);
+                p->propagate(m_Step);
+            }
+        }
+        CPU_ENGINE_COUNT(COUNTER_STEPS, 1);
+        m_Step++;
+    }
+
+    //! Run on one thread per partition - call once, after finalise(). Every
+    //! partitionable group is split into contiguous ranges of neurons and every
+    //! partitionable projection onto it by the range of its targets, so each
+    //! thread updates its own neurons and is the only one writing their inputs.
+    //! Each thread first-touches its own ranges and synapses so they live on its
+    //! NUMA node. Other groups and projections run on the calling thread, in
+    //! order, so results are bitwise identical to an unpartitioned network.
+    void partition(const std::vector<Partition> &partitions)
+    {
+        if(m_Workers) {
+            throw std::runtime_error("Network is already partitioned");
+        }
+        m_Workers.reset(new WorkerPool(partitions));
+        const unsigned int numPartitions = m_Workers->getNumThreads();
+
+        // Split groups at multiples of 16 neurons so partitions' input accumulators
+        // and state do not share cache lines
+        m_GroupRanges.assign(m_Groups.size(), {});
+        m_PartitionSpikes.assign(m_Groups.size(), {});
+        for(size_t g = 0; g < m_Groups.size(); g++) {
+            NeuronGroup &group = *m_Groups[g];
+            if(!group.isPartitionable()) {
+                continue;
+            }
+            for(unsigned int t = 0; t < numPartitions; t++) {
+                const unsigned int begin = (unsigned int)(((size_t)group.getSize() * t / numPartitions) & ~15ull);
+                const unsigned int end = (t == (numPartitions - 1)) ? group.getSize()
+                    : (unsigned int)(((size_t)group.getSize() * (t + 1) / numPartitions) & ~15ull);
+                m_GroupRanges[g].emplace_back(begin, end);
+            }
+            m_PartitionSpikes[g].resize(numPartitions);
+
+            for(const auto &array : group.getNeuronArrays()) {
+                firstTouch(array, group.getSize(), m_GroupRanges[g]);
+            }
+        }
+
+        m_ProjectionPartitioned.assign(m_Projections.size(), false);
+        for(size_t p = 0; p < m_Projections.size(); p++) {
+            Projection &projection = *m_Projections[p];
+            const auto post = getGroupIndex(projection.getPost());
+            if(projection.isPartitionable() && !m_GroupRanges[post].empty()) {
+                projection.partition(m_GroupRanges[post], *m_Workers);
+                m_ProjectionPartitioned[p] = true;
+            }
+        }
+
+        m_StepPartition = [this](unsigned int t){ stepPartition(t); };
+    }
+
+    //! Report where each partition runs and how much of its memory is on its own node
+    void printPartitions() const
+    {
+        if(!m_Workers) {
+            printf("Network is not partitioned\n");
+            return;
+        }
+
+        const auto &partitions = m_Workers->getPartitions();
+        for(unsigned int t = 0; t < partitions.size(); t++) {
+            // Count the pages of this partition's neuron ranges and synapses on each node
+            size_t numNeurons = 0;
+            std::map<int, size_t> neuronPages;
+            for(size_t g = 0; g < m_Groups.size(); g++) {
+                if(m_GroupRanges[g].empty()) {
+                    continue;
+                }
+                const auto &range = m_GroupRanges[g][t];
+                numNeurons += range.second - range.first;
+                for(const auto &array : m_Groups[g]->getNeuronArrays()) {
+                    const size_t rowBytes = array.bytesPerNeuron * m_Groups[g]->getSize();
+                    for(size_t r = 0; r < array.numRows; r++) {
+                        BenchUtils::countPageNodes((const char*)array.data + (r * rowBytes) + (range.first * array.bytesPerNeuron),
+                                                   (range.second - range.first) * array.bytesPerNeuron, neuronPages);
+                    }
+                }
+            }
+
+            size_t numSynapses = 0;
+            size_t synapseBytes = 0;
+            std::map<int, size_t> synapsePages;
+            for(size_t p = 0; p < m_Projections.size(); p++) {
+                if(!m_ProjectionPartitioned[p]) {
+                    continue;
+                }
+                const auto &partition = m_Projections[p]->getPartitions()[t];
+                numSynapses += partition.ind.size();
+                synapseBytes += (partition.rowStart.size() + partition.ind.size()) * sizeof(unsigned int) + partition.weight.size() * sizeof(float);
+                BenchUtils::countPageNodes(partition.rowStart.data(), partition.rowStart.size() * sizeof(unsigned int), synapsePages);
+                BenchUtils::countPageNodes(partition.ind.data(), partition.ind.size() * sizeof(unsigned int), synapsePages);
+                BenchUtils::countPageNodes(partition.weight.data(), partition.weight.size() * sizeof(float), synapsePages);
+            }
+
+            printf("Partition %u: node %u, CPUs %s, %zu neurons (%.0f%% of pages local), %zu synapses in %.1f MB (%.0f%% of pages local)\n",
+                   t, partitions[t].node, BenchUtils::formatCPUList(partitions[t].cpus).c_str(),
+                   numNeurons, getLocalPercentage(neuronPages, partitions[t].node),
+                   numSynapses, (double)synapseBytes / (1024.0 * 1024.0), getLocalPercentage(synapsePages, partitions[t].node));
+        }
+    }
+
+    //! Save the complete dynamic state so a later run can continue from this step
+    //! - connectivity and parameters are not saved and are rebuilt by the model
+    void saveCheckpoint(const std::string &filename) const
+    {
+        CheckpointWriter writer;
+        writer.beginSection("network");
+        writer.write(m_DT);
+        writer.write(m_Step);
+        for(const auto &g : m_Groups) {
+            g->saveState(writer);
+        }
+        for(const auto &p : m_Projections) {
+            p->saveState(writer);
+        }
+        writer.save(filename);
+    }
+
+    //! Restore a checkpoint saved by the same model - call after finalise()
+    void restoreCheckpoint(const std::string &filename)
+    {
+        CheckpointReader reader(filename);
+        reader.beginSection("network");
+        double dt;
+        reader.read(dt);
+        if(dt != m_DT) {
+            throw std::runtime_error("Checkpoint " + filename + " was saved with a different timestep");
+        }
+        reader.read(m_Step);
+        for(auto &g : m_Groups) {
+            g->restoreState(reader);
+        }
+        for(auto &p : m_Projections) {
+            p->restoreState(reader);
+        }
+        reader.finish();
+    }
+
+    //! Write-protect every projection's connectivity, e.g. before forking
+    //! trials which share it (see ensemble.h)
+    void setConnectivityReadOnly(bool readOnly)
+    {
+        for(auto &p : m_Projections) {
+            p->setConnectivityReadOnly(readOnly);
+        }
+        m_ConnectivityReadOnly = readOnly;
+    }
+
+    double getDT() const{ return m_DT; }
+    unsigned long long getStep() const{ return m_Step; }
+    double getTime() const{ return (double)m_Step * m_DT; }
+
+    size_t getNumSynapses() const
+    {
+        size_t numSynapses = 0;
+        for(const auto &p : m_Projections) {
+            numSynapses += p->getNumSynapses();
+        }
+        return numSynapses;
+    }
+
+    //! Synaptic events delivered by every projection since construction
+    uint64_t getNumSynapticEvents() const
+    {
+        uint64_t numSynapticEvents = 0;
+        for(const auto &p : m_Projections) {
+            numSynapticEvents += p->getNumSynapticEvents();
+        }
+        return numSynapticEvents;
+    }
+
+    size_t getNumNeurons() const
+    {
+        size_t numNeurons = 0;
+        for(const auto &g : m_Groups) {
+            numNeurons += g->getSize();
+        }
+        return numNeurons;
+    }
+
+    //! Bytes held by every group and projection, and by the partitions' spike lists
+    MemoryFootprint getMemoryFootprint() const
+    {
+        MemoryFootprint footprint;
+        for(const auto &g : m_Groups) {
+            g->addMemoryFootprint(footprint);
+        }
+        for(const auto &p : m_Projections) {
+            p->addMemoryFootprint(footprint);
+        }
+        footprint.add(MEMORY_NEURON_STATE, m_PartitionSpikes);
+        return footprint;
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    //! One partition's share of a step. Groups which are not partitioned, and
+    //! projections which are not, run on partition 0 between barriers
+    void stepPartition(unsigned int t)
+    {
+        for(size_t g = 0; g < m_Groups.size(); g++) {
+            CPU_ENGINE_PHASE(PHASE_NEURON_UPDATE);
+            if(m_GroupRanges[g].empty()) {
+                if(t == 0) {
+                    m_Groups[g]->update(m_Step);
+                    CPU_ENGINE_COUNT(COUNTER_SPIKES, m_Groups[g]->getSpikes().size());
+                }
+            }
+            else {
+                std::vector<unsigned int> &spikes = m_PartitionSpikes[g][t];
+                spikes.clear();
+                m_Groups[g]->updateNeurons(m_Step, m_GroupRanges[g][t].first, m_GroupRanges[g][t].second, spikes);
+                CPU_ENGINE_COUNT(COUNTER_SPIKES, spikes.size());
+            }
+        }
+        barrier();
+
+        if(t == 0) {
+            CPU_ENGINE_PHASE(PHASE_GATHER);
+            for(size_t g = 0; g < m_Groups.size(); g++) {
+                if(!m_GroupRanges[g].empty()) {
+                    m_Groups[g]->gatherSpikes(m_PartitionSpikes[g]);
+                }
+            }
+        }
+        barrier();
+
+        for(size_t p = 0; p < m_Projections.size(); p++) {
+            if(m_ProjectionPartitioned[p]) {
+                CPU_ENGINE_PHASE(PHASE_PROPAGATION);
+                m_Projections[p]->propagatePartition(m_Step, t);
+            }
+            else {
+                barrier();
+                if(t == 0) {
+                    CPU_ENGINE_PHASE(PHASE_PROPAGATION);
+                    m_Projections[p]->propagate(m_Step);
+                }
+                barrier();
+            }
+        }
+    }
+
+    //! Wait for the other partitions, timed as such when instrumented
+    void barrier()
+    {
+        CPU_ENGINE_PHASE(PHASE_WAIT);
+        m_Workers->barrier();
+    }
+
+    //! Re-place an array's pages so each partition's range is first touched by its
+    //! own thread: the contents are saved, the whole pages released back to the
+    //! kernel, and each thread copies its range back
+    void firstTouch(const NeuronArray &array, unsigned int numNeurons, const std::vector<std::pair<unsigned int, unsigned int>> &ranges)
+    {
+        const size_t rowBytes = array.bytesPerNeuron * numNeurons;
+        const size_t bytes = rowBytes * array.numRows;
+        char *data = (char*)array.data;
+        const std::vector<char> saved(data, data + bytes);
+
+        const uintptr_t pageSize = (uintptr_t)BenchUtils::getPageSize(data);
+        const uintptr_t begin = ((uintptr_t)data + pageSize - 1) & ~(pageSize - 1);
+        const uintptr_t end = ((uintptr_t)data + bytes) & ~(pageSize - 1);
+        if(end > begin) {
+            madvise((void*)begin, end - begin, MADV_DONTNEED);
+        }
+
+        m_Workers->run(
+            [&](unsigned int t)
+            {
+                const size_t offset = ranges[t].first * array.bytesPerNeuron;
+                const size_t length = (ranges[t].second - ranges[t].first) * array.bytesPerNeuron;
+                for(size_t r = 0; r < array.numRows; r++) {
+                    memcpy(data + (r * rowBytes) + offset, saved.data() + (r * rowBytes) + offset, length);
+                }
+            });
+    }
+
+    size_t getGroupIndex(const NeuronGroup &group) const
+    {
+        for(size_t g = 0; g < m_Groups.size(); g++) {
+            if(m_Groups[g].get() == &group) {
+                return g;
+            }
+        }
+        throw std::runtime_error("Group " + group.getName() + " is not in this network");
+    }
+
+    static double getLocalPercentage(const std::map<int, size_t> &pagesPerNode, unsigned int node)
+    {
+        size_t total = 0;
+        for(const auto &n : pagesPerNode) {
+            total += n.second;
+        }
+        const auto local = pagesPerNode.find((int)node);
+        return (total == 0) ? 100.0 : 100.0 * (double)((local == pagesPerNode.end()) ? 0 : local->second) / (double)total;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const double m_DT;
+    unsigned long long m_Step;
+    bool m_ConnectivityReadOnly;
+
+    std::vector<std::unique_ptr<NeuronGroup>> m_Groups;
+    std::vector<std::unique_ptr<Projection>> m_Projections;
+
+    //! Set by partition(): the worker threads, each partitioned group's neuron
+    //! ranges and per-partition spike lists, and which projections are split
+    std::unique_ptr<WorkerPool> m_Workers;
+    std::vector<std::vector<std::pair<unsigned int, unsigned int>>> m_GroupRanges;
+    std::vector<std::vector<std::vector<unsigned int>>> m_PartitionSpikes;
+    std::vector<bool> m_ProjectionPartitioned;
+    std::function<void(unsigned int)> m_StepPartition;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,442 @@
+#pragma once
+
+// Standard C++ includes
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cmath>
+#include <cstdint>
+
+// Shared includes
+#include "../huge_pages.h"
+
+// CPU engine includes
+#include "checkpoint.h"
+#include "delay_buffer.h"
+#include "memory_footprint.h"
+#include "rng.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::NeuronArray
+//----------------------------------------------------------------------------
+//! A per-neuron array of a group: numRows rows (e.g. the slots of an input
+//! ring) of bytesPerNeuron bytes for each neuron, so partitioning a group
+//! by neuron splits every row at the same points
+struct NeuronArray
+{
+    void *data;
+    size_t numRows;
+    size_t bytesPerNeuron;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::NeuronGroup
+//----------------------------------------------------------------------------
+//! Base class for a population of neurons with one input ring per receptor.
+//! Each neuron has inputWidth accumulators in every slot of the rings - one
+//! per instance for the batched groups in batch.h.
+class NeuronGroup
+{
+public:
+    NeuronGroup(const std::string &name, unsigned int size, unsigned int numReceptors, unsigned int inputWidth = 1)
+    : m_Name(name), m_Size(size), m_Inputs(numReceptors, DelayBuffer(size * inputWidth))
+    {}
+
+    virtual ~NeuronGroup()
+    {}
+
+    //------------------------------------------------------------------------
+    // Declared virtuals
+    //------------------------------------------------------------------------
+    //! Integrate one timestep, consuming the inputs which arrive at step
+    //! and replacing the spike list with the neurons which fired
+    virtual void update(unsigned long long step) = 0;
+
+    //! Whether neurons can be updated in independent ranges with updateNeurons,
+    //! so a partitioned network (see Network::partition) can split the group
+    virtual bool isPartitionable() const{ return false; }
+
+    //! Integrate neurons [begin, end) as update() would, appending their spikes
+    virtual void updateNeurons(unsigned long long, unsigned int, unsigned int, std::vector<unsigned int> &)
+    {
+        throw std::runtime_error("Group " + m_Name + " cannot be partitioned");
+    }
+
+    //! Every array indexed by neuron, which a partitioned network places on
+    //! the NUMA node of the thread updating each range. Overrides add their
+    //! state to the base class's input rings.
+    virtual std::vector<NeuronArray> getNeuronArrays()
+    {
+        std::vector<NeuronArray> arrays;
+        for(auto &input : m_Inputs) {
+            arrays.push_back(NeuronArray{input.getData(), input.getNumSlots(), sizeof(float) * input.getNumNeurons() / m_Size});
+        }
+        return arrays;
+    }
+
+    //! Write everything update() carries from one step to the next. Overrides
+    //! call these first so the base class's input rings lead the section.
+    virtual void saveState(CheckpointWriter &writer) const
+    {
+        writer.beginSection("group " + m_Name);
+        for(const auto &input : m_Inputs) {
+            input.saveState(writer);
+        }
+    }
+
+    virtual void restoreState(CheckpointReader &reader)
+    {
+        reader.beginSection("group " + m_Name);
+        for(auto &input : m_Inputs) {
+            input.restoreState(reader);
+        }
+    }
+
+    //! Count the group's arrays. Overrides call this first for the input rings and spike list.
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        for(const auto &input : m_Inputs) {
+            input.addMemoryFootprint(footprint);
+        }
+        footprint.add(MEMORY_NEURON_STATE, m_Spikes);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Allocate input rings once every projection has declared its delays
+    void allocate()
+    {
+        for(auto &input : m_Inputs) {
+            input.allocate();
+        }
+    }
+
+    const std::string &getName() const{ return m_Name; }
+    unsigned int getSize() const{ return m_Size; }
+    unsigned int getNumReceptors() const{ return (unsigned int)m_Inputs.size(); }
+
+    DelayBuffer &getInput(unsigned int receptor){ return m_Inputs.at(receptor); }
+
+    //! Indices of the neurons which spiked in the most recent update
+    const std::vector<unsigned int> &getSpikes() const{ return m_Spikes; }
+
+    //! Replace the spike list with the spikes of each partition's updateNeurons, in partition order
+    void gatherSpikes(const std::vector<std::vector<unsigned int>> &partitionSpikes)
+    {
+        m_Spikes.clear();
+        for(const auto &spikes : partitionSpikes) {
+            m_Spikes.insert(m_Spikes.end(), spikes.begin(), spikes.end());
+        }
+    }
+
+protected:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Name;
+    const unsigned int m_Size;
+    std::vector<DelayBuffer> m_Inputs;
+    std::vector<unsigned int> m_Spikes;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::PoissonGroup
+//----------------------------------------------------------------------------
+//! Independent Poisson spike sources. Rather than drawing a number per neuron
+//! per step, the gap to the next spiking neuron is sampled geometrically.
+class PoissonGroup : public NeuronGroup
+{
+public:
+    PoissonGroup(const std::string &name, unsigned int size, double rateHz, double dtMs, uint64_t seed)
+    : NeuronGroup(name, size, 0), m_LogOneMinusP(std::log(1.0 - (rateHz * dtMs / 1000.0))), m_Rng(seed)
+    {}
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void update(unsigned long long) override
+    {
+        m_Spikes.clear();
+        if(m_LogOneMinusP == 0.0) {
+            return;
+        }
+        for(uint64_t i = m_Rng.geometric(m_LogOneMinusP); i < m_Size; i += 1 + m_Rng.geometric(m_LogOneMinusP)) {
+            m_Spikes.push_back((unsigned int)i);
+        }
+    }
+
+    //! The generator's stream position is all a Poisson group remembers
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        NeuronGroup::saveState(writer);
+        writer.write(m_Rng);
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        NeuronGroup::restoreState(reader);
+        reader.read(m_Rng);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Restart the spike trains from a new seed, e.g. for another trial of the same network
+    void setSeed(uint64_t seed){ m_Rng = Rng(seed); }
+
+    //! Branch the spike trains onto another stream from where they are now, e.g.
+    //! for another trial continuing from a restored checkpoint
+    void setStream(uint64_t stream){ m_Rng.setStream(stream); }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const double m_LogOneMinusP;
+    Rng m_Rng;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::LIFParams
+//----------------------------------------------------------------------------
+//! Parameters shared by the integrate-and-fire groups (voltages in mV, times in ms)
+struct LIFParams
+{
+    double tauM;
+    double vRest;
+    double vReset;
+    double vThresh;
+    double iOffset;
+    double tauRefrac;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::LIFDeltaGroup
+//----------------------------------------------------------------------------
+//! Leaky integrate-and-fire neurons with delta current synapses (Brunel):
+//! incoming weights are added straight to the membrane voltage in mV
+class LIFDeltaGroup : public NeuronGroup
+{
+public:
+    LIFDeltaGroup(const std::string &name, unsigned int size, const LIFParams &params, double dtMs)
+    : NeuronGroup(name, size, 1), m_V(size, (float)params.vRest), m_RefracRemain(size, 0),
+      m_Alpha((float)(dtMs / params.tauM)), m_VRest((float)params.vRest), m_VReset((float)params.vReset),
+      m_VThresh((float)params.vThresh), m_IOffset((float)params.iOffset),
+      m_RefracSteps((unsigned int)std::round(params.tauRefrac / dtMs))
+    {}
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void update(unsigned long long step) override
+    {
+        m_Spikes.clear();
+        updateNeurons(step, 0, m_Size, m_Spikes);
+    }
+
+    virtual bool isPartitionable() const override{ return true; }
+
+    virtual void updateNeurons(unsigned long long step, unsigned int begin, unsigned int end,
+                               std::vector<unsigned int> &spikes) override
+    {
+        float *input = m_Inputs[0].getSlot(step);
+        for(unsigned int i = begin; i < end; i++) {
+            // Inputs arriving during the refractory period are discarded
+            if(m_RefracRemain[i] > 0) {
+                m_RefracRemain[i]--;
+            }
+            else {
+                m_V[i] += m_Alpha * ((m_VRest - m_V[i]) + m_IOffset) + input[i];
+                if(m_V[i] >= m_VThresh) {
+                    m_V[i] = m_VReset;
+                    m_RefracRemain[i] = m_RefracSteps;
+                    spikes.push_back(i);
+                }
+            }
+            input[i] = 0.0f;
+        }
+    }
+
+    virtual std::vector<NeuronArray> getNeuronArrays() override
+    {
+        std::vector<NeuronArray> arrays = NeuronGroup::getNeuronArrays();
+        arrays.push_back(NeuronArray{m_V.data(), 1, sizeof(float)});
+        arrays.push_back(NeuronArray{m_RefracRemain.data(), 1, sizeof(unsigned int)});
+        return arrays;
+    }
+
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        NeuronGroup::saveState(writer);
+        writer.write(m_V);
+        writer.write(m_RefracRemain);
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        NeuronGroup::restoreState(reader);
+        reader.read(m_V);
+        reader.read(m_RefracRemain);
+    }
+
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        NeuronGroup::addMemoryFootprint(footprint);
+        footprint.add(MEMORY_NEURON_STATE, m_V);
+        footprint.add(MEMORY_NEURON_STATE, m_RefracRemain);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    BenchUtils::HugePageVector<float> &getV(){ return m_V; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    BenchUtils::HugePageVector<float> m_V;
+    BenchUtils::HugePageVector<unsigned int> m_RefracRemain;
+
+    const float m_Alpha;
+    const float m_VRest;
+    const float m_VReset;
+    const float m_VThresh;
+    const float m_IOffset;
+    const unsigned int m_RefracSteps;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::LIFCondGroup
+//----------------------------------------------------------------------------
+//! Leaky integrate-and-fire neurons with exponentially decaying excitatory and
+//! inhibitory conductances (Vogels-Abbott). Conductances are in units of the
+//! leak conductance, so weights from the .wmat files can be used directly.
+class LIFCondGroup : public NeuronGroup
+{
+public:
+    enum Receptor
+    {
+        RECEPTOR_EXC,
+        RECEPTOR_INH,
+    };
+
+    LIFCondGroup(const std::string &name, unsigned int size, const LIFParams &params,
+                 double tauExc, double eExc, double tauInh, double eInh, double dtMs)
+    : NeuronGroup(name, size, 2), m_V(size, (float)params.vRest), m_GExc(size, 0.0f), m_GInh(size, 0.0f),
+      m_RefracRemain(size, 0), m_Alpha((float)(dtMs / params.tauM)), m_VRest((float)params.vRest),
+      m_VReset((float)params.vReset), m_VThresh((float)params.vThresh), m_IOffset((float)params.iOffset),
+      m_RefracSteps((unsigned int)std::round(params.tauRefrac / dtMs)),
+      m_EExc((float)eExc), m_EInh((float)eInh),
+      m_DecayExc((float)std::exp(-dtMs / tauExc)), m_DecayInh((float)std::exp(-dtMs / tauInh))
+    {}
+
+    //------------------------------------------------------------------------
+    // NeuronGroup virtuals
+    //------------------------------------------------------------------------
+    virtual void update(unsigned long long step) override
+    {
+        m_Spikes.clear();
+        updateNeurons(step, 0, m_Size, m_Spikes);
+    }
+
+    virtual bool isPartitionable() const override{ return true; }
+
+    virtual void updateNeurons(unsigned long long step, unsigned int begin, unsigned int end,
+                               std::vector<unsigned int> &spikes) override
+    {
+        float *inputExc = m_Inputs[RECEPTOR_EXC].getSlot(step);
+        float *inputInh = m_Inputs[RECEPTOR_INH].getSlot(step);
+        for(unsigned int i = begin; i < end; i++) {
+            m_GExc[i] += inputExc[i];
+            m_GInh[i] += inputInh[i];
+            inputExc[i] = 0.0f;
+            inputInh[i] = 0.0f;
+
+            if(m_RefracRemain[i] > 0) {
+                m_RefracRemain[i]--;
+            }
+            else {
+                const float iSyn = m_GExc[i] * (m_EExc - m_V[i]) + m_GInh[i] * (m_EInh - m_V[i]);
+                m_V[i] += m_Alpha * ((m_VRest - m_V[i]) + iSyn + m_IOffset);
+                if(m_V[i] >= m_VThresh) {
+                    m_V[i] = m_VReset;
+                    m_RefracRemain[i] = m_RefracSteps;
+                    spikes.push_back(i);
+                }
+            }
+
+            m_GExc[i] *= m_DecayExc;
+            m_GInh[i] *= m_DecayInh;
+        }
+    }
+
+    virtual std::vector<NeuronArray> getNeuronArrays() override
+    {
+        std::vector<NeuronArray> arrays = NeuronGroup::getNeuronArrays();
+        arrays.push_back(NeuronArray{m_V.data(), 1, sizeof(float)});
+        arrays.push_back(NeuronArray{m_GExc.data(), 1, sizeof(float)});
+        arrays.push_back(NeuronArray{m_GInh.data(), 1, sizeof(float)});
+        arrays.push_back(NeuronArray{m_RefracRemain.data(), 1, sizeof(unsigned int)});
+        return arrays;
+    }
+
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        NeuronGroup::saveState(writer);
+        writer.write(m_V);
+        writer.write(m_GExc);
+        writer.write(m_GInh);
+        writer.write(m_RefracRemain);
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        NeuronGroup::restoreState(reader);
+        reader.read(m_V);
+        reader.read(m_GExc);
+        reader.read(m_GInh);
+        reader.read(m_RefracRemain);
+    }
+
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        NeuronGroup::addMemoryFootprint(footprint);
+        footprint.add(MEMORY_NEURON_STATE, m_V);
+        footprint.add(MEMORY_NEURON_STATE, m_GExc);
+        footprint.add(MEMORY_NEURON_STATE, m_GInh);
+        footprint.add(MEMORY_NEURON_STATE, m_RefracRemain);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    BenchUtils::HugePageVector<float> &getV(){ return m_V; }
+    BenchUtils::HugePageVector<float> &getGExc(){ return m_GExc; }
+    BenchUtils::HugePageVector<float> &getGInh(){ return m_GInh; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    BenchUtils::HugePageVector<float> m_V;
+    BenchUtils::HugePageVector<float> m_GExc;
+    BenchUtils::HugePageVector<float> m_GInh;
+    BenchUtils::HugePageVector<unsigned int> m_RefracRemain;
+
+    const float m_Alpha;
+    const float m_VRest;
+    const float m_VReset;
+    const float m_VThresh;
+    const float m_IOffset;
+    const unsigned int m_RefracSteps;
+    const float m_EExc;
+    const float m_EInh;
+    const float m_DecayExc;
+    const float m_DecayInh;
+};
+}   // namespace CPUEngine
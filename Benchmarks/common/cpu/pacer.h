@@ -0,0 +1,157 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// Standard C includes
+#include <cmath>
+#include <cstdio>
+
+//----------------------------------------------------------------------------
+// CPUEngine::Pacer
+//----------------------------------------------------------------------------
+//! Holds a simulation loop to a wall-clock schedule of stepsPerMs timesteps
+//! per real millisecond, as closed-loop use needs. Step n is due n / stepsPerMs ms
+//! after start(), and at the end of every batch of steps the loop sleeps until
+//! the batch's deadline - spinning for the last stretch, as sleeps overshoot.
+//! The schedule never slips: a late batch is a deadline miss, and the steps
+//! after it run back to back until they catch up. With shedding enabled,
+//! shouldShed() tells the loop to skip optional work, such as recording, on
+//! steps which are behind schedule.
+namespace CPUEngine {
+class Pacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Pacer(double stepsPerMs, unsigned int batchSteps = 1, bool shed = false,
+          std::chrono::nanoseconds spin = std::chrono::microseconds(50))
+    : m_StepsPerMs(stepsPerMs), m_StepNs(1.0E6 / stepsPerMs), m_BatchSteps(batchSteps), m_Shed(shed), m_Spin(spin)
+    {
+        if(stepsPerMs <= 0.0 || batchSteps == 0) {
+            throw std::runtime_error("Pacing needs a positive step rate and batch size");
+        }
+        start();
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Start the schedule now and clear the statistics
+    Clock::time_point start()
+    {
+        m_Start = Clock::now();
+        m_NumSteps = 0;
+        m_NumDeadlines = 0;
+        m_NumMisses = 0;
+        m_NumShed = 0;
+        m_Lag = Clock::duration::zero();
+        m_MaxLag = Clock::duration::zero();
+        m_TotalMissLag = Clock::duration::zero();
+        return m_Start;
+    }
+
+    //! Call when a step has finished at now. At the end of a batch, waits for
+    //! its deadline if it is early. Returns when the next step may start.
+    Clock::time_point endStep(Clock::time_point now)
+    {
+        m_NumSteps++;
+        const Clock::time_point deadline = m_Start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::nano>(m_StepNs * (double)m_NumSteps));
+        m_Lag = now - deadline;
+        if((m_NumSteps % m_BatchSteps) != 0) {
+            return now;
+        }
+
+        m_NumDeadlines++;
+        if(m_Lag > Clock::duration::zero()) {
+            m_NumMisses++;
+            m_TotalMissLag += m_Lag;
+            m_MaxLag = std::max(m_MaxLag, m_Lag);
+            return now;
+        }
+
+        if(deadline - now > m_Spin) {
+            std::this_thread::sleep_until(deadline - m_Spin);
+        }
+        while((now = Clock::now()) < deadline) {
+        }
+        return now;
+    }
+
+    //! Whether optional work should be skipped because the previous step
+    //! finished late - always false unless shedding is enabled
+    bool shouldShed()
+    {
+        if(m_Shed && m_Lag > Clock::duration::zero()) {
+            m_NumShed++;
+            return true;
+        }
+        return false;
+    }
+
+    unsigned long long getNumDeadlines() const{ return m_NumDeadlines; }
+    unsigned long long getNumMisses() const{ return m_NumMisses; }
+    unsigned long long getNumShed() const{ return m_NumShed; }
+
+    double getMissPercentage() const
+    {
+        return (m_NumDeadlines > 0) ? 100.0 * (double)m_NumMisses / (double)m_NumDeadlines : 0.0;
+    }
+
+    //! How late the most recent step finished - negative if it was early
+    double getLagMs() const{ return toMs(m_Lag); }
+    double getMaxLagMs() const{ return toMs(m_MaxLag); }
+
+    //! Write the percentage of deadlines missed and the largest lag, e.g. as a sweep result
+    void write(const std::string &filename) const
+    {
+        std::ofstream file(filename);
+        file << std::setprecision(10) << getMissPercentage() << " " << getMaxLagMs() << std::endl;
+    }
+
+    void print() const
+    {
+        printf("Paced at %g steps per ms in batches of %u: %llu of %llu deadlines missed (%.2f%%), by %.3f ms on average and %.3f ms at most\n",
+               m_StepsPerMs, m_BatchSteps, m_NumMisses, m_NumDeadlines, getMissPercentage(),
+               (m_NumMisses > 0) ? toMs(m_TotalMissLag) / (double)m_NumMisses : 0.0, toMs(m_MaxLag));
+        printf("Finished %.3f ms %s schedule", std::abs(getLagMs()), (m_Lag > Clock::duration::zero()) ? "behind" : "ahead of");
+        if(m_Shed) {
+            printf(", optional work shed on %llu of %llu steps", m_NumShed, m_NumSteps);
+        }
+        printf("\n");
+    }
+
+private:
+    static double toMs(Clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const double m_StepsPerMs;
+    const double m_StepNs;
+    const unsigned int m_BatchSteps;
+    const bool m_Shed;
+    const Clock::duration m_Spin;
+
+    Clock::time_point m_Start;
+    unsigned long long m_NumSteps;
+    unsigned long long m_NumDeadlines;
+    unsigned long long m_NumMisses;
+    unsigned long long m_NumShed;
+
+    //! Lateness of the most recent step, the largest at a deadline and the total of the misses
+    Clock::duration m_Lag;
+    Clock::duration m_MaxLag;
+    Clock::duration m_TotalMissLag;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,186 @@
+#pragma once
+
+// Standard C++ includes
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// POSIX includes
+#include <sched.h>
+
+// Shared includes
+#include "../cpu_topology.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::Partition
+//----------------------------------------------------------------------------
+//! Where one partition of a network runs: its worker thread is pinned to
+//! cpus, and the arrays it owns are first-touched there so live on node
+struct Partition
+{
+    unsigned int node;
+    std::vector<unsigned int> cpus;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::makePartitions
+//----------------------------------------------------------------------------
+//! One partition per thread, each on its own physical core (and all of its
+//! SMT siblings). Threads are spread over the NUMA nodes in proportion to
+//! their cores, with consecutive partitions on the same node, so e.g. a
+//! 2-socket host runs half of every group on each socket's memory. If there
+//! are more threads than physical cores they share cores.
+inline std::vector<Partition> makePartitions(unsigned int numThreads)
+{
+    const std::vector<BenchUtils::PhysicalCore> cores = BenchUtils::getPhysicalCores();
+    if(numThreads == 0 || cores.empty()) {
+        throw std::runtime_error("Cannot partition a network over " + std::to_string(numThreads) + " threads");
+    }
+
+    // Cores are grouped by node, so taking evenly spaced ones spreads threads over nodes
+    std::vector<Partition> partitions;
+    for(unsigned int t = 0; t < numThreads; t++) {
+        const auto &core = cores[((size_t)t * cores.size() / numThreads) % cores.size()];
+        partitions.push_back(Partition{core.node, core.cpus});
+    }
+    return partitions;
+}
+
+//----------------------------------------------------------------------------
+// CPUEngine::SpinBarrier
+//----------------------------------------------------------------------------
+//! Barrier for a fixed number of threads. A step has several phases of a few
+//! microseconds each, so waiting threads spin rather than sleep, only
+//! yielding once they have spun for a while in case cores are oversubscribed
+class SpinBarrier
+{
+public:
+    SpinBarrier(unsigned int numThreads)
+    : m_NumThreads(numThreads), m_Count(0), m_Generation(0)
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void wait()
+    {
+        const unsigned int generation = m_Generation.load(std::memory_order_acquire);
+        if(m_Count.fetch_add(1, std::memory_order_acq_rel) + 1 == m_NumThreads) {
+            m_Count.store(0, std::memory_order_relaxed);
+            m_Generation.fetch_add(1, std::memory_order_release);
+        }
+        else {
+            for(unsigned int spins = 0; m_Generation.load(std::memory_order_acquire) == generation; spins++) {
+                if(spins >= s_SpinsBeforeYield) {
+                    sched_yield();
+                }
+            }
+        }
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const unsigned int m_NumThreads;
+    std::atomic<unsigned int> m_Count;
+    std::atomic<unsigned int> m_Generation;
+
+    static constexpr unsigned int s_SpinsBeforeYield = 20000;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::WorkerPool
+//----------------------------------------------------------------------------
+//! One thread per partition, each pinned to its partition's CPUs. The calling
+//! thread acts as partition 0, so it is pinned too until the pool is destroyed.
+class WorkerPool
+{
+public:
+    WorkerPool(const std::vector<Partition> &partitions)
+    : m_Partitions(partitions), m_Barrier((unsigned int)partitions.size()), m_Phase(nullptr), m_Stop(false)
+    {
+        if(sched_getaffinity(0, sizeof(cpu_set_t), &m_CallerAffinity) != 0) {
+            throw std::runtime_error("Cannot read CPU affinity");
+        }
+        for(unsigned int t = 0; t < m_Partitions.size(); t++) {
+            if(!pin(t)) {
+                sched_setaffinity(0, sizeof(cpu_set_t), &m_CallerAffinity);
+                throw std::runtime_error("Cannot pin partition " + std::to_string(t) + " to CPUs " + BenchUtils::formatCPUList(m_Partitions[t].cpus));
+            }
+        }
+        pin(0);
+        for(unsigned int t = 1; t < m_Partitions.size(); t++) {
+            m_Threads.emplace_back(&WorkerPool::workerThread, this, t);
+        }
+    }
+
+    ~WorkerPool()
+    {
+        m_Stop = true;
+        m_Barrier.wait();
+        for(auto &t : m_Threads) {
+            t.join();
+        }
+        sched_setaffinity(0, sizeof(cpu_set_t), &m_CallerAffinity);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Run phase(t) on every partition's thread and wait for them all to return.
+    //! Phases can synchronise internally with barrier()
+    void run(const std::function<void(unsigned int)> &phase)
+    {
+        m_Phase = &phase;
+        m_Barrier.wait();
+        phase(0);
+        m_Barrier.wait();
+    }
+
+    //! Wait until every thread of the current phase reaches this point
+    void barrier(){ m_Barrier.wait(); }
+
+    unsigned int getNumThreads() const{ return (unsigned int)m_Partitions.size(); }
+    const std::vector<Partition> &getPartitions() const{ return m_Partitions; }
+
+private:
+    bool pin(unsigned int t) const
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for(unsigned int c : m_Partitions[t].cpus) {
+            CPU_SET(c, &cpus);
+        }
+        return (sched_setaffinity(0, sizeof(cpu_set_t), &cpus) == 0);
+    }
+
+    void workerThread(unsigned int t)
+    {
+        // Every partition's CPUs were checked by the constructor
+        pin(t);
+        while(true) {
+            m_Barrier.wait();
+            if(m_Stop) {
+                break;
+            }
+            (*m_Phase)(t);
+            m_Barrier.wait();
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::vector<Partition> m_Partitions;
+    SpinBarrier m_Barrier;
+    const std::function<void(unsigned int)> *m_Phase;
+    std::atomic<bool> m_Stop;
+    cpu_set_t m_CallerAffinity;
+    std::vector<std::thread> m_Threads;
+};
+}   // namespace CPUEngine
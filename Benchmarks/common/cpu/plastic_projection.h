@@ -0,0 +1,283 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+// CPU engine includes
+#include "projection.h"
+#include "stdp.h"
+#include "stdp_kernels.h"
+#include "stdp_pairing.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::PlasticProjectionBase
+//----------------------------------------------------------------------------
+//! What frontends need from a plastic projection whatever its pairing scheme
+class PlasticProjectionBase : public Projection
+{
+public:
+    PlasticProjectionBase(NeuronGroup &pre, NeuronGroup &post, unsigned int receptor,
+                          BenchUtils::CSRConnectivity &&csr, unsigned int delay, const STDPParams &params)
+    : Projection(pre, post, receptor, std::move(csr), delay), m_Params(params),
+      m_NumDepressions(0), m_NumPotentiations(0), m_PlasticityTime(0.0)
+    {}
+
+    //------------------------------------------------------------------------
+    // Declared virtuals
+    //------------------------------------------------------------------------
+    virtual const char *getPairingName() const = 0;
+
+    //! Traces of the presynaptic and postsynaptic neurons, e.g. to monitor
+    virtual const NeuronTraces &getPreTrace() const = 0;
+    virtual const NeuronTraces &getPostTrace() const = 0;
+
+    //------------------------------------------------------------------------
+    // Projection virtuals
+    //------------------------------------------------------------------------
+    //! Potentiation reads and writes synapses of every postsynaptic neuron
+    virtual bool isPartitionable() const override{ return false; }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    const STDPParams &getParams() const{ return m_Params; }
+
+    //! Synaptic events processed by each half of the rule so far
+    unsigned long long getNumDepressions() const{ return m_NumDepressions; }
+    unsigned long long getNumPotentiations() const{ return m_NumPotentiations; }
+
+    //! Wall-clock seconds spent in plasticity, including delivery of plastic spikes
+    double getPlasticityTime() const{ return m_PlasticityTime; }
+
+protected:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const STDPParams m_Params;
+
+    unsigned long long m_NumDepressions;
+    unsigned long long m_NumPotentiations;
+    double m_PlasticityTime;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::PlasticProjection
+//----------------------------------------------------------------------------
+//! Projection with the weight-dependent STDP rule from Brunel/genn/stdp_multiplicative.h:
+//!   presynaptic arrival:  g -= lambda * alpha * g * postTrace, clamped to Wmin
+//!   postsynaptic spike:   g += lambda * (Wmax - g) * preTrace, clamped to Wmax
+//! The rule's traces only depend on spike times so they are kept per neuron
+//! rather than per synapse; the Pairing policy (see stdp_pairing.h) decides how
+//! spikes update them. As in GeNN, the presynaptic side acts when a spike
+//! arrives, so presynaptic spikes are queued for the (uniform) delay and then
+//! delivered with the weight at arrival time. Potentiation walks a column
+//! index built at construction - for each postsynaptic neuron, the slots of
+//! its incoming synapses in the presynaptic-major weight array - so its cost
+//! scales with the in-degree of the neurons which spike.
+template<typename Pairing>
+class PlasticProjection : public PlasticProjectionBase
+{
+public:
+    PlasticProjection(NeuronGroup &pre, NeuronGroup &post, unsigned int receptor,
+                      BenchUtils::CSRConnectivity &&csr, unsigned int delay,
+                      const STDPParams &params, double dtMs)
+    : PlasticProjectionBase(pre, post, receptor, std::move(csr), delay, params),
+      m_PreTrace(pre.getSize(), params.tauPlus, dtMs), m_PostTrace(post.getSize(), params.tauMinus, dtMs),
+      m_PreSpikeQueue(delay), m_PreTraceNow(pre.getSize()), m_PostTraceAtArrival(post.getSize())
+    {
+        buildColumnIndex();
+    }
+
+    //------------------------------------------------------------------------
+    // Projection virtuals
+    //------------------------------------------------------------------------
+    //! Potentiate for this step's postsynaptic spikes, then deliver and depress
+    //! for the presynaptic spikes which arrive next step
+    virtual void propagate(unsigned long long step) override
+    {
+        CPU_ENGINE_PHASE(PHASE_PLASTICITY);
+        const auto startTime = std::chrono::steady_clock::now();
+
+        learnPost(step);
+
+        // Queue this step's presynaptic spikes. The slot after it holds the
+        // spikes emitted (delay - 1) steps ago, which arrive at step + 1
+        const unsigned int delay = m_Delays[0];
+        m_PreSpikeQueue[step % delay] = m_Pre.getSpikes();
+        const std::vector<unsigned int> &arriving = m_PreSpikeQueue[(step + 1) % delay];
+        if(!arriving.empty()) {
+            learnPreAndDeliver(step + 1, arriving);
+        }
+
+        m_PlasticityTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    //! Weights are learned so only the connectivity and column index are protected
+    virtual void setConnectivityReadOnly(bool readOnly) override
+    {
+        protectPages(m_RowStart, readOnly);
+        protectPages(m_Ind, readOnly);
+        protectPages(m_ColStart, readOnly);
+        protectPages(m_ColSynapse, readOnly);
+        protectPages(m_ColPre, readOnly);
+    }
+
+    //! The column index, traces and queued spikes are all there for learning
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const override
+    {
+        Projection::addMemoryFootprint(footprint);
+        m_PreTrace.addMemoryFootprint(footprint);
+        m_PostTrace.addMemoryFootprint(footprint);
+        footprint.add(MEMORY_PLASTICITY, m_PreSpikeQueue);
+        footprint.add(MEMORY_PLASTICITY, m_PreTraceNow);
+        footprint.add(MEMORY_PLASTICITY, m_PostTraceAtArrival);
+        footprint.add(MEMORY_PLASTICITY, m_ColStart);
+        footprint.add(MEMORY_PLASTICITY, m_ColSynapse);
+        footprint.add(MEMORY_PLASTICITY, m_ColPre);
+    }
+
+    //! Weights, both sides' traces and the presynaptic spikes still in flight
+    virtual void saveState(CheckpointWriter &writer) const override
+    {
+        Projection::saveState(writer);
+        writer.write(m_Weight);
+        m_PreTrace.saveState(writer);
+        m_PostTrace.saveState(writer);
+        for(const auto &spikes : m_PreSpikeQueue) {
+            writer.write(spikes);
+        }
+    }
+
+    virtual void restoreState(CheckpointReader &reader) override
+    {
+        Projection::restoreState(reader);
+        reader.read(m_Weight);
+        m_PreTrace.restoreState(reader);
+        m_PostTrace.restoreState(reader);
+        for(auto &spikes : m_PreSpikeQueue) {
+            reader.readResize(spikes);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // PlasticProjectionBase virtuals
+    //------------------------------------------------------------------------
+    virtual const char *getPairingName() const override{ return Pairing::getName(); }
+    virtual const NeuronTraces &getPreTrace() const override{ return m_PreTrace; }
+    virtual const NeuronTraces &getPostTrace() const override{ return m_PostTrace; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void learnPost(unsigned long long step)
+    {
+        const auto &postSpikes = m_Post.getSpikes();
+        if(postSpikes.empty()) {
+            return;
+        }
+
+        // Decay every presynaptic trace to this step once, rather than per synapse
+        const unsigned int numPre = m_Pre.getSize();
+        for(unsigned int i = 0; i < numPre; i++) {
+            m_PreTraceNow[i] = m_PreTrace.get(i, step);
+        }
+
+        const float lambda = (float)m_Params.lambda;
+        const float wMax = (float)m_Params.wMax;
+        for(unsigned int j : postSpikes) {
+            const unsigned long long lastPostStep = m_PostTrace.getLastStep(j);
+            Pairing::addSpike(m_PostTrace, j, step, (float)m_Params.aMinus);
+
+            const unsigned int colStart = m_ColStart[j];
+            const unsigned int colLength = m_ColStart[j + 1] - colStart;
+            if(Pairing::gatePotentiation) {
+                STDPKernels::potentiateColumnGatedScalar(m_Weight.data(), &m_ColSynapse[colStart], &m_ColPre[colStart], colLength,
+                                                         m_PreTraceNow.data(), m_PreTrace.getLastSteps(), lastPostStep,
+                                                         lambda, wMax);
+            }
+            else {
+                STDPKernels::potentiateColumn(m_Weight.data(), &m_ColSynapse[colStart], &m_ColPre[colStart], colLength,
+                                              m_PreTraceNow.data(), lambda, wMax);
+            }
+            m_NumPotentiations += colLength;
+        }
+    }
+
+    //! Counting sort of the synapses by postsynaptic neuron. Rows are visited in
+    //! order so each column lists its synapses by increasing presynaptic index.
+    void buildColumnIndex()
+    {
+        const unsigned int numPre = m_Pre.getSize();
+        const unsigned int numPost = m_Post.getSize();
+        m_ColStart.assign(numPost + 1, 0);
+        for(unsigned int j : m_Ind) {
+            m_ColStart[j + 1]++;
+        }
+        for(unsigned int j = 0; j < numPost; j++) {
+            m_ColStart[j + 1] += m_ColStart[j];
+        }
+
+        m_ColSynapse.resize(m_Ind.size());
+        m_ColPre.resize(m_Ind.size());
+        std::vector<unsigned int> cursor(m_ColStart.begin(), m_ColStart.end() - 1);
+        for(unsigned int i = 0; i < numPre; i++) {
+            for(unsigned int s = m_RowStart[i]; s < m_RowStart[i + 1]; s++) {
+                const unsigned int k = cursor[m_Ind[s]]++;
+                m_ColSynapse[k] = s;
+                m_ColPre[k] = i;
+            }
+        }
+    }
+
+    void learnPreAndDeliver(unsigned long long arrivalStep, const std::vector<unsigned int> &arriving)
+    {
+        // Decay every postsynaptic trace to the arrival step once, rather than per synapse
+        const unsigned int numPost = m_Post.getSize();
+        for(unsigned int j = 0; j < numPost; j++) {
+            m_PostTraceAtArrival[j] = m_PostTrace.get(j, arrivalStep);
+        }
+
+        const float depression = (float)(m_Params.lambda * m_Params.alpha);
+        const float wMin = (float)m_Params.wMin;
+        float *out = m_Post.getInput(m_Receptor).getSlot(arrivalStep);
+        for(unsigned int i : arriving) {
+            Pairing::addSpike(m_PreTrace, i, arrivalStep, (float)m_Params.aPlus);
+
+            // Deliver the weights from before this arrival's depression
+            const unsigned int rowStart = m_RowStart[i];
+            const unsigned int rowLength = m_RowStart[i + 1] - rowStart;
+            for(unsigned int s = rowStart; s < rowStart + rowLength; s++) {
+                out[m_Ind[s]] += m_Weight[s];
+            }
+            m_NumSynapticEvents += rowLength;
+            CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, rowLength);
+            STDPKernels::depressRow(&m_Weight[rowStart], &m_Ind[rowStart], rowLength,
+                                    m_PostTraceAtArrival.data(), depression, wMin);
+            m_NumDepressions += rowLength;
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    NeuronTraces m_PreTrace;
+    NeuronTraces m_PostTrace;
+
+    //! Presynaptic spikes of the last delay steps, indexed by step % delay
+    std::vector<std::vector<unsigned int>> m_PreSpikeQueue;
+
+    std::vector<float> m_PreTraceNow;
+    std::vector<float> m_PostTraceAtArrival;
+
+    //! Column index - synapses onto postsynaptic neuron j are
+    //! m_ColSynapse[m_ColStart[j]..m_ColStart[j + 1]), from m_ColPre of the same range
+    BenchUtils::HugePageVector<unsigned int> m_ColStart;
+    BenchUtils::HugePageVector<unsigned int> m_ColSynapse;
+    BenchUtils::HugePageVector<unsigned int> m_ColPre;
+};
+}   // namespace CPUEngine
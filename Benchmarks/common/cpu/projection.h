@@ -0,0 +1,365 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+
+// POSIX includes
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Shared includes
+#include "../huge_pages.h"
+#include "../weight_file.h"
+#include "../wmat_loader.h"
+
+// CPU engine includes
+#include "checkpoint.h"
+#include "instrumentation.h"
+#include "memory_footprint.h"
+#include "neuron_groups.h"
+#include "partition.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::ProjectionPartition
+//----------------------------------------------------------------------------
+//! The synapses of a projection onto one partition's postsynaptic neurons,
+//! with the same sub-row structure as the whole projection
+struct ProjectionPartition
+{
+    BenchUtils::HugePageVector<unsigned int> rowStart;
+    BenchUtils::HugePageVector<unsigned int> ind;
+    BenchUtils::HugePageVector<float> weight;
+
+    //! Synaptic events delivered by this partition's thread
+    uint64_t numSynapticEvents;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::Projection
+//----------------------------------------------------------------------------
+//! Static synapses between two groups, stored presynaptic-major. Delays are not
+//! stored per synapse: each projection has a small number of delay classes and
+//! every row is sorted so the synapses of one class are contiguous. Sub-row
+//! (pre, c) spans [m_RowStart[pre * numClasses + c], m_RowStart[pre * numClasses + c + 1]).
+//! With a single class this is plain CSR and the delay is a per-projection constant.
+class Projection
+{
+public:
+    //! Uniform delay (in timesteps) for every synapse
+    Projection(NeuronGroup &pre, NeuronGroup &post, unsigned int receptor,
+               BenchUtils::CSRConnectivity &&csr, unsigned int delay)
+    : m_Pre(pre), m_Post(post), m_Receptor(receptor), m_Delays(1, delay),
+      m_Ind(std::move(csr.ind)), m_Weight(std::move(csr.weight)), m_NumSynapticEvents(0)
+    {
+        checkConnectivity(csr);
+        m_RowStart.assign(csr.rowStart.begin(), csr.rowStart.end());
+    }
+
+    //! Delay classes - classOf(s) gives the class of CSR synapse s and
+    //! classDelays the delay of each class in timesteps
+    template<typename ClassOf>
+    Projection(NeuronGroup &pre, NeuronGroup &post, unsigned int receptor,
+               BenchUtils::CSRConnectivity &&csr, const std::vector<unsigned int> &classDelays, ClassOf classOf)
+    : m_Pre(pre), m_Post(post), m_Receptor(receptor), m_Delays(classDelays), m_NumSynapticEvents(0)
+    {
+        checkConnectivity(csr);
+        const size_t numClasses = m_Delays.size();
+        if(numClasses == 0) {
+            throw std::runtime_error("Projection needs at least one delay class");
+        }
+
+        // Count synapses in each (pre, class) sub-row
+        m_RowStart.assign(csr.numPre * numClasses + 1, 0);
+        for(unsigned int i = 0; i < csr.numPre; i++) {
+            for(size_t s = csr.rowStart[i]; s < csr.rowStart[i + 1]; s++) {
+                const unsigned int c = classOf(s);
+                if(c >= numClasses) {
+                    throw std::runtime_error("Synapse delay class out of range");
+                }
+                m_RowStart[i * numClasses + c + 1]++;
+            }
+        }
+        for(size_t r = 1; r < m_RowStart.size(); r++) {
+            m_RowStart[r] += m_RowStart[r - 1];
+        }
+
+        // Stable scatter into class order - a row keeps the same span, only its order changes
+        m_Ind.resize(csr.getNumSynapses());
+        m_Weight.resize(csr.getNumSynapses());
+        std::vector<unsigned int> cursor(m_RowStart.begin(), m_RowStart.end() - 1);
+        for(unsigned int i = 0; i < csr.numPre; i++) {
+            for(size_t s = csr.rowStart[i]; s < csr.rowStart[i + 1]; s++) {
+                const unsigned int d = cursor[i * numClasses + classOf(s)]++;
+                m_Ind[d] = csr.ind[s];
+                m_Weight[d] = csr.weight[s];
+            }
+        }
+    }
+
+    virtual ~Projection()
+    {}
+
+    //------------------------------------------------------------------------
+    // Declared virtuals
+    //------------------------------------------------------------------------
+    //! Schedule the presynaptic group's spikes from step into the postsynaptic input ring
+    virtual void propagate(unsigned long long step)
+    {
+        const auto &spikes = m_Pre.getSpikes();
+        if(spikes.empty()) {
+            return;
+        }
+
+        DelayBuffer &input = m_Post.getInput(m_Receptor);
+        const size_t numClasses = m_Delays.size();
+        uint64_t numSynapticEvents = 0;
+        for(size_t c = 0; c < numClasses; c++) {
+            float *out = input.getSlot(step + m_Delays[c]);
+            for(unsigned int i : spikes) {
+                const unsigned int *rowStart = &m_RowStart[i * numClasses + c];
+                for(unsigned int s = rowStart[0]; s < rowStart[1]; s++) {
+                    out[m_Ind[s]] += m_Weight[s];
+                }
+                numSynapticEvents += rowStart[1] - rowStart[0];
+            }
+        }
+        m_NumSynapticEvents += numSynapticEvents;
+        CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, numSynapticEvents);
+    }
+
+    //! Whether propagation can be split by postsynaptic neuron with partition().
+    //! Projections with state of their own, such as plastic ones, cannot be.
+    virtual bool isPartitionable() const{ return true; }
+
+    //! Static projections have no state of their own, but the connectivity
+    //! hash lets a restore detect a checkpoint from different connectivity
+    virtual void saveState(CheckpointWriter &writer) const
+    {
+        writer.beginSection("projection " + m_Pre.getName() + "->" + m_Post.getName());
+        writer.write(getConnectivityHash());
+    }
+
+    virtual void restoreState(CheckpointReader &reader)
+    {
+        reader.beginSection("projection " + m_Pre.getName() + "->" + m_Post.getName());
+        uint64_t connectivityHash;
+        reader.read(connectivityHash);
+        if(connectivityHash != getConnectivityHash()) {
+            throw std::runtime_error("Checkpoint was saved from different " + m_Pre.getName() + "->" + m_Post.getName() + " connectivity");
+        }
+    }
+
+    //! Count the connectivity. Overrides call this first and add any state of their own.
+    virtual void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        footprint.add(MEMORY_SYNAPSES, m_RowStart);
+        footprint.add(MEMORY_SYNAPSES, m_Ind);
+        footprint.add(MEMORY_SYNAPSES, m_Weight);
+        for(const auto &p : m_Partitions) {
+            footprint.add(MEMORY_SYNAPSES, p.rowStart);
+            footprint.add(MEMORY_SYNAPSES, p.ind);
+            footprint.add(MEMORY_SYNAPSES, p.weight);
+        }
+    }
+
+    //! Write-protect everything the simulation only reads, so processes
+    //! sharing it copy-on-write fault rather than silently un-share it
+    virtual void setConnectivityReadOnly(bool readOnly)
+    {
+        protectPages(m_RowStart, readOnly);
+        protectPages(m_Ind, readOnly);
+        protectPages(m_Weight, readOnly);
+        for(const auto &p : m_Partitions) {
+            protectPages(p.rowStart, readOnly);
+            protectPages(p.ind, readOnly);
+            protectPages(p.weight, readOnly);
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    NeuronGroup &getPre(){ return m_Pre; }
+    NeuronGroup &getPost(){ return m_Post; }
+    unsigned int getReceptor() const{ return m_Receptor; }
+
+    const std::vector<unsigned int> &getDelays() const{ return m_Delays; }
+    unsigned int getMaxDelay() const{ return *std::max_element(m_Delays.begin(), m_Delays.end()); }
+
+    size_t getNumSynapses() const
+    {
+        size_t numSynapses = m_Ind.size();
+        for(const auto &p : m_Partitions) {
+            numSynapses += p.ind.size();
+        }
+        return numSynapses;
+    }
+
+    //! Synapses which have received a presynaptic spike, counted once per spike
+    uint64_t getNumSynapticEvents() const
+    {
+        uint64_t numSynapticEvents = m_NumSynapticEvents;
+        for(const auto &p : m_Partitions) {
+            numSynapticEvents += p.numSynapticEvents;
+        }
+        return numSynapticEvents;
+    }
+
+    //! Connectivity of an unpartitioned projection
+    const BenchUtils::HugePageVector<unsigned int> &getRowStart() const{ return m_RowStart; }
+    const BenchUtils::HugePageVector<unsigned int> &getInd() const{ return m_Ind; }
+    BenchUtils::HugePageVector<float> &getWeight(){ return m_Weight; }
+
+    //! Hash of the connectivity as stored, which tags saved weight files
+    uint64_t getConnectivityHash() const
+    {
+        if(!m_Partitions.empty()) {
+            return m_PartitionedHash;
+        }
+
+        BenchUtils::ConnectivityHash hash(m_Pre.getSize(), m_Post.getSize());
+        for(size_t r = 0; r + 1 < m_RowStart.size(); r++) {
+            hash.addRow(m_Ind.data() + m_RowStart[r], m_RowStart[r + 1] - m_RowStart[r]);
+        }
+        return hash.getValue();
+    }
+
+    //! Split the synapses by the partition of their postsynaptic neuron - partition
+    //! t gets those onto [postRanges[t].first, postRanges[t].second) - and free the
+    //! unpartitioned arrays. Each partition's arrays are built on its own thread
+    //! so, by first touch, they live on its NUMA node.
+    void partition(const std::vector<std::pair<unsigned int, unsigned int>> &postRanges, WorkerPool &workers)
+    {
+        if(!m_Partitions.empty()) {
+            throw std::runtime_error("Projection " + m_Pre.getName() + "->" + m_Post.getName() + " is already partitioned");
+        }
+        const uint64_t hash = getConnectivityHash();
+        std::vector<ProjectionPartition> partitions(postRanges.size());
+        workers.run(
+            [this, &postRanges, &partitions](unsigned int t)
+            {
+                ProjectionPartition &p = partitions[t];
+                const unsigned int begin = postRanges[t].first;
+                const unsigned int end = postRanges[t].second;
+                p.numSynapticEvents = 0;
+
+                p.rowStart.resize(m_RowStart.size());
+                p.rowStart[0] = 0;
+                for(size_t r = 0; r + 1 < m_RowStart.size(); r++) {
+                    unsigned int rowLength = 0;
+                    for(unsigned int s = m_RowStart[r]; s < m_RowStart[r + 1]; s++) {
+                        rowLength += (m_Ind[s] >= begin && m_Ind[s] < end);
+                    }
+                    p.rowStart[r + 1] = p.rowStart[r] + rowLength;
+                }
+
+                p.ind.reserve(p.rowStart.back());
+                p.weight.reserve(p.rowStart.back());
+                for(unsigned int s = 0; s < m_RowStart.back(); s++) {
+                    if(m_Ind[s] >= begin && m_Ind[s] < end) {
+                        p.ind.push_back(m_Ind[s]);
+                        p.weight.push_back(m_Weight[s]);
+                    }
+                }
+            });
+
+        m_Partitions.swap(partitions);
+        m_PartitionedHash = hash;
+        BenchUtils::HugePageVector<unsigned int>().swap(m_RowStart);
+        BenchUtils::HugePageVector<unsigned int>().swap(m_Ind);
+        BenchUtils::HugePageVector<float>().swap(m_Weight);
+    }
+
+    //! Partition t's share of propagate(), which only writes to its own postsynaptic neurons
+    void propagatePartition(unsigned long long step, unsigned int t)
+    {
+        const auto &spikes = m_Pre.getSpikes();
+        if(spikes.empty()) {
+            return;
+        }
+
+        ProjectionPartition &p = m_Partitions[t];
+        DelayBuffer &input = m_Post.getInput(m_Receptor);
+        const size_t numClasses = m_Delays.size();
+        uint64_t numSynapticEvents = 0;
+        for(size_t c = 0; c < numClasses; c++) {
+            float *out = input.getSlot(step + m_Delays[c]);
+            for(unsigned int i : spikes) {
+                const unsigned int *rowStart = &p.rowStart[i * numClasses + c];
+                for(unsigned int s = rowStart[0]; s < rowStart[1]; s++) {
+                    out[p.ind[s]] += p.weight[s];
+                }
+                numSynapticEvents += rowStart[1] - rowStart[0];
+            }
+        }
+        p.numSynapticEvents += numSynapticEvents;
+        CPU_ENGINE_COUNT(COUNTER_SYNAPTIC_EVENTS, numSynapticEvents);
+    }
+
+    const std::vector<ProjectionPartition> &getPartitions() const{ return m_Partitions; }
+
+protected:
+    //! Change the protection of the whole pages within a vector's storage - the
+    //! partial pages at either end may hold allocator metadata or other data
+    template<typename T, typename A>
+    static void protectPages(const std::vector<T, A> &data, bool readOnly)
+    {
+        const uintptr_t pageSize = (uintptr_t)BenchUtils::getPageSize(data.data());
+        const uintptr_t begin = ((uintptr_t)data.data() + pageSize - 1) & ~(pageSize - 1);
+        const uintptr_t end = (uintptr_t)(data.data() + data.size()) & ~(pageSize - 1);
+        if(end > begin && mprotect((void*)begin, end - begin, readOnly ? PROT_READ : (PROT_READ | PROT_WRITE)) != 0) {
+            throw std::runtime_error("Cannot change the protection of connectivity pages");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    NeuronGroup &m_Pre;
+    NeuronGroup &m_Post;
+    const unsigned int m_Receptor;
+
+    //! Delay of each class in timesteps
+    std::vector<unsigned int> m_Delays;
+
+    BenchUtils::HugePageVector<unsigned int> m_RowStart;
+    BenchUtils::HugePageVector<unsigned int> m_Ind;
+    BenchUtils::HugePageVector<float> m_Weight;
+
+    //! Once partitioned, the synapses live here instead
+    std::vector<ProjectionPartition> m_Partitions;
+    uint64_t m_PartitionedHash;
+
+    //! Synaptic events delivered while unpartitioned
+    uint64_t m_NumSynapticEvents;
+
+private:
+    void checkConnectivity(const BenchUtils::CSRConnectivity &csr) const
+    {
+        if(csr.numPre != m_Pre.getSize() || csr.numPost != m_Post.getSize()) {
+            throw std::runtime_error("Connectivity is " + std::to_string(csr.numPre) + "x" + std::to_string(csr.numPost)
+                                     + " but " + m_Pre.getName() + "->" + m_Post.getName() + " needs "
+                                     + std::to_string(m_Pre.getSize()) + "x" + std::to_string(m_Post.getSize()));
+        }
+        if(m_Receptor >= m_Post.getNumReceptors()) {
+            throw std::runtime_error(m_Post.getName() + " has no receptor " + std::to_string(m_Receptor));
+        }
+        if(csr.rowStart.back() > 0xFFFFFFFFull) {
+            throw std::runtime_error("Projection " + m_Pre.getName() + "->" + m_Post.getName() + " has too many synapses");
+        }
+        for(unsigned int d : m_Delays) {
+            if(d == 0) {
+                throw std::runtime_error("Synaptic delays must be at least one timestep");
+            }
+        }
+    }
+};
+}   // namespace CPUEngine
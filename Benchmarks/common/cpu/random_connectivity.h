@@ -0,0 +1,51 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <vector>
+
+// Shared includes
+#include "../wmat_loader.h"
+
+// CPU engine includes
+#include "rng.h"
+
+//----------------------------------------------------------------------------
+// CPUEngine::fixedNumberPreCSR
+//----------------------------------------------------------------------------
+//! Builds the connectivity Spike's connect_with_sparsity uses for the Poisson
+//! inputs - every postsynaptic neuron draws numPerPost presynaptic partners
+//! uniformly with replacement - directly in presynaptic-major CSR
+namespace CPUEngine {
+inline BenchUtils::CSRConnectivity fixedNumberPreCSR(unsigned int numPre, unsigned int numPost,
+                                                     unsigned int numPerPost, float weight, Rng &rng)
+{
+    // Draw partners post-major, counting row lengths as we go
+    std::vector<unsigned int> preOf((size_t)numPost * numPerPost);
+    std::vector<unsigned int> rowLength(numPre, 0);
+    for(size_t s = 0; s < preOf.size(); s++) {
+        preOf[s] = rng.uniformInt(numPre);
+        rowLength[preOf[s]]++;
+    }
+
+    BenchUtils::CSRConnectivity csr;
+    csr.numPre = numPre;
+    csr.numPost = numPost;
+    csr.maxRowLength = 0;
+    csr.rowStart.resize(numPre + 1);
+    csr.rowStart[0] = 0;
+    for(unsigned int i = 0; i < numPre; i++) {
+        csr.rowStart[i + 1] = csr.rowStart[i] + rowLength[i];
+        csr.maxRowLength = std::max(csr.maxRowLength, rowLength[i]);
+    }
+
+    // Scatter into rows, which leaves each row sorted by postsynaptic index
+    csr.ind.resize(preOf.size());
+    csr.weight.assign(preOf.size(), weight);
+    std::vector<size_t> cursor(csr.rowStart.begin(), csr.rowStart.end() - 1);
+    for(size_t s = 0; s < preOf.size(); s++) {
+        csr.ind[cursor[preOf[s]]++] = (unsigned int)(s / numPerPost);
+    }
+    return csr;
+}
+}   // namespace CPUEngine
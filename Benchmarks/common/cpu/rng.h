@@ -0,0 +1,66 @@
+#pragma once
+
+// Standard C includes
+#include <cmath>
+#include <cstdint>
+
+//----------------------------------------------------------------------------
+// CPUEngine::Rng
+//----------------------------------------------------------------------------
+//! Small PCG32 generator - the whole stream position is two 64-bit words
+namespace CPUEngine {
+class Rng
+{
+public:
+    Rng(uint64_t seed, uint64_t stream = 0)
+    : m_State(0), m_Inc((stream << 1u) | 1u)
+    {
+        next();
+        m_State += seed;
+        next();
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Next 32 random bits
+    uint32_t next()
+    {
+        const uint64_t oldState = m_State;
+        m_State = oldState * 6364136223846793005ULL + m_Inc;
+        const uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+        const uint32_t rot = (uint32_t)(oldState >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((32u - rot) & 31u));
+    }
+
+    //! Uniform double in (0, 1] - never zero so it is safe to take the log of
+    double uniform()
+    {
+        return ((double)next() + 1.0) / 4294967296.0;
+    }
+
+    //! Uniform integer in [0, n)
+    uint32_t uniformInt(uint32_t n)
+    {
+        return (uint32_t)(((uint64_t)next() * n) >> 32);
+    }
+
+    //! Number of failures before the first success of a Bernoulli(p) process,
+    //! given logOneMinusP = log(1 - p)
+    uint32_t geometric(double logOneMinusP)
+    {
+        const double gap = std::floor(std::log(uniform()) / logOneMinusP);
+        return (gap < 4294967295.0) ? (uint32_t)gap : 4294967295u;
+    }
+
+    //! Continue from the current state along another of PCG's streams
+    void setStream(uint64_t stream){ m_Inc = (stream << 1u) | 1u; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    uint64_t m_State;
+    uint64_t m_Inc;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,94 @@
+#pragma once
+
+// Standard C++ includes
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Shared includes
+#include "../neuron_mask.h"
+#include "../spike_stream.h"
+
+// CPU engine includes
+#include "instrumentation.h"
+#include "memory_footprint.h"
+#include "neuron_groups.h"
+
+//----------------------------------------------------------------------------
+// CPUEngine::SpikeRecorder
+//----------------------------------------------------------------------------
+//! Buffers a group's spikes in memory and writes them as CSV, in the same
+//! "Time [ms], Neuron ID" format as the GeNN recorders, when destroyed.
+//! A mask can restrict recording to a subset of the neurons, and each step's
+//! recorded spikes can also be published to a shared-memory stream.
+namespace CPUEngine {
+class SpikeRecorder
+{
+public:
+    SpikeRecorder(const std::string &filename, const NeuronGroup &group, double dtMs)
+    : SpikeRecorder(filename, group.getSpikes(), dtMs)
+    {}
+
+    //! Record any spike list which is replaced every step, such as one instance of a batched group
+    SpikeRecorder(const std::string &filename, const std::vector<unsigned int> &spikes, double dtMs)
+    : m_Filename(filename), m_Spikes(spikes), m_DT(dtMs), m_Stream(nullptr), m_StreamGroup(0)
+    {}
+
+    ~SpikeRecorder()
+    {
+        std::ofstream stream(m_Filename.c_str());
+        stream.precision(16);
+        stream << "Time [ms], Neuron ID" << std::endl;
+        for(size_t s = 0; s < m_Ids.size(); s++) {
+            stream << (double)m_Steps[s] * m_DT << "," << m_Ids[s] << "\n";
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void record(unsigned long long step)
+    {
+        CPU_ENGINE_PHASE(PHASE_RECORDING);
+        const size_t start = m_Ids.size();
+        m_Mask.filter(m_Spikes.data(), m_Spikes.size(), m_Ids);
+        m_Steps.insert(m_Steps.end(), m_Ids.size() - start, step);
+        if(m_Stream != nullptr) {
+            m_Stream->publish(step, m_StreamGroup, m_Ids.data() + start, m_Ids.size() - start);
+        }
+    }
+
+    //! Only record the neurons selected by mask
+    void setMask(const BenchUtils::NeuronMask &mask){ m_Mask = mask; }
+
+    //! Also publish recorded spikes to stream as group, which must outlive the recorder
+    void setStream(BenchUtils::SpikeStreamPublisher &stream, unsigned int group)
+    {
+        m_Stream = &stream;
+        m_StreamGroup = group;
+    }
+
+    size_t getNumSpikes() const{ return m_Ids.size(); }
+
+    void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        footprint.add(MEMORY_RECORDERS, m_Steps);
+        footprint.add(MEMORY_RECORDERS, m_Ids);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Filename;
+    const std::vector<unsigned int> &m_Spikes;
+    const double m_DT;
+    BenchUtils::NeuronMask m_Mask;
+
+    std::vector<unsigned long long> m_Steps;
+    std::vector<unsigned int> m_Ids;
+
+    BenchUtils::SpikeStreamPublisher *m_Stream;
+    unsigned int m_StreamGroup;
+};
+}   // namespace CPUEngine
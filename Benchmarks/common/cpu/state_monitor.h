@@ -0,0 +1,256 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+#include <cstring>
+
+// CPU engine includes
+#include "instrumentation.h"
+#include "memory_footprint.h"
+#include "stdp.h"
+
+//----------------------------------------------------------------------------
+// State monitor file format
+//----------------------------------------------------------------------------
+// Little-endian throughout. A header:
+//   char[4] "SMON", uint32 version, uint32 numNeurons, uint32 numVariables,
+//   uint32 intervalSteps, uint32 padding, double dt (ms),
+//   uint32 neuronIDs[numNeurons], char[16] variableNames[numVariables]
+// followed by blocks of consecutive samples, stored column by column:
+//   uint64 numSamples, uint64 steps[numSamples],
+//   then for each variable float32 values[numSamples][numNeurons]
+namespace CPUEngine {
+namespace StateMonitorFormat {
+const char magic[4] = {'S', 'M', 'O', 'N'};
+const uint32_t version = 1;
+const size_t maxNameLength = 16;
+}   // namespace StateMonitorFormat
+
+//----------------------------------------------------------------------------
+// CPUEngine::StateVariable
+//----------------------------------------------------------------------------
+//! A per-neuron variable to monitor - either a plain array, such as a
+//! group's membrane potentials, or traces which decay on demand
+struct StateVariable
+{
+    std::string name;
+    const float *values;
+    const NeuronTraces *traces;
+
+    static StateVariable array(const std::string &name, const float *values){ return StateVariable{name, values, nullptr}; }
+    static StateVariable trace(const std::string &name, const NeuronTraces &traces){ return StateVariable{name, nullptr, &traces}; }
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::StateMonitor
+//----------------------------------------------------------------------------
+//! Samples variables of a subset of neurons every intervalSteps steps into a
+//! ring of ringSamples samples allocated up front, so memory stays bounded
+//! however long the run. The simulation thread only gathers the neurons'
+//! values into the ring; a background thread writes out blocks of samples
+//! once a quarter of the ring is waiting. Like WeightMonitor, a sample only
+//! waits for the writer if the whole ring is still waiting to be written.
+class StateMonitor
+{
+public:
+    StateMonitor(const std::string &filename, const std::vector<unsigned int> &neurons,
+                 const std::vector<StateVariable> &variables, double dtMs,
+                 unsigned int intervalSteps, unsigned int ringSamples = 1024)
+    : m_Neurons(neurons), m_Variables(variables), m_IntervalSteps(intervalSteps),
+      m_RingSamples(ringSamples), m_FlushSamples(std::max(1u, ringSamples / 4)),
+      m_Stream(filename.c_str(), std::ios::binary), m_NumSamples(0), m_NumStalls(0),
+      m_Written(0), m_Quit(false)
+    {
+        if(!m_Stream.good()) {
+            throw std::runtime_error("Could not open state monitor file: " + filename);
+        }
+        if(m_IntervalSteps == 0 || m_RingSamples == 0) {
+            throw std::runtime_error("State monitor interval and ring must be at least one sample");
+        }
+
+        const uint32_t numNeurons = (uint32_t)m_Neurons.size();
+        const uint32_t numVariables = (uint32_t)m_Variables.size();
+        const uint32_t padding = 0;
+        m_Stream.write(StateMonitorFormat::magic, 4);
+        m_Stream.write((const char*)&StateMonitorFormat::version, sizeof(uint32_t));
+        m_Stream.write((const char*)&numNeurons, sizeof(uint32_t));
+        m_Stream.write((const char*)&numVariables, sizeof(uint32_t));
+        m_Stream.write((const char*)&m_IntervalSteps, sizeof(uint32_t));
+        m_Stream.write((const char*)&padding, sizeof(uint32_t));
+        m_Stream.write((const char*)&dtMs, sizeof(double));
+        m_Stream.write((const char*)m_Neurons.data(), numNeurons * sizeof(uint32_t));
+        for(const auto &v : m_Variables) {
+            char name[StateMonitorFormat::maxNameLength] = {};
+            strncpy(name, v.name.c_str(), StateMonitorFormat::maxNameLength - 1);
+            m_Stream.write(name, StateMonitorFormat::maxNameLength);
+        }
+
+        m_Steps.resize(m_RingSamples);
+        m_Values.resize(m_Variables.size());
+        for(auto &v : m_Values) {
+            v.resize((size_t)m_RingSamples * m_Neurons.size());
+        }
+        m_Writer = std::thread(&StateMonitor::writeLoop, this);
+    }
+
+    ~StateMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Quit = true;
+        }
+        m_Condition.notify_all();
+        m_Writer.join();
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Call after every step with the number of steps simulated so far
+    void record(unsigned long long step)
+    {
+        if((step % m_IntervalSteps) == 0) {
+            sample(step);
+        }
+    }
+
+    //! Sample the variables now
+    void sample(unsigned long long step)
+    {
+        CPU_ENGINE_PHASE(PHASE_RECORDING);
+
+        // Wait for a slot if the writer has fallen a whole ring behind
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if(m_NumSamples - m_Written >= m_RingSamples) {
+                m_NumStalls++;
+                m_Condition.wait(lock, [this]{ return m_NumSamples - m_Written < m_RingSamples; });
+            }
+        }
+
+        const size_t slot = (size_t)(m_NumSamples % m_RingSamples);
+        const size_t numNeurons = m_Neurons.size();
+        m_Steps[slot] = step;
+        for(size_t v = 0; v < m_Variables.size(); v++) {
+            float *out = &m_Values[v][slot * numNeurons];
+            const StateVariable &variable = m_Variables[v];
+            if(variable.traces != nullptr) {
+                for(size_t k = 0; k < numNeurons; k++) {
+                    out[k] = variable.traces->get(m_Neurons[k], step);
+                }
+            }
+            else {
+                for(size_t k = 0; k < numNeurons; k++) {
+                    out[k] = variable.values[m_Neurons[k]];
+                }
+            }
+        }
+
+        bool flush;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_NumSamples++;
+            flush = (m_NumSamples - m_Written) >= m_FlushSamples;
+        }
+        if(flush) {
+            m_Condition.notify_all();
+        }
+    }
+
+    unsigned int getIntervalSteps() const{ return m_IntervalSteps; }
+    unsigned long long getNumSamples() const{ return m_NumSamples; }
+
+    //! Samples which had to wait for the writer thread
+    unsigned long long getNumStalls() const{ return m_NumStalls; }
+
+    void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        footprint.add(MEMORY_RECORDERS, m_Steps);
+        footprint.add(MEMORY_RECORDERS, m_Values);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void writeLoop()
+    {
+        while(true) {
+            unsigned long long begin;
+            unsigned long long end;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]{ return (m_NumSamples - m_Written) >= m_FlushSamples || m_Quit; });
+                if(m_NumSamples == m_Written) {
+                    return;
+                }
+                begin = m_Written;
+                end = m_NumSamples;
+            }
+
+            // Samples [begin, end) are not touched by the simulation thread until they are released below.
+            // Write them in at most two blocks, as they may wrap around the end of the ring.
+            const unsigned long long wrap = begin + (m_RingSamples - (begin % m_RingSamples));
+            writeBlock(begin, std::min(end, wrap));
+            if(end > wrap) {
+                writeBlock(wrap, end);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Written = end;
+            }
+            m_Condition.notify_all();
+        }
+    }
+
+    void writeBlock(unsigned long long begin, unsigned long long end)
+    {
+        const uint64_t numSamples = end - begin;
+        const size_t slot = (size_t)(begin % m_RingSamples);
+        const size_t numNeurons = m_Neurons.size();
+        m_Stream.write((const char*)&numSamples, sizeof(uint64_t));
+        m_Stream.write((const char*)&m_Steps[slot], numSamples * sizeof(uint64_t));
+        for(const auto &v : m_Values) {
+            m_Stream.write((const char*)&v[slot * numNeurons], numSamples * numNeurons * sizeof(float));
+        }
+        m_Stream.flush();
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::vector<unsigned int> m_Neurons;
+    const std::vector<StateVariable> m_Variables;
+    const unsigned int m_IntervalSteps;
+    const unsigned int m_RingSamples;
+    const unsigned int m_FlushSamples;
+
+    //! Only written by the writer thread once it has started
+    std::ofstream m_Stream;
+
+    //! Ring of samples - the step of each slot and, per variable, the neurons' values of each slot
+    std::vector<uint64_t> m_Steps;
+    std::vector<std::vector<float>> m_Values;
+
+    //! Guarded by m_Mutex - samples taken and samples written so far
+    unsigned long long m_NumSamples;
+    unsigned long long m_NumStalls;
+    unsigned long long m_Written;
+    bool m_Quit;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::thread m_Writer;
+};
+}   // namespace CPUEngine
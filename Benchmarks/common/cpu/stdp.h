@@ -0,0 +1,123 @@
+#pragma once
+
+// Standard C++ includes
+#include <vector>
+
+// Standard C includes
+#include <cmath>
+
+// CPU engine includes
+#include "checkpoint.h"
+#include "memory_footprint.h"
+
+namespace CPUEngine {
+//----------------------------------------------------------------------------
+// CPUEngine::STDPParams
+//----------------------------------------------------------------------------
+//! Parameters of the weight-dependent STDP rule in Brunel/genn/stdp_multiplicative.h
+//! (times in ms, weights in the units of the projection)
+struct STDPParams
+{
+    double tauPlus;
+    double tauMinus;
+    double aPlus;
+    double aMinus;
+    double wMin;
+    double wMax;
+    double lambda;
+    double alpha;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::ExpDecayTable
+//----------------------------------------------------------------------------
+//! exp(-n * dt / tau) for whole numbers of timesteps n. Beyond the end of the
+//! table the factor is below 1e-9 and is treated as zero.
+class ExpDecayTable
+{
+public:
+    ExpDecayTable(double tauMs, double dtMs)
+    {
+        for(unsigned int n = 0;; n++) {
+            const double decay = std::exp(-(double)n * dtMs / tauMs);
+            if(decay < 1.0E-9) {
+                break;
+            }
+            m_Decay.push_back((float)decay);
+        }
+    }
+
+    float operator[](unsigned long long numSteps) const
+    {
+        return (numSteps < m_Decay.size()) ? m_Decay[(size_t)numSteps] : 0.0f;
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<float> m_Decay;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::NeuronTraces
+//----------------------------------------------------------------------------
+//! One exponentially decaying trace per neuron. Traces only change when their
+//! neuron spikes, so each stores its value at its last update and is decayed
+//! to the current step on demand.
+class NeuronTraces
+{
+public:
+    NeuronTraces(unsigned int numNeurons, double tauMs, double dtMs)
+    : m_Value(numNeurons, 0.0f), m_LastStep(numNeurons, 0), m_Decay(tauMs, dtMs)
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Value of trace i at step
+    float get(unsigned int i, unsigned long long step) const
+    {
+        return m_Value[i] * m_Decay[step - m_LastStep[i]];
+    }
+
+    //! Set trace i to value at step
+    void set(unsigned int i, unsigned long long step, float value)
+    {
+        m_Value[i] = value;
+        m_LastStep[i] = step;
+    }
+
+    //! Step at which trace i was last set i.e. its neuron's last spike
+    unsigned long long getLastStep(unsigned int i) const{ return m_LastStep[i]; }
+    const unsigned long long *getLastSteps() const{ return m_LastStep.data(); }
+
+    unsigned int getNumNeurons() const{ return (unsigned int)m_Value.size(); }
+
+    void saveState(CheckpointWriter &writer) const
+    {
+        writer.write(m_Value);
+        writer.write(m_LastStep);
+    }
+
+    void restoreState(CheckpointReader &reader)
+    {
+        reader.read(m_Value);
+        reader.read(m_LastStep);
+    }
+
+    void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        footprint.add(MEMORY_PLASTICITY, m_Value);
+        footprint.add(MEMORY_PLASTICITY, m_LastStep);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<float> m_Value;
+    std::vector<unsigned long long> m_LastStep;
+    ExpDecayTable m_Decay;
+};
+}   // namespace CPUEngine
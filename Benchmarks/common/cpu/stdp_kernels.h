@@ -0,0 +1,159 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+
+// Standard C includes
+#include <cstddef>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+
+//----------------------------------------------------------------------------
+// CPUEngine::STDPKernels
+//----------------------------------------------------------------------------
+//! Weight update loops of the weight-dependent STDP rule. Each has a scalar
+//! reference and a SIMD version chosen at compile time (AVX-512, then AVX2).
+//! The SIMD versions perform the same float operations in the same order -
+//! including min/max argument order, which decides which operand is returned
+//! on ties - so with -ffp-contract=off they match the scalar ones bitwise.
+namespace CPUEngine {
+namespace STDPKernels {
+//! Depression of a presynaptic row on spike arrival:
+//! weight[s] = max(weight[s] - depression * weight[s] * postTrace[ind[s]], wMin)
+inline void depressRowScalar(float *weight, const unsigned int *ind, size_t n,
+                             const float *postTrace, float depression, float wMin)
+{
+    for(size_t s = 0; s < n; s++) {
+        const float newWeight = weight[s] - depression * weight[s] * postTrace[ind[s]];
+        weight[s] = std::max(newWeight, wMin);
+    }
+}
+
+//! Potentiation of a postsynaptic column on a postsynaptic spike:
+//! weight[syn[k]] = min(weight[syn[k]] + lambda * (wMax - weight[syn[k]]) * preTrace[pre[k]], wMax)
+inline void potentiateColumnScalar(float *weight, const unsigned int *syn, const unsigned int *pre, size_t n,
+                                   const float *preTrace, float lambda, float wMax)
+{
+    const size_t prefetchDistance = 8;
+    for(size_t k = 0; k < n; k++) {
+#ifdef __GNUC__
+        // Incoming synapses are scattered through the weight array so fetch ahead
+        if(k + prefetchDistance < n) {
+            __builtin_prefetch(&weight[syn[k + prefetchDistance]], 1);
+        }
+#endif
+        const unsigned int s = syn[k];
+        const float newWeight = weight[s] + lambda * (wMax - weight[s]) * preTrace[pre[k]];
+        weight[s] = std::min(newWeight, wMax);
+    }
+}
+
+//! Potentiation for presynaptic-centred pairing - only synapses whose presynaptic
+//! neuron has spiked after sinceStep (the postsynaptic neuron's previous spike)
+//! are paired. There is no SIMD version as the gate needs a 64-bit gather per synapse.
+inline void potentiateColumnGatedScalar(float *weight, const unsigned int *syn, const unsigned int *pre, size_t n,
+                                        const float *preTrace, const unsigned long long *preLastStep,
+                                        unsigned long long sinceStep, float lambda, float wMax)
+{
+    for(size_t k = 0; k < n; k++) {
+        if(preLastStep[pre[k]] > sinceStep) {
+            const unsigned int s = syn[k];
+            const float newWeight = weight[s] + lambda * (wMax - weight[s]) * preTrace[pre[k]];
+            weight[s] = std::min(newWeight, wMax);
+        }
+    }
+}
+
+#if defined(__AVX512F__)
+inline const char *getISA(){ return "AVX-512"; }
+
+inline void depressRow(float *weight, const unsigned int *ind, size_t n,
+                       const float *postTrace, float depression, float wMin)
+{
+    const __m512 depressionV = _mm512_set1_ps(depression);
+    const __m512 wMinV = _mm512_set1_ps(wMin);
+    for(size_t s = 0; s < n; s += 16) {
+        const __mmask16 mask = (n - s >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - s)) - 1u);
+        const __m512 w = _mm512_maskz_loadu_ps(mask, weight + s);
+        const __m512i j = _mm512_maskz_loadu_epi32(mask, ind + s);
+        const __m512 trace = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, j, postTrace, 4);
+        const __m512 newWeight = _mm512_sub_ps(w, _mm512_mul_ps(_mm512_mul_ps(depressionV, w), trace));
+        _mm512_mask_storeu_ps(weight + s, mask, _mm512_max_ps(wMinV, newWeight));
+    }
+}
+
+inline void potentiateColumn(float *weight, const unsigned int *syn, const unsigned int *pre, size_t n,
+                             const float *preTrace, float lambda, float wMax)
+{
+    // Column entries are distinct synapses so the scatter never has conflicting lanes
+    const __m512 lambdaV = _mm512_set1_ps(lambda);
+    const __m512 wMaxV = _mm512_set1_ps(wMax);
+    for(size_t k = 0; k < n; k += 16) {
+        const __mmask16 mask = (n - k >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - k)) - 1u);
+        const __m512i s = _mm512_maskz_loadu_epi32(mask, syn + k);
+        const __m512i i = _mm512_maskz_loadu_epi32(mask, pre + k);
+        const __m512 w = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, s, weight, 4);
+        const __m512 trace = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, i, preTrace, 4);
+        const __m512 newWeight = _mm512_add_ps(w, _mm512_mul_ps(_mm512_mul_ps(lambdaV, _mm512_sub_ps(wMaxV, w)), trace));
+        _mm512_mask_i32scatter_ps(weight, mask, s, _mm512_min_ps(wMaxV, newWeight), 4);
+    }
+}
+#elif defined(__AVX2__)
+inline const char *getISA(){ return "AVX2"; }
+
+inline void depressRow(float *weight, const unsigned int *ind, size_t n,
+                       const float *postTrace, float depression, float wMin)
+{
+    const __m256 depressionV = _mm256_set1_ps(depression);
+    const __m256 wMinV = _mm256_set1_ps(wMin);
+    size_t s = 0;
+    for(; s + 8 <= n; s += 8) {
+        const __m256 w = _mm256_loadu_ps(weight + s);
+        const __m256i j = _mm256_loadu_si256((const __m256i*)(ind + s));
+        const __m256 trace = _mm256_i32gather_ps(postTrace, j, 4);
+        const __m256 newWeight = _mm256_sub_ps(w, _mm256_mul_ps(_mm256_mul_ps(depressionV, w), trace));
+        _mm256_storeu_ps(weight + s, _mm256_max_ps(wMinV, newWeight));
+    }
+    depressRowScalar(weight + s, ind + s, n - s, postTrace, depression, wMin);
+}
+
+inline void potentiateColumn(float *weight, const unsigned int *syn, const unsigned int *pre, size_t n,
+                             const float *preTrace, float lambda, float wMax)
+{
+    // AVX2 has gathers but no scatter, so new weights are written back one lane at a time
+    const __m256 lambdaV = _mm256_set1_ps(lambda);
+    const __m256 wMaxV = _mm256_set1_ps(wMax);
+    alignas(32) float newWeights[8];
+    size_t k = 0;
+    for(; k + 8 <= n; k += 8) {
+        const __m256i s = _mm256_loadu_si256((const __m256i*)(syn + k));
+        const __m256i i = _mm256_loadu_si256((const __m256i*)(pre + k));
+        const __m256 w = _mm256_i32gather_ps(weight, s, 4);
+        const __m256 trace = _mm256_i32gather_ps(preTrace, i, 4);
+        const __m256 newWeight = _mm256_add_ps(w, _mm256_mul_ps(_mm256_mul_ps(lambdaV, _mm256_sub_ps(wMaxV, w)), trace));
+        _mm256_store_ps(newWeights, _mm256_min_ps(wMaxV, newWeight));
+        for(unsigned int l = 0; l < 8; l++) {
+            weight[syn[k + l]] = newWeights[l];
+        }
+    }
+    potentiateColumnScalar(weight, syn + k, pre + k, n - k, preTrace, lambda, wMax);
+}
+#else
+inline const char *getISA(){ return "scalar"; }
+
+inline void depressRow(float *weight, const unsigned int *ind, size_t n,
+                       const float *postTrace, float depression, float wMin)
+{
+    depressRowScalar(weight, ind, n, postTrace, depression, wMin);
+}
+
+inline void potentiateColumn(float *weight, const unsigned int *syn, const unsigned int *pre, size_t n,
+                             const float *preTrace, float lambda, float wMax)
+{
+    potentiateColumnScalar(weight, syn, pre, n, preTrace, lambda, wMax);
+}
+#endif
+}   // namespace STDPKernels
+}   // namespace CPUEngine
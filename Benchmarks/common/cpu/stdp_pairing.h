@@ -0,0 +1,55 @@
+#pragma once
+
+// CPU engine includes
+#include "stdp.h"
+
+//----------------------------------------------------------------------------
+// CPUEngine::Pairing
+//----------------------------------------------------------------------------
+//! Spike pairing schemes for PlasticProjection (Morrison, Diesmann & Gerstner 2008).
+//! Each scheme says how a neuron's trace responds to one of its spikes and
+//! whether potentiation only pairs a postsynaptic spike with a presynaptic
+//! spike that no earlier postsynaptic spike has already been paired with.
+namespace CPUEngine {
+namespace Pairing {
+//! Every presynaptic spike pairs with every postsynaptic spike - traces accumulate
+struct AllToAll
+{
+    static const char *getName(){ return "all_to_all"; }
+    static const bool gatePotentiation = false;
+
+    static void addSpike(NeuronTraces &traces, unsigned int i, unsigned long long step, float increment)
+    {
+        traces.set(i, step, traces.get(i, step) + increment);
+    }
+};
+
+//! Symmetric nearest-neighbour - each spike pairs only with the most recent
+//! spike on the other side, so traces are reset rather than accumulated
+struct Nearest
+{
+    static const char *getName(){ return "nearest"; }
+    static const bool gatePotentiation = false;
+
+    static void addSpike(NeuronTraces &traces, unsigned int i, unsigned long long step, float increment)
+    {
+        traces.set(i, step, increment);
+    }
+};
+
+//! Presynaptic-centred nearest-neighbour - each presynaptic spike pairs with the
+//! last postsynaptic spike before it and the first one after it, so a
+//! postsynaptic spike only potentiates if the presynaptic neuron has spiked
+//! since that postsynaptic neuron last did
+struct PresynapticCentred
+{
+    static const char *getName(){ return "presynaptic_centred"; }
+    static const bool gatePotentiation = true;
+
+    static void addSpike(NeuronTraces &traces, unsigned int i, unsigned long long step, float increment)
+    {
+        traces.set(i, step, increment);
+    }
+};
+}   // namespace Pairing
+}   // namespace CPUEngine
@@ -0,0 +1,386 @@
+#pragma once
+
+// Standard C++ includes
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+#include <cstring>
+
+// CPU engine includes
+#include "instrumentation.h"
+#include "memory_footprint.h"
+#include "projection.h"
+
+//----------------------------------------------------------------------------
+// Weight monitor file format
+//----------------------------------------------------------------------------
+// Little-endian throughout. A header:
+//   char[4] "WMON", uint32 version, uint64 numSynapses, double dt (ms)
+// followed by one record per snapshot:
+//   uint64 step, uint8 type, uint64 payloadBytes, payload
+// A keyframe's payload is the raw float32 weights. A delta's payload is the
+// weights' bits XORed with the previous snapshot's: a control stream of one
+// nibble per weight, giving how many low-order bytes of its XOR are non-zero
+// (two weights per byte, first weight in the low nibble), then those bytes.
+// Unchanged weights cost half a byte and small changes usually two or three.
+namespace CPUEngine {
+namespace WeightMonitorFormat {
+const char magic[4] = {'W', 'M', 'O', 'N'};
+const uint32_t version = 1;
+
+enum RecordType : uint8_t
+{
+    RECORD_KEYFRAME,
+    RECORD_DELTA,
+};
+
+inline void encodeDelta(const uint32_t *previous, const uint32_t *current, size_t n, std::vector<uint8_t> &payload)
+{
+    const size_t controlBytes = (n + 1) / 2;
+    payload.assign(controlBytes, 0);
+    payload.reserve(controlBytes + (n * 4));
+    for(size_t s = 0; s < n; s++) {
+        uint32_t x = previous[s] ^ current[s];
+        uint8_t numBytes = 0;
+        while(x != 0) {
+            payload.push_back((uint8_t)(x & 0xFF));
+            x >>= 8;
+            numBytes++;
+        }
+        payload[s / 2] |= (uint8_t)(numBytes << ((s % 2) * 4));
+    }
+}
+
+//! Applies a delta payload to the previous snapshot's bits in place
+inline void applyDelta(uint32_t *bits, size_t n, const uint8_t *payload, size_t payloadBytes)
+{
+    const size_t controlBytes = (n + 1) / 2;
+    if(payloadBytes < controlBytes) {
+        throw std::runtime_error("Truncated weight delta");
+    }
+    const uint8_t *data = payload + controlBytes;
+    const uint8_t *end = payload + payloadBytes;
+    for(size_t s = 0; s < n; s++) {
+        const unsigned int numBytes = (payload[s / 2] >> ((s % 2) * 4)) & 0xF;
+        if(numBytes > 4 || data + numBytes > end) {
+            throw std::runtime_error("Corrupt weight delta");
+        }
+        uint32_t x = 0;
+        for(unsigned int b = 0; b < numBytes; b++) {
+            x |= (uint32_t)data[b] << (8 * b);
+        }
+        data += numBytes;
+        bits[s] ^= x;
+    }
+}
+}   // namespace WeightMonitorFormat
+
+//----------------------------------------------------------------------------
+// CPUEngine::WeightMonitor
+//----------------------------------------------------------------------------
+//! Periodically snapshots a projection's weights. The simulation thread only
+//! copies the weights into whichever of two buffers is free; a background
+//! thread encodes each snapshot against the previous one and writes it, with
+//! a keyframe every keyframeInterval snapshots so any snapshot can be rebuilt
+//! without replaying the whole file.
+class WeightMonitor
+{
+public:
+    WeightMonitor(const std::string &filename, Projection &projection, double dtMs,
+                  unsigned int intervalSteps, unsigned int keyframeInterval = 16)
+    : WeightMonitor(filename, projection.getNumSynapses(), dtMs, intervalSteps, keyframeInterval)
+    {
+        m_Projection = &projection;
+    }
+
+    //! Monitor weights held elsewhere, e.g. on a GPU, which are passed to
+    //! snapshot in presynaptic-major order
+    WeightMonitor(const std::string &filename, uint64_t numSynapses, double dtMs,
+                  unsigned int intervalSteps, unsigned int keyframeInterval = 16)
+    : m_Projection(nullptr), m_IntervalSteps(intervalSteps), m_KeyframeInterval(keyframeInterval),
+      m_Stream(filename.c_str(), std::ios::binary), m_NumSnapshots(0), m_NumStalls(0),
+      m_Pending(2, false), m_PendingStep(2, 0), m_NextBuffer(0), m_Quit(false)
+    {
+        if(!m_Stream.good()) {
+            throw std::runtime_error("Could not open weight monitor file: " + filename);
+        }
+        if(m_IntervalSteps == 0 || m_KeyframeInterval == 0) {
+            throw std::runtime_error("Weight monitor intervals must be at least one");
+        }
+
+        m_Stream.write(WeightMonitorFormat::magic, 4);
+        m_Stream.write((const char*)&WeightMonitorFormat::version, sizeof(uint32_t));
+        m_Stream.write((const char*)&numSynapses, sizeof(uint64_t));
+        m_Stream.write((const char*)&dtMs, sizeof(double));
+
+        for(auto &b : m_Buffers) {
+            b.resize(numSynapses);
+        }
+        m_Writer = std::thread(&WeightMonitor::writeLoop, this);
+    }
+
+    ~WeightMonitor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Quit = true;
+        }
+        m_Condition.notify_all();
+        m_Writer.join();
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Call after every step with the number of steps simulated so far
+    void record(unsigned long long step)
+    {
+        if(isSnapshotStep(step)) {
+            snapshot(step);
+        }
+    }
+
+    //! Snapshot the projection's weights now, e.g. at the end of a run
+    void snapshot(unsigned long long step)
+    {
+        if(m_Projection == nullptr) {
+            throw std::runtime_error("Weight monitor has no projection to snapshot");
+        }
+        snapshot(step, m_Projection->getWeight().data());
+    }
+
+    //! Snapshot weights copied from elsewhere, laid out as the projection's
+    void snapshot(unsigned long long step, const float *weights)
+    {
+        CPU_ENGINE_PHASE(PHASE_RECORDING);
+
+        // Wait for the buffer if the writer has fallen two snapshots behind
+        const unsigned int b = m_NextBuffer;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if(m_Pending[b]) {
+                m_NumStalls++;
+                m_Condition.wait(lock, [this, b]{ return !m_Pending[b]; });
+            }
+        }
+
+        std::memcpy(m_Buffers[b].data(), weights, m_Buffers[b].size() * sizeof(float));
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Pending[b] = true;
+            m_PendingStep[b] = step;
+        }
+        m_Condition.notify_all();
+        m_NextBuffer = 1 - b;
+        m_NumSnapshots++;
+    }
+
+    bool isSnapshotStep(unsigned long long step) const{ return (step % m_IntervalSteps) == 0; }
+    unsigned int getIntervalSteps() const{ return m_IntervalSteps; }
+    unsigned long long getNumSnapshots() const{ return m_NumSnapshots; }
+
+    //! Snapshots which had to wait for the writer thread
+    unsigned long long getNumStalls() const{ return m_NumStalls; }
+
+    //! The snapshot buffers - the writer thread's copy of the previous snapshot is not counted
+    void addMemoryFootprint(MemoryFootprint &footprint) const
+    {
+        footprint.add(MEMORY_RECORDERS, m_Buffers[0]);
+        footprint.add(MEMORY_RECORDERS, m_Buffers[1]);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void writeLoop()
+    {
+        std::vector<uint32_t> previous;
+        std::vector<uint8_t> payload;
+        unsigned int b = 0;
+        for(unsigned long long n = 0;; n++) {
+            unsigned long long step;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this, b]{ return m_Pending[b] || m_Quit; });
+                if(!m_Pending[b]) {
+                    return;
+                }
+                step = m_PendingStep[b];
+            }
+
+            // Buffer b is not touched by the simulation thread until it is released below
+            const uint32_t *current = (const uint32_t*)m_Buffers[b].data();
+            const size_t numSynapses = m_Buffers[b].size();
+            const bool keyframe = (n % m_KeyframeInterval) == 0;
+            if(keyframe) {
+                writeRecord(step, WeightMonitorFormat::RECORD_KEYFRAME, (const char*)current, numSynapses * sizeof(float));
+            }
+            else {
+                WeightMonitorFormat::encodeDelta(previous.data(), current, numSynapses, payload);
+                writeRecord(step, WeightMonitorFormat::RECORD_DELTA, (const char*)payload.data(), payload.size());
+            }
+            previous.assign(current, current + numSynapses);
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Pending[b] = false;
+            }
+            m_Condition.notify_all();
+            b = 1 - b;
+        }
+    }
+
+    void writeRecord(uint64_t step, uint8_t type, const char *payload, uint64_t payloadBytes)
+    {
+        m_Stream.write((const char*)&step, sizeof(uint64_t));
+        m_Stream.write((const char*)&type, sizeof(uint8_t));
+        m_Stream.write((const char*)&payloadBytes, sizeof(uint64_t));
+        m_Stream.write(payload, payloadBytes);
+        m_Stream.flush();
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    //! Projection whose weights are snapshot, if they are held by the CPU engine
+    Projection *m_Projection;
+    const unsigned int m_IntervalSteps;
+    const unsigned int m_KeyframeInterval;
+
+    //! Only written by the writer thread once it has started
+    std::ofstream m_Stream;
+
+    unsigned long long m_NumSnapshots;
+    unsigned long long m_NumStalls;
+
+    //! Snapshot buffers, filled alternately by the simulation thread
+    std::vector<float> m_Buffers[2];
+
+    //! Guarded by m_Mutex - whether each buffer is waiting to be written and its step
+    std::vector<bool> m_Pending;
+    std::vector<unsigned long long> m_PendingStep;
+    unsigned int m_NextBuffer;
+    bool m_Quit;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    std::thread m_Writer;
+};
+
+//----------------------------------------------------------------------------
+// CPUEngine::WeightMonitorReader
+//----------------------------------------------------------------------------
+//! Indexes a weight monitor file and rebuilds any snapshot from the nearest
+//! preceding keyframe. Python equivalent: common/weight_monitor.py
+class WeightMonitorReader
+{
+public:
+    WeightMonitorReader(const std::string &filename)
+    : m_Stream(filename.c_str(), std::ios::binary)
+    {
+        if(!m_Stream.good()) {
+            throw std::runtime_error("Could not open weight monitor file: " + filename);
+        }
+
+        char magic[4];
+        uint32_t version;
+        m_Stream.read(magic, 4);
+        m_Stream.read((char*)&version, sizeof(uint32_t));
+        m_Stream.read((char*)&m_NumSynapses, sizeof(uint64_t));
+        m_Stream.read((char*)&m_DT, sizeof(double));
+        if(!m_Stream.good() || std::memcmp(magic, WeightMonitorFormat::magic, 4) != 0
+           || version != WeightMonitorFormat::version)
+        {
+            throw std::runtime_error(filename + " is not a weight monitor file");
+        }
+
+        m_Stream.seekg(0, std::ios::end);
+        const std::streamoff fileSize = m_Stream.tellg();
+        m_Stream.seekg(4 + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double));
+
+        // Index records - a record cut short by a crash is ignored
+        while(true) {
+            Record record;
+            uint8_t type;
+            m_Stream.read((char*)&record.step, sizeof(uint64_t));
+            m_Stream.read((char*)&type, sizeof(uint8_t));
+            m_Stream.read((char*)&record.payloadBytes, sizeof(uint64_t));
+            if(!m_Stream.good()) {
+                break;
+            }
+            record.keyframe = (type == WeightMonitorFormat::RECORD_KEYFRAME);
+            record.offset = m_Stream.tellg();
+            if(record.offset + (std::streamoff)record.payloadBytes > fileSize) {
+                break;
+            }
+            m_Records.push_back(record);
+            m_Stream.seekg(record.payloadBytes, std::ios::cur);
+        }
+        m_Stream.clear();
+        if(!m_Records.empty() && !m_Records.front().keyframe) {
+            throw std::runtime_error(filename + " does not start with a keyframe");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    size_t getNumSnapshots() const{ return m_Records.size(); }
+    uint64_t getNumSynapses() const{ return m_NumSynapses; }
+    unsigned long long getStep(size_t snapshot) const{ return m_Records.at(snapshot).step; }
+    double getTime(size_t snapshot) const{ return (double)getStep(snapshot) * m_DT; }
+
+    //! Weights of snapshot, in the projection's presynaptic-major order
+    std::vector<float> read(size_t snapshot)
+    {
+        size_t keyframe = snapshot;
+        while(!m_Records.at(keyframe).keyframe) {
+            keyframe--;
+        }
+
+        std::vector<float> weights(m_NumSynapses);
+        std::vector<uint8_t> payload;
+        for(size_t r = keyframe; r <= snapshot; r++) {
+            const Record &record = m_Records[r];
+            m_Stream.seekg(record.offset);
+            if(record.keyframe) {
+                if(record.payloadBytes != m_NumSynapses * sizeof(float)) {
+                    throw std::runtime_error("Corrupt weight keyframe");
+                }
+                m_Stream.read((char*)weights.data(), record.payloadBytes);
+            }
+            else {
+                payload.resize(record.payloadBytes);
+                m_Stream.read((char*)payload.data(), record.payloadBytes);
+                WeightMonitorFormat::applyDelta((uint32_t*)weights.data(), m_NumSynapses, payload.data(), payload.size());
+            }
+        }
+        return weights;
+    }
+
+private:
+    struct Record
+    {
+        uint64_t step;
+        bool keyframe;
+        uint64_t payloadBytes;
+        std::streamoff offset;
+    };
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::ifstream m_Stream;
+    uint64_t m_NumSynapses;
+    double m_DT;
+    std::vector<Record> m_Records;
+};
+}   // namespace CPUEngine
@@ -0,0 +1,168 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+
+// POSIX includes
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+// BenchUtils
+//----------------------------------------------------------------------------
+namespace BenchUtils {
+//----------------------------------------------------------------------------
+// BenchUtils::PhysicalCore
+//----------------------------------------------------------------------------
+//! One physical core and the logical CPUs (SMT siblings) which share it
+struct PhysicalCore
+{
+    unsigned int node;
+    std::vector<unsigned int> cpus;
+};
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Parse a sysfs CPU or node list such as "0-3,8,10-11"
+inline std::vector<unsigned int> parseCPUList(const std::string &list)
+{
+    std::vector<unsigned int> cpus;
+    size_t pos = 0;
+    while(pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if(end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string range = list.substr(pos, end - pos);
+        if(range.find_first_not_of(" \n") != std::string::npos) {
+            const size_t dash = range.find('-');
+            const unsigned int first = std::stoul(range.substr(0, dash));
+            const unsigned int last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+            if(last < first) {
+                throw std::runtime_error("Invalid CPU list '" + list + "'");
+            }
+            for(unsigned int c = first; c <= last; c++) {
+                cpus.push_back(c);
+            }
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+//! Format CPUs as a compact list in the sysfs style
+inline std::string formatCPUList(std::vector<unsigned int> cpus)
+{
+    std::sort(cpus.begin(), cpus.end());
+    std::string list;
+    for(size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+            j++;
+        }
+        list += (list.empty() ? "" : ",") + std::to_string(cpus[i]);
+        if(j > i) {
+            list += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return list;
+}
+
+//! First line of a sysfs file, or an empty string if it does not exist
+inline std::string readSysfsLine(const std::string &filename)
+{
+    std::ifstream file(filename);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+//! Physical cores this process may run on, grouped by NUMA node and in
+//! ascending order of their first logical CPU. Machines without NUMA
+//! information in sysfs are treated as a single node 0
+inline std::vector<PhysicalCore> getPhysicalCores()
+{
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+        throw std::runtime_error("Cannot read CPU affinity");
+    }
+
+    // Node of each CPU, from the per-node CPU lists
+    std::map<unsigned int, unsigned int> cpuNodes;
+    const std::string possibleNodes = readSysfsLine("/sys/devices/system/node/possible");
+    for(unsigned int n : parseCPUList(possibleNodes)) {
+        for(unsigned int c : parseCPUList(readSysfsLine("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist"))) {
+            cpuNodes[c] = n;
+        }
+    }
+
+    // Group allowed CPUs into physical cores by package and core ID
+    std::map<std::pair<int, int>, PhysicalCore> cores;
+    for(unsigned int c = 0; c < CPU_SETSIZE; c++) {
+        if(!CPU_ISSET(c, &allowed)) {
+            continue;
+        }
+        const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+        const std::string package = readSysfsLine(topology + "physical_package_id");
+        const std::string core = readSysfsLine(topology + "core_id");
+        const std::pair<int, int> key = (package.empty() || core.empty())
+            ? std::make_pair(-1, (int)c) : std::make_pair(std::stoi(package), std::stoi(core));
+
+        PhysicalCore &physical = cores[key];
+        const auto node = cpuNodes.find(c);
+        physical.node = (node == cpuNodes.end()) ? 0 : node->second;
+        physical.cpus.push_back(c);
+    }
+
+    std::vector<PhysicalCore> physicalCores;
+    for(const auto &c : cores) {
+        physicalCores.push_back(c.second);
+    }
+    std::sort(physicalCores.begin(), physicalCores.end(),
+              [](const PhysicalCore &a, const PhysicalCore &b)
+              {
+                  return (a.node == b.node) ? (a.cpus.front() < b.cpus.front()) : (a.node < b.node);
+              });
+    return physicalCores;
+}
+
+//! Add the number of resident pages of [data, data + bytes) on each NUMA
+//! node to pagesPerNode - pages which have never been touched are skipped
+inline void countPageNodes(const void *data, size_t bytes, std::map<int, size_t> &pagesPerNode)
+{
+    const uintptr_t pageSize = (uintptr_t)sysconf(_SC_PAGESIZE);
+    const uintptr_t first = (uintptr_t)data & ~(pageSize - 1);
+    const uintptr_t last = ((uintptr_t)data + bytes + pageSize - 1) & ~(pageSize - 1);
+
+    // With no target nodes, move_pages only reports where each page is
+    constexpr size_t chunkPages = 4096;
+    std::vector<void*> pages;
+    std::vector<int> status(chunkPages);
+    for(uintptr_t chunk = first; chunk < last; chunk += chunkPages * pageSize) {
+        pages.clear();
+        for(uintptr_t p = chunk; p < last && pages.size() < chunkPages; p += pageSize) {
+            pages.push_back((void*)p);
+        }
+        if(syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0) {
+            continue;
+        }
+        for(size_t p = 0; p < pages.size(); p++) {
+            if(status[p] >= 0) {
+                pagesPerNode[status[p]]++;
+            }
+        }
+    }
+}
+}   // namespace BenchUtils
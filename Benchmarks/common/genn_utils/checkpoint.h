@@ -0,0 +1,66 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Benchmark includes
+#include "../cpu/checkpoint.h"
+
+//----------------------------------------------------------------------------
+// GeNN checkpoints
+//----------------------------------------------------------------------------
+// Save and restore the host copies of a GeNN model's variables in the CPU
+// engine's checkpoint format, one named section per array. Pull the state
+// from the device before saving and push it back after restoring.
+namespace BoBRobotics {
+namespace GeNNUtils {
+template<typename T>
+inline void saveArray(CPUEngine::CheckpointWriter &writer, const std::string &name, const T *values, size_t numValues)
+{
+    writer.beginSection(name);
+    writer.write(std::vector<T>(values, values + numValues));
+}
+
+template<typename T>
+inline void restoreArray(CPUEngine::CheckpointReader &reader, const std::string &name, T *values, size_t numValues)
+{
+    reader.beginSection(name);
+    std::vector<T> saved(numValues);
+    reader.read(saved);
+    std::copy(saved.begin(), saved.end(), values);
+}
+
+//! Save the spikes in every slot of a delayed population's queue, starting
+//! from the current slot, so they can be restored under any queue pointer
+inline void saveSpikeQueue(CPUEngine::CheckpointWriter &writer, const std::string &name, unsigned int popSize,
+                           unsigned int numSlots, unsigned int spkQueuePtr, const unsigned int *spkCnt, const unsigned int *spk)
+{
+    writer.beginSection(name);
+    for(unsigned int s = 0; s < numSlots; s++) {
+        const unsigned int slot = (spkQueuePtr + s) % numSlots;
+        writer.write(std::vector<unsigned int>(&spk[slot * popSize], &spk[slot * popSize] + spkCnt[slot]));
+    }
+}
+
+//! Restore a saved spike queue into the slots following the current queue
+//! pointer, e.g. that of a freshly initialised model
+inline void restoreSpikeQueue(CPUEngine::CheckpointReader &reader, const std::string &name, unsigned int popSize,
+                              unsigned int numSlots, unsigned int spkQueuePtr, unsigned int *spkCnt, unsigned int *spk)
+{
+    reader.beginSection(name);
+    std::vector<unsigned int> spikes;
+    for(unsigned int s = 0; s < numSlots; s++) {
+        reader.readResize(spikes);
+        if(spikes.size() > popSize) {
+            throw std::runtime_error("Spike queue '" + name + "' has more spikes than neurons");
+        }
+        const unsigned int slot = (spkQueuePtr + s) % numSlots;
+        spkCnt[slot] = (unsigned int)spikes.size();
+        std::copy(spikes.begin(), spikes.end(), &spk[slot * popSize]);
+    }
+}
+}   // namespace GeNNUtils
+}   // namespace BoBRobotics
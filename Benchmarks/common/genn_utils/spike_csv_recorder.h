@@ -7,10 +7,14 @@
 #include <list>
 #include <vector>
 
+// Benchmark includes
+#include "../neuron_mask.h"
+
 //----------------------------------------------------------------------------
 // BoBRobotics::GeNNUtils::SpikeRecorder
 //----------------------------------------------------------------------------
-// Interface for spike recorders
+// Interface for spike recorders. Each recorder can be given a mask, so only
+// the spikes of a subset of the population are recorded.
 namespace BoBRobotics {
 namespace GeNNUtils {
 class SpikeRecorder
@@ -32,8 +36,9 @@ public:
 class SpikeCSVRecorder : public SpikeRecorder
 {
 public:
-    SpikeCSVRecorder(const char *filename, const unsigned int *spkCnt, const unsigned int *spk)
-    : m_Stream(filename), m_SpkCnt(spkCnt), m_Spk(spk)
+    SpikeCSVRecorder(const char *filename, const unsigned int *spkCnt, const unsigned int *spk,
+                     const BenchUtils::NeuronMask &mask = BenchUtils::NeuronMask())
+    : m_Stream(filename), m_SpkCnt(spkCnt), m_Spk(spk), m_Mask(mask)
     {
         // Set precision 
         m_Stream.precision(16);
@@ -46,9 +51,11 @@ public:
     //----------------------------------------------------------------------------
     virtual void record(double t) override
     {
-        for(unsigned int i = 0; i < m_SpkCnt[0]; i++)
+        m_Spikes.clear();
+        m_Mask.filter(m_Spk, m_SpkCnt[0], m_Spikes);
+        for(unsigned int spike : m_Spikes)
         {
-            m_Stream << t << "," << m_Spk[i] << std::endl;
+            m_Stream << t << "," << spike << std::endl;
         }
     }
 
@@ -60,6 +67,8 @@ private:
     std::ofstream m_Stream;
     const unsigned int *m_SpkCnt;
     const unsigned int *m_Spk;
+    const BenchUtils::NeuronMask m_Mask;
+    std::vector<unsigned int> m_Spikes;
 };
 
 //----------------------------------------------------------------------------
@@ -68,8 +77,9 @@ private:
 class SpikeCSVRecorderCached : public SpikeRecorder
 {
 public:
-    SpikeCSVRecorderCached(const char *filename,  const unsigned int *spkCnt, const unsigned int *spk)
-    : m_Stream(filename), m_SpkCnt(spkCnt), m_Spk(spk)
+    SpikeCSVRecorderCached(const char *filename,  const unsigned int *spkCnt, const unsigned int *spk,
+                           const BenchUtils::NeuronMask &mask = BenchUtils::NeuronMask())
+    : m_Stream(filename), m_SpkCnt(spkCnt), m_Spk(spk), m_Mask(mask)
     {
         // Set precision
         m_Stream.precision(16);
@@ -96,8 +106,8 @@ public:
         // Reserve vector to hold spikes
         m_Cache.back().second.reserve(m_SpkCnt[0]);
 
-        // Copy spikes into vector
-        std::copy_n(m_Spk, m_SpkCnt[0], std::back_inserter(m_Cache.back().second));
+        // Copy masked spikes into vector
+        m_Mask.filter(m_Spk, m_SpkCnt[0], m_Cache.back().second);
     }
 
     //----------------------------------------------------------------------------
@@ -125,6 +135,7 @@ private:
     std::ofstream m_Stream;
     const unsigned int *m_SpkCnt;
     const unsigned int *m_Spk;
+    const BenchUtils::NeuronMask m_Mask;
 
     std::list<std::pair<double, std::vector<unsigned int>>> m_Cache;
 };
@@ -135,8 +146,9 @@ private:
 class SpikeCSVRecorderDelay : public SpikeRecorder
 {
 public:
-    SpikeCSVRecorderDelay(const char *filename, unsigned int popSize, const unsigned int &spkQueuePtr, const unsigned int *spkCnt, const unsigned int *spk)
-    : m_Stream(filename), m_SpkQueuePtr(spkQueuePtr), m_SpkCnt(spkCnt), m_Spk(spk), m_PopSize(popSize)
+    SpikeCSVRecorderDelay(const char *filename, unsigned int popSize, const unsigned int &spkQueuePtr, const unsigned int *spkCnt, const unsigned int *spk,
+                          const BenchUtils::NeuronMask &mask = BenchUtils::NeuronMask())
+    : m_Stream(filename), m_SpkQueuePtr(spkQueuePtr), m_SpkCnt(spkCnt), m_Spk(spk), m_PopSize(popSize), m_Mask(mask)
     {
         // Set precision
         m_Stream.precision(16);
@@ -148,10 +160,11 @@ public:
     //----------------------------------------------------------------------------
     virtual void record(double t) override
     {
-        const unsigned int *currentSpk = getCurrentSpk();
-        for(unsigned int i = 0; i < getCurrentSpkCnt(); i++)
+        m_Spikes.clear();
+        m_Mask.filter(getCurrentSpk(), getCurrentSpkCnt(), m_Spikes);
+        for(unsigned int spike : m_Spikes)
         {
-            m_Stream << t << "," << currentSpk[i] << std::endl;
+            m_Stream << t << "," << spike << std::endl;
         }
     }
 
@@ -176,6 +189,8 @@ private:
     const unsigned int *m_SpkCnt;
     const unsigned int *m_Spk;
     const unsigned int m_PopSize;
+    const BenchUtils::NeuronMask m_Mask;
+    std::vector<unsigned int> m_Spikes;
 };
 
 
@@ -185,8 +200,9 @@ private:
 class SpikeCSVRecorderDelayCached : public SpikeRecorder
 {
 public:
-    SpikeCSVRecorderDelayCached(const char *filename, unsigned int popSize, const unsigned int &spkQueuePtr, const unsigned int *spkCnt, const unsigned int *spk)
-    : m_Stream(filename), m_SpkQueuePtr(spkQueuePtr), m_SpkCnt(spkCnt), m_Spk(spk), m_PopSize(popSize)
+    SpikeCSVRecorderDelayCached(const char *filename, unsigned int popSize, const unsigned int &spkQueuePtr, const unsigned int *spkCnt, const unsigned int *spk,
+                                const BenchUtils::NeuronMask &mask = BenchUtils::NeuronMask())
+    : m_Stream(filename), m_SpkQueuePtr(spkQueuePtr), m_SpkCnt(spkCnt), m_Spk(spk), m_PopSize(popSize), m_Mask(mask)
     {
         // Set precision
         m_Stream.precision(16);
@@ -212,8 +228,8 @@ public:
         // Reserve vector to hold spikes
         m_Cache.back().second.reserve(m_SpkCnt[0]);
 
-        // Copy spikes into vector
-        std::copy_n(getCurrentSpk(), getCurrentSpkCnt(), std::back_inserter(m_Cache.back().second));
+        // Copy masked spikes into vector
+        m_Mask.filter(getCurrentSpk(), getCurrentSpkCnt(), m_Cache.back().second);
     }
 
     //----------------------------------------------------------------------------
@@ -256,6 +272,7 @@ private:
     const unsigned int *m_SpkCnt;
     const unsigned int *m_Spk;
     const unsigned int m_PopSize;
+    const BenchUtils::NeuronMask m_Mask;
 
     std::list<std::pair<double, std::vector<unsigned int>>> m_Cache;
 };
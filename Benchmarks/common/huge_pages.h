@@ -0,0 +1,339 @@
+#pragma once
+
+// Standard C++ includes
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+#include <cstdio>
+
+// POSIX includes
+#include <sys/mman.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+// Huge page backed arrays
+//----------------------------------------------------------------------------
+// Synapse arrays are far larger than the TLB's reach with 4 kB pages, and
+// propagation reads them in an order set by the spikes, so most rows start
+// with a TLB miss. Arrays of at least one huge page allocated through
+// HugePageAllocator get a mapping of their own, backed by 2 MB pages in one
+// of two ways: transparent huge pages, requested with madvise so they work
+// with the kernel's default "madvise" policy, or the explicit hugetlbfs pool
+// (vm.nr_hugepages). Either falls back to the other and then to 4 kB pages,
+// so printHugePageUsage() reports what was actually obtained.
+namespace BenchUtils {
+//! How large arrays allocated through HugePageAllocator are backed
+enum class HugePageMode
+{
+    Default,        //!< Ordinary heap allocations, left to the kernel's policy
+    Off,            //!< Own mappings with transparent huge pages disabled
+    Transparent,    //!< Transparent huge pages, or hugetlbfs if THP is disabled
+    HugeTLB,        //!< The hugetlbfs pool, or transparent huge pages if it is empty
+};
+
+namespace Detail {
+//----------------------------------------------------------------------------
+// BenchUtils::Detail::HugePages
+//----------------------------------------------------------------------------
+//! Process-wide mode and the mappings made for large arrays
+class HugePages
+{
+public:
+    static HugePages &get()
+    {
+        static HugePages hugePages;
+        return hugePages;
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void setMode(HugePageMode mode){ m_Mode = mode; }
+    HugePageMode getMode() const{ return m_Mode; }
+
+    //! Arrays smaller than this are left to the heap in every mode
+    size_t getMinBytes() const{ return m_HugePageSize; }
+
+    //! New mapping of at least bytes, or nullptr to use the heap
+    void *map(size_t bytes)
+    {
+        const HugePageMode mode = m_Mode;
+        if(mode == HugePageMode::Default) {
+            return nullptr;
+        }
+
+        // hugetlbfs reserves the whole pages when mapping, so failure means the pool is too small
+        if(mode == HugePageMode::HugeTLB || (mode == HugePageMode::Transparent && !m_TransparentAvailable)) {
+            const size_t length = roundUp(bytes, m_HugePageSize);
+            void *data = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if(data != MAP_FAILED) {
+                add(data, length, true);
+                return data;
+            }
+        }
+
+        // Otherwise map a little extra and trim it so the array starts on a huge page boundary
+        const size_t length = roundUp(bytes, m_PageSize);
+        char *raw = (char*)mmap(nullptr, length + m_TransparentPageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(raw == MAP_FAILED) {
+            return nullptr;
+        }
+        char *data = (char*)roundUp((uintptr_t)raw, m_TransparentPageSize);
+        if(data > raw) {
+            munmap(raw, data - raw);
+        }
+        munmap(data + length, (raw + length + m_TransparentPageSize) - (data + length));
+
+        // Advice is given before the pages are touched, so they are faulted in huge
+        madvise(data, length, (mode == HugePageMode::Off) ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+        add(data, length, false);
+        return data;
+    }
+
+    //! Release a mapping made by map() - false if data is not one
+    bool unmap(void *data)
+    {
+        std::lock_guard<std::mutex> lock(m_MappingsMutex);
+        const auto mapping = m_Mappings.find((uintptr_t)data);
+        if(mapping == m_Mappings.end()) {
+            return false;
+        }
+        munmap(data, mapping->second.length);
+        m_Mappings.erase(mapping);
+        return true;
+    }
+
+    //! Granularity of mprotect and madvise on the memory at data
+    size_t getPageSize(const void *data) const
+    {
+        std::lock_guard<std::mutex> lock(m_MappingsMutex);
+        auto mapping = m_Mappings.upper_bound((uintptr_t)data);
+        if(mapping != m_Mappings.begin()) {
+            --mapping;
+            if((uintptr_t)data < mapping->first + mapping->second.length && mapping->second.hugeTLB) {
+                return m_HugePageSize;
+            }
+        }
+        return m_PageSize;
+    }
+
+    //! Total the resident pages of every live mapping by page size
+    void printUsage() const
+    {
+        std::map<uintptr_t, Mapping> mappings;
+        {
+            std::lock_guard<std::mutex> lock(m_MappingsMutex);
+            mappings = m_Mappings;
+        }
+        if(mappings.empty()) {
+            printf("Huge pages (%s): no arrays are in mappings of their own\n", getModeName(m_Mode).c_str());
+            return;
+        }
+
+        // Rss excludes hugetlbfs pages, which are counted separately
+        size_t mappedBytes = 0;
+        size_t smallBytes = 0;
+        size_t transparentBytes = 0;
+        size_t hugeTLBBytes = 0;
+        for(const auto &m : mappings) {
+            mappedBytes += m.second.length;
+        }
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        bool inMapping = false;
+        while(std::getline(smaps, line)) {
+            uintptr_t begin;
+            uintptr_t end;
+            char dash;
+            std::istringstream header(line);
+            if(line.find(':') == std::string::npos || line.find(':') > line.find(' ')) {
+                if(header >> std::hex >> begin >> dash >> end) {
+                    auto mapping = mappings.upper_bound(begin);
+                    inMapping = (mapping != mappings.begin() && begin < (--mapping)->first + mapping->second.length);
+                }
+                continue;
+            }
+            if(!inMapping) {
+                continue;
+            }
+            const size_t colon = line.find(':');
+            const std::string field = line.substr(0, colon);
+            if(field == "Rss") {
+                smallBytes += std::stoull(line.substr(colon + 1)) * 1024;
+            }
+            else if(field == "AnonHugePages") {
+                const size_t bytes = std::stoull(line.substr(colon + 1)) * 1024;
+                smallBytes -= bytes;
+                transparentBytes += bytes;
+            }
+            else if(field == "Private_Hugetlb" || field == "Shared_Hugetlb") {
+                hugeTLBBytes += std::stoull(line.substr(colon + 1)) * 1024;
+            }
+        }
+
+        const double mb = 1024.0 * 1024.0;
+        printf("Huge pages (%s): %zu arrays in %.1f MB, resident %.1f MB in %zu kB transparent huge pages, %.1f MB in %zu kB hugetlbfs pages, %.1f MB in %zu kB pages\n",
+               getModeName(m_Mode).c_str(), mappings.size(), (double)mappedBytes / mb,
+               (double)transparentBytes / mb, m_TransparentPageSize / 1024,
+               (double)hugeTLBBytes / mb, m_HugePageSize / 1024,
+               (double)smallBytes / mb, m_PageSize / 1024);
+    }
+
+    static std::string getModeName(HugePageMode mode)
+    {
+        switch(mode) {
+        case HugePageMode::Off:         return "off";
+        case HugePageMode::Transparent: return "thp";
+        case HugePageMode::HugeTLB:     return "hugetlb";
+        default:                        return "default";
+        }
+    }
+
+private:
+    HugePages()
+    : m_Mode(HugePageMode::Default), m_PageSize((size_t)sysconf(_SC_PAGESIZE)),
+      m_HugePageSize(2 * 1024 * 1024), m_TransparentPageSize(2 * 1024 * 1024)
+    {
+        // Default hugetlbfs page size, as "Hugepagesize: 2048 kB"
+        std::ifstream meminfo("/proc/meminfo");
+        std::string line;
+        while(std::getline(meminfo, line)) {
+            if(line.compare(0, 13, "Hugepagesize:") == 0) {
+                m_HugePageSize = std::stoull(line.substr(13)) * 1024;
+            }
+        }
+
+        // THP is available unless disabled, as "always madvise [never]"
+        std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+        std::string policy;
+        m_TransparentAvailable = (std::getline(enabled, policy) && policy.find("[never]") == std::string::npos);
+
+        std::ifstream pmdSize("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        size_t transparentPageSize;
+        if(pmdSize >> transparentPageSize) {
+            m_TransparentPageSize = transparentPageSize;
+        }
+    }
+
+    struct Mapping
+    {
+        size_t length;
+        bool hugeTLB;
+    };
+
+    void add(void *data, size_t length, bool hugeTLB)
+    {
+        std::lock_guard<std::mutex> lock(m_MappingsMutex);
+        m_Mappings[(uintptr_t)data] = Mapping{length, hugeTLB};
+    }
+
+    static size_t roundUp(size_t value, size_t multiple)
+    {
+        return ((value + multiple - 1) / multiple) * multiple;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    HugePageMode m_Mode;
+    size_t m_PageSize;
+    size_t m_HugePageSize;
+    size_t m_TransparentPageSize;
+    bool m_TransparentAvailable;
+
+    mutable std::mutex m_MappingsMutex;
+    std::map<uintptr_t, Mapping> m_Mappings;
+};
+}   // namespace Detail
+
+//----------------------------------------------------------------------------
+// BenchUtils::HugePageAllocator
+//----------------------------------------------------------------------------
+//! Standard allocator placing arrays of at least one huge page in mappings
+//! of their own, backed as setHugePageMode() says. The mode only affects
+//! allocations made after it is set.
+template<typename T>
+class HugePageAllocator
+{
+public:
+    typedef T value_type;
+
+    HugePageAllocator() = default;
+
+    template<typename U>
+    HugePageAllocator(const HugePageAllocator<U>&)
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    T *allocate(size_t n)
+    {
+        const size_t bytes = n * sizeof(T);
+        if(bytes >= Detail::HugePages::get().getMinBytes()) {
+            void *data = Detail::HugePages::get().map(bytes);
+            if(data != nullptr) {
+                return static_cast<T*>(data);
+            }
+        }
+        return static_cast<T*>(::operator new(bytes));
+    }
+
+    void deallocate(T *data, size_t n)
+    {
+        if(n * sizeof(T) < Detail::HugePages::get().getMinBytes() || !Detail::HugePages::get().unmap(data)) {
+            ::operator delete(data);
+        }
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&){ return true; }
+
+template<typename T, typename U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&){ return false; }
+
+//! Vector whose storage may be backed by huge pages
+template<typename T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Set how large arrays allocated from now on are backed
+inline void setHugePageMode(HugePageMode mode)
+{
+    Detail::HugePages::get().setMode(mode);
+}
+
+//! Parse "off", "thp" or "hugetlb" as given on the command line
+inline HugePageMode parseHugePageMode(const std::string &name)
+{
+    for(HugePageMode mode : {HugePageMode::Off, HugePageMode::Transparent, HugePageMode::HugeTLB}) {
+        if(name == Detail::HugePages::getModeName(mode)) {
+            return mode;
+        }
+    }
+    throw std::runtime_error("Unknown huge page mode '" + name + "' - use off, thp or hugetlb");
+}
+
+//! Granularity of mprotect and madvise on an array's storage
+inline size_t getPageSize(const void *data)
+{
+    return Detail::HugePages::get().getPageSize(data);
+}
+
+//! Report how much of the large arrays' memory is actually in huge pages
+inline void printHugePageUsage()
+{
+    Detail::HugePages::get().printUsage();
+}
+}   // namespace BenchUtils
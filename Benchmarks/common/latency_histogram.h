@@ -0,0 +1,157 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+//----------------------------------------------------------------------------
+// BenchUtils::LatencyHistogram
+//----------------------------------------------------------------------------
+//! Histogram of durations in nanoseconds with logarithmically sized buckets,
+//! as in HdrHistogram: each power of two is split into 32 linear sub-buckets,
+//! so any duration up to 2^64 ns is recorded in constant time, in 15 kB,
+//! with a relative error of at most 1/32. Used to time every step of a
+//! simulation, where the tail - a recording flush or a burst of plasticity -
+//! matters as much as the mean for closed-loop use.
+namespace BenchUtils {
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+    : m_Counts(s_NumBuckets, 0), m_Count(0), m_Total(0), m_Min(std::numeric_limits<uint64_t>::max()), m_Max(0)
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void record(uint64_t nanoseconds)
+    {
+        m_Counts[getBucket(nanoseconds)]++;
+        m_Count++;
+        m_Total += nanoseconds;
+        m_Min = std::min(m_Min, nanoseconds);
+        m_Max = std::max(m_Max, nanoseconds);
+    }
+
+    //! Add another histogram's durations, e.g. one recorded by another thread
+    void merge(const LatencyHistogram &other)
+    {
+        for(size_t b = 0; b < s_NumBuckets; b++) {
+            m_Counts[b] += other.m_Counts[b];
+        }
+        m_Count += other.m_Count;
+        m_Total += other.m_Total;
+        m_Min = std::min(m_Min, other.m_Min);
+        m_Max = std::max(m_Max, other.m_Max);
+    }
+
+    void reset()
+    {
+        std::fill(m_Counts.begin(), m_Counts.end(), 0);
+        m_Count = 0;
+        m_Total = 0;
+        m_Min = std::numeric_limits<uint64_t>::max();
+        m_Max = 0;
+    }
+
+    //! Duration which fraction (0 to 1) of the recorded durations do not
+    //! exceed, as the upper end of its bucket but never more than the maximum
+    uint64_t getPercentile(double fraction) const
+    {
+        if(m_Count == 0) {
+            return 0;
+        }
+        const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(fraction * (double)m_Count));
+        uint64_t cumulative = 0;
+        for(size_t b = 0; b < s_NumBuckets; b++) {
+            cumulative += m_Counts[b];
+            if(cumulative >= rank) {
+                return std::min(getBucketUpper(b), m_Max);
+            }
+        }
+        return m_Max;
+    }
+
+    //! Durations longer than nanoseconds, to the resolution of the buckets
+    uint64_t getCountAbove(uint64_t nanoseconds) const
+    {
+        uint64_t count = 0;
+        for(size_t b = getBucket(nanoseconds) + 1; b < s_NumBuckets; b++) {
+            count += m_Counts[b];
+        }
+        return count;
+    }
+
+    uint64_t getCount() const{ return m_Count; }
+    uint64_t getTotal() const{ return m_Total; }
+    uint64_t getMin() const{ return (m_Count == 0) ? 0 : m_Min; }
+    uint64_t getMax() const{ return m_Max; }
+    double getMean() const{ return (m_Count == 0) ? 0.0 : (double)m_Total / (double)m_Count; }
+
+    //! Print the percentiles of step latency in microseconds and the real-time
+    //! factor - simulated time over the wall time of the recorded steps
+    void printSteps(const std::string &title, double timestepMs) const
+    {
+        const uint64_t timestepNs = (uint64_t)std::llround(timestepMs * 1.0E6);
+        const double wallSeconds = (double)m_Total / 1.0E9;
+        const double simulatedSeconds = (double)m_Count * timestepMs / 1000.0;
+        printf("%s latency over %llu steps (us): p50 %.2f, p99 %.2f, p99.9 %.2f, max %.2f, mean %.2f\n",
+               title.c_str(), (unsigned long long)m_Count, (double)getPercentile(0.5) / 1000.0,
+               (double)getPercentile(0.99) / 1000.0, (double)getPercentile(0.999) / 1000.0,
+               (double)m_Max / 1000.0, getMean() / 1000.0);
+        printf("Real-time factor %.3g against the %g ms timestep, %llu steps (%.2f%%) took longer than it\n",
+               (wallSeconds > 0.0) ? simulatedSeconds / wallSeconds : 0.0, timestepMs,
+               (unsigned long long)getCountAbove(timestepNs),
+               (m_Count > 0) ? 100.0 * (double)getCountAbove(timestepNs) / (double)m_Count : 0.0);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private static methods
+    //------------------------------------------------------------------------
+    //! Durations below 32 ns get a bucket each. Above, the bucket is the
+    //! power of two and the top five bits below the leading one.
+    static size_t getBucket(uint64_t value)
+    {
+        if(value < s_SubBuckets) {
+            return (size_t)value;
+        }
+        const unsigned int exponent = 63 - (unsigned int)__builtin_clzll(value);
+        const unsigned int shift = exponent - s_SubBucketBits;
+        return (size_t)(shift + 1) * s_SubBuckets + (size_t)((value >> shift) - s_SubBuckets);
+    }
+
+    static uint64_t getBucketUpper(size_t bucket)
+    {
+        if(bucket < s_SubBuckets) {
+            return bucket;
+        }
+        const unsigned int shift = (unsigned int)(bucket / s_SubBuckets) - 1;
+        const uint64_t lower = (uint64_t)(s_SubBuckets + (bucket % s_SubBuckets)) << shift;
+        return lower + ((1ull << shift) - 1);
+    }
+
+    //------------------------------------------------------------------------
+    // Static constants
+    //------------------------------------------------------------------------
+    static constexpr unsigned int s_SubBucketBits = 5;
+    static constexpr uint64_t s_SubBuckets = 1ull << s_SubBucketBits;
+    static constexpr size_t s_NumBuckets = (64 - s_SubBucketBits + 1) * s_SubBuckets;
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<uint64_t> m_Counts;
+    uint64_t m_Count;
+    uint64_t m_Total;
+    uint64_t m_Min;
+    uint64_t m_Max;
+};
+}   // namespace BenchUtils
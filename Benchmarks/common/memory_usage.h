@@ -0,0 +1,67 @@
+#pragma once
+
+// Standard C++ includes
+#include <fstream>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+// BenchUtils
+//----------------------------------------------------------------------------
+namespace BenchUtils {
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Read a "Field: N kB" line from a /proc file, returned in bytes (0 if unavailable)
+inline size_t getProcFieldBytes(const std::string &filename, const std::string &field)
+{
+    std::ifstream status(filename);
+    std::string line;
+    while(std::getline(status, line)) {
+        if(line.compare(0, field.size(), field) == 0 && line.size() > field.size() && line[field.size()] == ':') {
+            return std::stoull(line.substr(field.size() + 1)) * 1024;
+        }
+    }
+    return 0;
+}
+
+//! Read a kB field such as "VmRSS" from /proc/self/status, returned in bytes (0 if unavailable)
+inline size_t getProcStatusBytes(const std::string &field)
+{
+    return getProcFieldBytes("/proc/self/status", field);
+}
+
+//! Current resident set size in bytes
+inline size_t getRSS()
+{
+    return getProcStatusBytes("VmRSS");
+}
+
+//! High-water mark of the resident set size in bytes
+inline size_t getPeakRSS()
+{
+    return getProcStatusBytes("VmHWM");
+}
+
+//! Proportional set size of a process in bytes - its private pages plus its
+//! share of pages shared with other processes, so the PSS of processes forked
+//! from one parent sum to their true combined footprint (needs Linux 4.14+)
+inline size_t getPSS(const std::string &pid = "self")
+{
+    return getProcFieldBytes("/proc/" + pid + "/smaps_rollup", "Pss");
+}
+
+//! Bytes of a process's resident pages which no other process maps
+inline size_t getPrivateBytes(const std::string &pid = "self")
+{
+    return getProcFieldBytes("/proc/" + pid + "/smaps_rollup", "Private_Clean")
+        + getProcFieldBytes("/proc/" + pid + "/smaps_rollup", "Private_Dirty");
+}
+
+//! Print current and peak resident set size with a label
+inline void printMemoryUsage(const std::string &title)
+{
+    std::cout << title << " RSS: " << (double)getRSS() / (1024.0 * 1024.0)
+              << " MB, peak RSS: " << (double)getPeakRSS() / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+}   // namespace BenchUtils
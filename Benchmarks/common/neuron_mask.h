@@ -0,0 +1,243 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX512F__)
+    #include <immintrin.h>
+#endif
+
+//----------------------------------------------------------------------------
+// BenchUtils::NeuronMask
+//----------------------------------------------------------------------------
+//! Which neurons of a population to record, so recorded runs of different
+//! simulators monitor the same subset (Auryn records the first 50 neurons of
+//! Brunel's populations) and recording costs scale with the subset. Each
+//! step's spike list is filtered through a byte per neuron before it is
+//! buffered - with AVX-512, 16 spikes at a time by a gather and a compress.
+namespace BenchUtils {
+class NeuronMask
+{
+public:
+    //! Every neuron
+    NeuronMask() : m_All(true), m_NumNeurons(0), m_NumSelected(0)
+    {}
+
+    //! Mask of a population of numNeurons, given by spec:
+    //!   all                       every neuron
+    //!   none                      no neuron
+    //!   first:COUNT               the first COUNT neurons, or every neuron if there are fewer
+    //!   COUNT                     shorthand for first:COUNT
+    //!   range:BEGIN:END[:STRIDE]  BEGIN, BEGIN + STRIDE, ... below END
+    //!   stride:STRIDE             every STRIDE-th neuron from 0
+    //!   list:ID,ID,...            the listed neurons
+    //!   random:COUNT[:SEED]       COUNT neurons drawn without replacement (seed 42 by default)
+    NeuronMask(const std::string &spec, unsigned int numNeurons)
+    : m_All(spec == "all"), m_NumNeurons(numNeurons), m_NumSelected(numNeurons)
+    {
+        if(m_All) {
+            return;
+        }
+
+        // Padded so the SIMD filter can load 32 bits at any neuron's byte
+        m_Selected.assign(numNeurons + 3, 0);
+        m_NumSelected = 0;
+
+        const bool count = !spec.empty() && spec[0] >= '0' && spec[0] <= '9';
+        const size_t colon = count ? std::string::npos : spec.find(':');
+        const std::string kind = count ? "first" : spec.substr(0, colon);
+        const std::vector<unsigned long> args = count ? parseNumbers(spec, ':', spec)
+            : (colon == std::string::npos) ? std::vector<unsigned long>()
+            : parseNumbers(spec.substr(colon + 1), (kind == "list") ? ',' : ':', spec);
+        if(kind == "none" && args.empty()) {
+            return;
+        }
+        else if(kind == "first" && args.size() == 1) {
+            for(unsigned long i = 0; i < std::min<unsigned long>(args[0], numNeurons); i++) {
+                select((unsigned int)i);
+            }
+        }
+        else if((kind == "range" && (args.size() == 2 || args.size() == 3)) || (kind == "stride" && args.size() == 1)) {
+            const unsigned long begin = (kind == "range") ? args[0] : 0;
+            const unsigned long end = (kind == "range") ? args[1] : numNeurons;
+            const unsigned long stride = (kind == "stride") ? args[0] : ((args.size() == 3) ? args[2] : 1);
+            if(stride == 0 || begin > end || end > numNeurons) {
+                throw getMismatchError(spec);
+            }
+            for(unsigned long i = begin; i < end; i += stride) {
+                select((unsigned int)i);
+            }
+        }
+        else if(kind == "list" && !args.empty()) {
+            for(unsigned long i : args) {
+                if(i >= numNeurons) {
+                    throw getMismatchError(spec);
+                }
+                select((unsigned int)i);
+            }
+        }
+        else if(kind == "random" && (args.size() == 1 || args.size() == 2)) {
+            if(args[0] > numNeurons) {
+                throw getMismatchError(spec);
+            }
+
+            // Selection sampling, so the same seed picks the same neurons with any standard library
+            std::mt19937 rng((args.size() == 2) ? (uint32_t)args[1] : 42);
+            unsigned long remaining = args[0];
+            for(unsigned int i = 0; i < numNeurons && remaining > 0; i++) {
+                const double u = ((double)rng() + 0.5) / 4294967296.0;
+                if((double)(numNeurons - i) * u < (double)remaining) {
+                    select(i);
+                    remaining--;
+                }
+            }
+        }
+        else {
+            throw std::runtime_error("Invalid neuron mask '" + spec + "'");
+        }
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    bool isAll() const{ return m_All; }
+
+    //! Neurons selected - zero for the default mask, which does not know the population's size
+    unsigned int getNumSelected() const{ return m_NumSelected; }
+
+    bool contains(unsigned int i) const{ return m_All || (i < m_NumNeurons && m_Selected[i] != 0); }
+
+    std::vector<unsigned int> getSelected() const
+    {
+        std::vector<unsigned int> selected;
+        selected.reserve(m_NumSelected);
+        for(unsigned int i = 0; i < m_NumNeurons; i++) {
+            if(contains(i)) {
+                selected.push_back(i);
+            }
+        }
+        return selected;
+    }
+
+    //! Append the neurons of spikes[0, n) which the mask selects to out, in order
+    void filter(const unsigned int *spikes, size_t n, std::vector<unsigned int> &out) const
+    {
+        const size_t start = out.size();
+        if(m_All) {
+            out.insert(out.end(), spikes, spikes + n);
+            return;
+        }
+
+        out.resize(start + n);
+        unsigned int *selected = out.data() + start;
+        size_t numSelected = 0;
+#if defined(__AVX512F__)
+        const __m512i lowByte = _mm512_set1_epi32(0xFF);
+        for(size_t s = 0; s < n; s += 16) {
+            const __mmask16 mask = (n - s >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - s)) - 1u);
+            const __m512i i = _mm512_maskz_loadu_epi32(mask, spikes + s);
+            const __m512i bytes = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), mask, i, m_Selected.data(), 1);
+            const __mmask16 keep = _mm512_mask_test_epi32_mask(mask, bytes, lowByte);
+            _mm512_mask_compressstoreu_epi32(selected + numSelected, keep, i);
+            numSelected += (size_t)__builtin_popcount(keep);
+        }
+#else
+        // Branchless - every spike is written and only the selected ones are kept
+        for(size_t s = 0; s < n; s++) {
+            const unsigned int i = spikes[s];
+            selected[numSelected] = i;
+            numSelected += m_Selected[i];
+        }
+#endif
+        out.resize(start + numSelected);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void select(unsigned int i)
+    {
+        m_NumSelected += (m_Selected[i] == 0) ? 1 : 0;
+        m_Selected[i] = 1;
+    }
+
+    std::runtime_error getMismatchError(const std::string &spec) const
+    {
+        return std::runtime_error("Neuron mask '" + spec + "' does not fit a population of " + std::to_string(m_NumNeurons));
+    }
+
+    static std::vector<unsigned long> parseNumbers(const std::string &numbers, char separator, const std::string &spec)
+    {
+        std::vector<unsigned long> values;
+        std::istringstream stream(numbers);
+        std::string token;
+        while(std::getline(stream, token, separator)) {
+            size_t end = 0;
+            try {
+                values.push_back(std::stoul(token, &end));
+            }
+            catch(const std::exception&) {
+            }
+            if(end == 0 || end != token.size()) {
+                throw std::runtime_error("Invalid neuron mask '" + spec + "'");
+            }
+        }
+        return values;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    bool m_All;
+    unsigned int m_NumNeurons;
+    unsigned int m_NumSelected;
+    std::vector<uint8_t> m_Selected;
+};
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Add a "POPULATION=SPEC" argument, as given to --record_mask, to masks
+inline void addPopulationMask(const std::string &arg, std::map<std::string, std::string> &masks)
+{
+    const size_t equals = arg.find('=');
+    if(equals == 0 || equals == std::string::npos) {
+        throw std::runtime_error("Expected POPULATION=MASK rather than '" + arg + "'");
+    }
+    masks[arg.substr(0, equals)] = arg.substr(equals + 1);
+}
+
+//! The mask given for population, if any, or else every neuron
+inline NeuronMask getPopulationMask(const std::map<std::string, std::string> &masks, const std::string &population,
+                                    unsigned int numNeurons)
+{
+    const auto mask = masks.find(population);
+    return NeuronMask((mask == masks.end()) ? "all" : mask->second, numNeurons);
+}
+
+//! Check every mask is for one of populations, so a misspelt name is not silently ignored
+inline void checkPopulationMasks(const std::map<std::string, std::string> &masks, const std::vector<std::string> &populations)
+{
+    for(const auto &m : masks) {
+        bool found = false;
+        for(const auto &p : populations) {
+            found = found || (p == m.first);
+        }
+        if(!found) {
+            throw std::runtime_error("No population called '" + m.first + "' to mask");
+        }
+    }
+}
+}   // namespace BenchUtils
@@ -0,0 +1,82 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Shared includes
+#include "wmat_loader.h"
+
+//----------------------------------------------------------------------------
+// BenchUtils
+//----------------------------------------------------------------------------
+namespace BenchUtils {
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Run load(filename) for every file on a small pool of threads. Results are returned
+//! in the same order as filenames so registration with a model stays deterministic.
+//! If any load throws, the exception of the first failing file is rethrown after all
+//! threads have joined. numThreads = 0 uses one thread per file, up to the core count.
+template<typename T, typename Load>
+std::vector<T> loadConcurrently(const std::vector<std::string> &filenames, Load load, unsigned int numThreads = 0)
+{
+    const size_t numFiles = filenames.size();
+    if(numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = (unsigned int)std::min<size_t>(numThreads, numFiles);
+
+    std::vector<T> results(numFiles);
+    std::vector<std::exception_ptr> errors(numFiles);
+    std::atomic<size_t> next(0);
+
+    // Each worker pulls the next unclaimed file until none are left
+    auto worker =
+        [&]()
+        {
+            for(size_t f = next++; f < numFiles; f = next++) {
+                try {
+                    results[f] = load(filenames[f]);
+                }
+                catch(...) {
+                    errors[f] = std::current_exception();
+                }
+            }
+        };
+
+    std::vector<std::thread> threads;
+    for(unsigned int t = 1; t < numThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(auto &t : threads) {
+        t.join();
+    }
+
+    for(const auto &e : errors) {
+        if(e) {
+            std::rethrow_exception(e);
+        }
+    }
+    return results;
+}
+
+//! Load several .wmat files concurrently in CSR form
+inline std::vector<CSRConnectivity> loadWmatCSRConcurrently(const std::vector<std::string> &filenames,
+                                                            unsigned int numThreads = 0)
+{
+    return loadConcurrently<CSRConnectivity>(filenames, &loadWmatCSR, numThreads);
+}
+
+//! Load several .wmat files concurrently as pairwise lists
+inline std::vector<PairwiseConnectivity> loadWmatPairwiseConcurrently(const std::vector<std::string> &filenames,
+                                                                      unsigned int numThreads = 0)
+{
+    return loadConcurrently<PairwiseConnectivity>(filenames, &loadWmatPairwise, numThreads);
+}
+}   // namespace BenchUtils
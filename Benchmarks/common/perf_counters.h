@@ -0,0 +1,450 @@
+#pragma once
+
+// Standard C++ includes
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// POSIX includes
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Linux includes
+#include <linux/perf_event.h>
+
+// Shared includes
+#include "cpu_topology.h"
+
+//----------------------------------------------------------------------------
+// Hardware performance counters
+//----------------------------------------------------------------------------
+// Counts cycles, instructions, last level cache misses, dTLB load misses and
+// branch misses in user space on every thread of the process, with one
+// perf_event_open group per thread so the counts of each thread are
+// consistent with each other. Threads must exist when start() is called -
+// the CPU engine's workers are created by partition(). Memory bandwidth is
+// read from the integrated memory controllers' uncore counters where the
+// kernel exposes them and perf_event_paranoid allows system-wide counting.
+// Counters which cannot be opened, as is common in containers and VMs, are
+// reported as unavailable rather than failing the run.
+namespace BenchUtils {
+class PerfCounters
+{
+public:
+    enum Event
+    {
+        EVENT_CYCLES,
+        EVENT_INSTRUCTIONS,
+        EVENT_LLC_MISSES,
+        EVENT_DTLB_MISSES,
+        EVENT_BRANCH_MISSES,
+        EVENT_MAX,
+    };
+
+    PerfCounters() : m_Running(false), m_MemoryBytes(0.0), m_HaveMemoryBytes(false)
+    {
+        clear();
+    }
+
+    ~PerfCounters()
+    {
+        close();
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Open and enable the counters on every current thread of the process
+    void start()
+    {
+        close();
+        clear();
+
+        for(pid_t tid : getThreadIDs()) {
+            ThreadGroup group;
+            group.tid = tid;
+            group.cycles = 0.0;
+            for(unsigned int e = 0; e < EVENT_MAX; e++) {
+                perf_event_attr attr = getAttr((Event)e);
+                const int leader = group.fds.empty() ? -1 : group.fds[0];
+                const int fd = openEvent(attr, tid, -1, leader);
+                if(fd < 0) {
+                    if(m_Error.empty()) {
+                        m_Error = std::string(getEventName((Event)e)) + ": " + strerror(errno);
+                    }
+                    continue;
+                }
+                group.fds.push_back(fd);
+                group.events.push_back((Event)e);
+            }
+            if(!group.fds.empty()) {
+                m_Groups.push_back(group);
+            }
+        }
+        openMemoryControllers();
+
+        for(const auto &g : m_Groups) {
+            ioctl(g.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(g.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+        for(const auto &m : m_MemoryCounters) {
+            ioctl(m.fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m.fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        m_Running = true;
+    }
+
+    //! Disable the counters and total them over the threads
+    void stop()
+    {
+        if(!m_Running) {
+            return;
+        }
+        for(const auto &g : m_Groups) {
+            ioctl(g.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        }
+        for(const auto &m : m_MemoryCounters) {
+            ioctl(m.fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        m_Running = false;
+
+        // Group reads are { nr, time_enabled, time_running, value[nr] }. Counts are
+        // scaled up if the group was multiplexed and zero if it never ran.
+        for(auto &g : m_Groups) {
+            std::vector<uint64_t> data(3 + g.fds.size());
+            if(read(g.fds[0], data.data(), data.size() * sizeof(uint64_t)) < (ssize_t)(3 * sizeof(uint64_t)) || data[2] == 0) {
+                continue;
+            }
+            const double scale = (double)data[1] / (double)data[2];
+            for(size_t i = 0; i < g.fds.size(); i++) {
+                const double count = (double)data[3 + i] * scale;
+                m_Counts[g.events[i]] += count;
+                m_Available[g.events[i]] = true;
+                if(g.events[i] == EVENT_CYCLES) {
+                    g.cycles = count;
+                }
+            }
+        }
+        for(const auto &m : m_MemoryCounters) {
+            uint64_t count;
+            if(read(m.fd, &count, sizeof(count)) == sizeof(count)) {
+                m_MemoryBytes += (double)count * m.bytesPerCount;
+                m_HaveMemoryBytes = true;
+            }
+        }
+    }
+
+    bool isAvailable(Event event) const{ return m_Available[event]; }
+    double getCount(Event event) const{ return m_Counts[event]; }
+
+    //! Bytes read and written by the memory controllers, if they could be counted
+    bool isMemoryTrafficAvailable() const{ return m_HaveMemoryBytes; }
+    double getMemoryBytes() const{ return m_MemoryBytes; }
+
+    //! Replace the totals with ones combined elsewhere, e.g. summed over the
+    //! ranks of an MPI run, so write() reports them instead
+    void setTotals(const double *counts, const bool *available, double memoryBytes, bool haveMemoryBytes)
+    {
+        for(unsigned int e = 0; e < EVENT_MAX; e++) {
+            m_Counts[e] = counts[e];
+            m_Available[e] = available[e];
+        }
+        m_MemoryBytes = memoryBytes;
+        m_HaveMemoryBytes = haveMemoryBytes;
+    }
+
+    //! Print the totals and metrics derived from them over seconds of
+    //! simulation which delivered synapticEvents
+    void print(double seconds, uint64_t synapticEvents) const
+    {
+        if(m_Groups.empty()) {
+            printf("Hardware counters unavailable (%s)\n", m_Error.empty() ? "no threads" : m_Error.c_str());
+            return;
+        }
+        printf("Hardware counters on %zu threads:", m_Groups.size());
+        for(unsigned int e = 0; e < EVENT_MAX; e++) {
+            if(m_Available[e]) {
+                printf(" %.4g %s,", m_Counts[e], getEventName((Event)e));
+            }
+            else {
+                printf(" %s unavailable,", getEventName((Event)e));
+            }
+        }
+        if(m_HaveMemoryBytes) {
+            printf(" %.2f GB/s memory bandwidth\n", m_MemoryBytes / (1.0E9 * seconds));
+        }
+        else {
+            printf(" memory bandwidth unavailable\n");
+        }
+
+        for(const auto &m : getDerivedMetrics(seconds, synapticEvents)) {
+            printf("  %s: %.4g\n", m.first.c_str(), m.second);
+        }
+
+        // Cycles per thread show how evenly a threaded run kept its cores busy
+        if(m_Groups.size() > 1 && m_Available[EVENT_CYCLES]) {
+            printf("  cycles by thread:");
+            for(const auto &g : m_Groups) {
+                printf(" %d=%.4g", (int)g.tid, g.cycles);
+            }
+            printf("\n");
+        }
+    }
+
+    //! Write the totals and derived metrics as a header line and a line of
+    //! values - unavailable counters are left empty
+    void write(const std::string &filename, double seconds, uint64_t synapticEvents) const
+    {
+        std::ostringstream header;
+        std::ostringstream values;
+        values << std::setprecision(10);
+        for(unsigned int e = 0; e < EVENT_MAX; e++) {
+            header << getEventName((Event)e) << ",";
+            if(m_Available[e]) {
+                values << m_Counts[e];
+            }
+            values << ",";
+        }
+        header << "memory_bytes";
+        if(m_HaveMemoryBytes) {
+            values << m_MemoryBytes;
+        }
+        for(const auto &m : getDerivedMetrics(seconds, synapticEvents)) {
+            header << "," << m.first;
+            values << "," << m.second;
+        }
+
+        std::ofstream file(filename);
+        file << header.str() << std::endl << values.str() << std::endl;
+    }
+
+    static const char *getEventName(Event event)
+    {
+        static const char *names[EVENT_MAX] = {"cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses"};
+        return names[event];
+    }
+
+private:
+    struct ThreadGroup
+    {
+        pid_t tid;
+        std::vector<int> fds;
+        std::vector<Event> events;
+        double cycles;
+    };
+
+    struct MemoryCounter
+    {
+        int fd;
+        double bytesPerCount;
+    };
+
+    void clear()
+    {
+        for(unsigned int e = 0; e < EVENT_MAX; e++) {
+            m_Counts[e] = 0.0;
+            m_Available[e] = false;
+        }
+        m_MemoryBytes = 0.0;
+        m_HaveMemoryBytes = false;
+        m_Error.clear();
+    }
+
+    void close()
+    {
+        for(const auto &g : m_Groups) {
+            for(int fd : g.fds) {
+                ::close(fd);
+            }
+        }
+        for(const auto &m : m_MemoryCounters) {
+            ::close(m.fd);
+        }
+        m_Groups.clear();
+        m_MemoryCounters.clear();
+        m_Running = false;
+    }
+
+    //! Metrics which are only meaningful if the counts they use are available
+    std::vector<std::pair<std::string, double>> getDerivedMetrics(double seconds, uint64_t synapticEvents) const
+    {
+        std::vector<std::pair<std::string, double>> metrics;
+        const double instructions = m_Counts[EVENT_INSTRUCTIONS];
+        if(m_Available[EVENT_CYCLES] && m_Available[EVENT_INSTRUCTIONS] && m_Counts[EVENT_CYCLES] > 0.0) {
+            metrics.emplace_back("instructions_per_cycle", instructions / m_Counts[EVENT_CYCLES]);
+        }
+        if(synapticEvents > 0) {
+            for(Event e : {EVENT_CYCLES, EVENT_INSTRUCTIONS, EVENT_LLC_MISSES, EVENT_DTLB_MISSES}) {
+                if(m_Available[e]) {
+                    metrics.emplace_back(std::string(getEventName(e)) + "_per_synaptic_event", m_Counts[e] / (double)synapticEvents);
+                }
+            }
+            if(m_HaveMemoryBytes) {
+                metrics.emplace_back("memory_bytes_per_synaptic_event", m_MemoryBytes / (double)synapticEvents);
+            }
+        }
+        if(m_Available[EVENT_LLC_MISSES] && instructions > 0.0) {
+            metrics.emplace_back("llc_misses_per_kilo_instruction", 1000.0 * m_Counts[EVENT_LLC_MISSES] / instructions);
+        }
+        if(m_HaveMemoryBytes && seconds > 0.0) {
+            metrics.emplace_back("memory_bandwidth_gbps", m_MemoryBytes / (1.0E9 * seconds));
+        }
+        return metrics;
+    }
+
+    static perf_event_attr getAttr(Event event)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        switch(event) {
+        case EVENT_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case EVENT_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case EVENT_LLC_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case EVENT_DTLB_MISSES:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        default:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        }
+        return attr;
+    }
+
+    static int openEvent(perf_event_attr &attr, pid_t pid, int cpu, int groupFD)
+    {
+        return (int)syscall(__NR_perf_event_open, &attr, pid, cpu, groupFD, 0);
+    }
+
+    static std::vector<pid_t> getThreadIDs()
+    {
+        std::vector<pid_t> tids;
+        DIR *tasks = opendir("/proc/self/task");
+        if(tasks != nullptr) {
+            while(dirent *entry = readdir(tasks)) {
+                if(entry->d_name[0] != '.') {
+                    tids.push_back((pid_t)atoi(entry->d_name));
+                }
+            }
+            closedir(tasks);
+        }
+        return tids;
+    }
+
+    //! Encode a sysfs event such as "event=0x04,umask=0x03" into a config
+    //! using the PMU's format descriptions such as "config:0-7"
+    static bool parseEventConfig(const std::string &pmu, const std::string &event, __u64 &config)
+    {
+        config = 0;
+        std::istringstream terms(event);
+        std::string term;
+        while(std::getline(terms, term, ',')) {
+            const size_t equals = term.find('=');
+            const std::string name = term.substr(0, equals);
+            const uint64_t value = (equals == std::string::npos) ? 1 : std::stoull(term.substr(equals + 1), nullptr, 0);
+
+            const std::string format = readSysfsLine(pmu + "/format/" + name);
+            if(format.compare(0, 7, "config:") != 0) {
+                return false;
+            }
+            const std::string bits = format.substr(7);
+            const size_t dash = bits.find('-');
+            const unsigned int low = (unsigned int)std::stoul(bits.substr(0, dash));
+            config |= value << low;
+        }
+        return true;
+    }
+
+    //! System-wide CAS counts on every memory controller, one CPU each
+    void openMemoryControllers()
+    {
+        const std::string devices = "/sys/bus/event_source/devices";
+        DIR *dir = opendir(devices.c_str());
+        if(dir == nullptr) {
+            return;
+        }
+        while(dirent *entry = readdir(dir)) {
+            if(strncmp(entry->d_name, "uncore_imc", 10) != 0) {
+                continue;
+            }
+            const std::string pmu = devices + "/" + entry->d_name;
+            const std::string type = readSysfsLine(pmu + "/type");
+            const std::string cpus = readSysfsLine(pmu + "/cpumask");
+            if(type.empty() || cpus.empty()) {
+                continue;
+            }
+            for(const char *name : {"cas_count_read", "cas_count_write"}) {
+                const std::string event = readSysfsLine(pmu + "/events/" + name);
+                const std::string scale = readSysfsLine(pmu + "/events/" + name + ".scale");
+                const std::string unit = readSysfsLine(pmu + "/events/" + name + ".unit");
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.disabled = 1;
+                attr.type = (uint32_t)std::stoul(type);
+                if(event.empty() || !parseEventConfig(pmu, event, attr.config)) {
+                    continue;
+                }
+
+                // The scale converts counts to the unit, usually MiB of 64 byte lines
+                double bytesPerCount = scale.empty() ? 64.0 : std::stod(scale);
+                if(unit == "MiB") {
+                    bytesPerCount *= 1024.0 * 1024.0;
+                }
+
+                // Each socket's controllers are counted on one of its CPUs
+                for(unsigned int cpu : parseCPUList(cpus)) {
+                    const int fd = openEvent(attr, -1, (int)cpu, -1);
+                    if(fd >= 0) {
+                        m_MemoryCounters.push_back(MemoryCounter{fd, bytesPerCount});
+                    }
+                }
+            }
+        }
+        closedir(dir);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    std::vector<ThreadGroup> m_Groups;
+    std::vector<MemoryCounter> m_MemoryCounters;
+    bool m_Running;
+    std::string m_Error;
+
+    double m_Counts[EVENT_MAX];
+    bool m_Available[EVENT_MAX];
+    double m_MemoryBytes;
+    bool m_HaveMemoryBytes;
+};
+}   // namespace BenchUtils
@@ -0,0 +1,182 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// POSIX includes
+#include <sys/mman.h>
+
+//----------------------------------------------------------------------------
+// BenchUtils::SetupArena
+//----------------------------------------------------------------------------
+//! Bump allocator for objects and scratch arrays which are only needed while
+//! a model is built. Blocks are mapped straight from the kernel rather than
+//! taken from the heap, so building a model does not leave the heap
+//! fragmented, or raise glibc's mmap threshold by freeing large buffers,
+//! just before the simulator makes its own large allocations. Nothing is
+//! freed individually: release() destroys every object, in reverse order of
+//! construction, and unmaps every block in one go.
+namespace BenchUtils {
+class SetupArena
+{
+public:
+    SetupArena(size_t blockBytes = 1024 * 1024)
+    : m_BlockBytes(blockBytes), m_Top(nullptr), m_End(nullptr),
+      m_NumAllocations(0), m_NumBytes(0), m_NumObjects(0), m_NumBlocks(0), m_MappedBytes(0)
+    {}
+
+    ~SetupArena()
+    {
+        release();
+    }
+
+    SetupArena(const SetupArena&) = delete;
+    SetupArena &operator=(const SetupArena&) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Uninitialised memory which stays valid until release()
+    void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        uintptr_t data = alignUp((uintptr_t)m_Top, alignment);
+        if(m_Top == nullptr || data + bytes > (uintptr_t)m_End) {
+            // Requests larger than a block get a block of their own, leaving the current one in use
+            const size_t blockBytes = std::max(m_BlockBytes, bytes + alignment);
+            char *block = (char*)mmap(nullptr, blockBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(block == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            m_Blocks.emplace_back(block, blockBytes);
+            m_NumBlocks++;
+            m_MappedBytes += blockBytes;
+            if(blockBytes > m_BlockBytes) {
+                m_NumAllocations++;
+                m_NumBytes += bytes;
+                return (void*)alignUp((uintptr_t)block, alignment);
+            }
+            m_Top = block;
+            m_End = block + blockBytes;
+            data = alignUp((uintptr_t)m_Top, alignment);
+        }
+        m_Top = (char*)(data + bytes);
+        m_NumAllocations++;
+        m_NumBytes += bytes;
+        return (void*)data;
+    }
+
+    //! Construct an object which lives until release()
+    template<typename T, typename... Args>
+    T *make(Args&&... args)
+    {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Destructors.emplace_back(object, [](void *o){ static_cast<T*>(o)->~T(); });
+        m_NumObjects++;
+        return object;
+    }
+
+    //! Destroy every object and unmap every block. Statistics are kept for reporting.
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for(auto d = m_Destructors.rbegin(); d != m_Destructors.rend(); ++d) {
+            d->second(d->first);
+        }
+        for(const auto &b : m_Blocks) {
+            munmap(b.first, b.second);
+        }
+        std::vector<std::pair<void*, void(*)(void*)>>().swap(m_Destructors);
+        std::vector<std::pair<char*, size_t>>().swap(m_Blocks);
+        m_Top = nullptr;
+        m_End = nullptr;
+    }
+
+    void printStats(const char *title) const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        printf("%s arena: %zu allocations (%zu objects) of %.2f MB in %zu blocks of %.2f MB\n",
+               title, m_NumAllocations, m_NumObjects, (double)m_NumBytes / (1024.0 * 1024.0),
+               m_NumBlocks, (double)m_MappedBytes / (1024.0 * 1024.0));
+    }
+
+    size_t getNumAllocations() const{ return m_NumAllocations; }
+    size_t getNumObjects() const{ return m_NumObjects; }
+
+private:
+    static uintptr_t alignUp(uintptr_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const size_t m_BlockBytes;
+    mutable std::mutex m_Mutex;
+    char *m_Top;
+    char *m_End;
+    std::vector<std::pair<char*, size_t>> m_Blocks;
+    std::vector<std::pair<void*, void(*)(void*)>> m_Destructors;
+
+    size_t m_NumAllocations;
+    size_t m_NumBytes;
+    size_t m_NumObjects;
+    size_t m_NumBlocks;
+    size_t m_MappedBytes;
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::ArenaAllocator
+//----------------------------------------------------------------------------
+//! Standard allocator drawing from a SetupArena. Deallocation does nothing,
+//! so vectors using it should be sized once rather than grown.
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(SetupArena &arena) : m_Arena(&arena)
+    {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : m_Arena(other.getArena())
+    {}
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    T *allocate(size_t n){ return static_cast<T*>(m_Arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t){}
+
+    SetupArena *getArena() const{ return m_Arena; }
+
+private:
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    SetupArena *m_Arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b){ return a.getArena() == b.getArena(); }
+
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b){ return a.getArena() != b.getArena(); }
+
+//! Scratch vector whose storage lives in a SetupArena
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}   // namespace BenchUtils
@@ -0,0 +1,336 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Standard C includes
+#include <cstdint>
+#include <cstring>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+// Shared-memory spike stream
+//----------------------------------------------------------------------------
+// A simulation publishes each timestep's spikes into a ring buffer in a
+// POSIX shared memory object (/dev/shm/<name>), which any number of other
+// processes can read live. A record is four 32-bit words - spike count,
+// group, and the step's low and high words - followed by the neuron IDs, and
+// records may wrap around the end of the ring. The single producer never
+// waits for consumers: before writing a record it advances 'reserved' to the
+// record's end, and once it is written it advances 'published'. A consumer
+// copies a record below 'published' and then checks 'reserved' - seqlock
+// style - to see whether the producer has since lapped it and overwritten
+// the copy. A consumer which falls a whole ring behind counts an overrun and
+// skips to the newest record, rather than slowing the simulation down.
+namespace BenchUtils {
+//! Start of the shared memory object, followed by the ring of words
+struct SpikeStreamHeader
+{
+    static constexpr uint64_t magic = 0x4d525453454b5053ull;     // "SPKESTRM"
+    static constexpr uint32_t version = 1;
+    static constexpr unsigned int maxGroups = 16;
+    static constexpr unsigned int maxNameLength = 32;
+    static constexpr unsigned int recordHeaderWords = 4;
+
+    uint64_t streamMagic;
+    uint32_t streamVersion;
+    uint32_t numGroups;
+
+    //! Ring size in 32-bit words - a power of two
+    uint64_t capacity;
+    double dt;
+
+    char groupNames[maxGroups][maxNameLength];
+    uint32_t groupSizes[maxGroups];
+
+    //! Positions in words since the stream started
+    alignas(64) std::atomic<uint64_t> reserved;
+    alignas(64) std::atomic<uint64_t> published;
+    std::atomic<uint32_t> finished;
+};
+
+// Consumers in other processes see the same atomics, so they must not use locks
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Spike streams need lock-free atomics");
+
+namespace Detail {
+inline size_t getSpikeStreamDataOffset()
+{
+    return (sizeof(SpikeStreamHeader) + 63) & ~(size_t)63;
+}
+}   // namespace Detail
+
+//----------------------------------------------------------------------------
+// BenchUtils::SpikeStreamPublisher
+//----------------------------------------------------------------------------
+//! Producer side - creates the stream, which is removed again on destruction
+//! (consumers already attached keep their mapping until they detach)
+class SpikeStreamPublisher
+{
+public:
+    //! groups are the name and size of each population whose spikes will be published
+    SpikeStreamPublisher(const std::string &name, const std::vector<std::pair<std::string, unsigned int>> &groups,
+                         double dtMs, uint64_t capacityWords = 4 * 1024 * 1024)
+    : m_Name(getObjectName(name)), m_Header(nullptr), m_Data(nullptr), m_Position(0)
+    {
+        if(groups.size() > SpikeStreamHeader::maxGroups) {
+            throw std::runtime_error("Spike streams carry at most " + std::to_string(SpikeStreamHeader::maxGroups) + " groups");
+        }
+        if(capacityWords == 0 || (capacityWords & (capacityWords - 1)) != 0) {
+            throw std::runtime_error("Spike stream capacity must be a power of two");
+        }
+
+        // Replace any stream left behind by a run which did not finish
+        shm_unlink(m_Name.c_str());
+        const int fd = shm_open(m_Name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+        if(fd < 0) {
+            throw std::runtime_error("Cannot create spike stream " + m_Name + ": " + strerror(errno));
+        }
+        m_Bytes = Detail::getSpikeStreamDataOffset() + capacityWords * sizeof(uint32_t);
+        void *data = MAP_FAILED;
+        if(ftruncate(fd, (off_t)m_Bytes) == 0) {
+            data = mmap(nullptr, m_Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if(data == MAP_FAILED) {
+            shm_unlink(m_Name.c_str());
+            throw std::runtime_error("Cannot map spike stream " + m_Name + ": " + strerror(errno));
+        }
+
+        // The object is zero-filled, so the atomics start at zero
+        m_Header = static_cast<SpikeStreamHeader*>(data);
+        m_Data = reinterpret_cast<uint32_t*>(static_cast<char*>(data) + Detail::getSpikeStreamDataOffset());
+        m_Header->streamVersion = SpikeStreamHeader::version;
+        m_Header->numGroups = (uint32_t)groups.size();
+        m_Header->capacity = capacityWords;
+        m_Header->dt = dtMs;
+        for(size_t g = 0; g < groups.size(); g++) {
+            strncpy(m_Header->groupNames[g], groups[g].first.c_str(), SpikeStreamHeader::maxNameLength - 1);
+            m_Header->groupSizes[g] = groups[g].second;
+        }
+
+        // Consumers check the magic number last, once everything else is set
+        std::atomic_thread_fence(std::memory_order_release);
+        m_Header->streamMagic = SpikeStreamHeader::magic;
+    }
+
+    ~SpikeStreamPublisher()
+    {
+        m_Header->finished.store(1, std::memory_order_release);
+        munmap(m_Header, m_Bytes);
+        shm_unlink(m_Name.c_str());
+    }
+
+    SpikeStreamPublisher(const SpikeStreamPublisher&) = delete;
+    SpikeStreamPublisher &operator=(const SpikeStreamPublisher&) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Publish one group's spikes for step. Never waits for consumers.
+    void publish(uint64_t step, unsigned int group, const uint32_t *ids, size_t count)
+    {
+        const uint64_t capacity = m_Header->capacity;
+        const uint64_t length = SpikeStreamHeader::recordHeaderWords + count;
+        if(length > capacity) {
+            throw std::runtime_error("Spike stream " + m_Name + " is too small for one step's spikes");
+        }
+
+        // Advertise the words about to be overwritten before touching them
+        const uint64_t end = m_Position + length;
+        m_Header->reserved.store(end, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const uint32_t header[SpikeStreamHeader::recordHeaderWords] = {(uint32_t)count, (uint32_t)group,
+                                                                      (uint32_t)step, (uint32_t)(step >> 32)};
+        writeWords(m_Position, header, SpikeStreamHeader::recordHeaderWords);
+        writeWords(m_Position + SpikeStreamHeader::recordHeaderWords, ids, count);
+
+        m_Header->published.store(end, std::memory_order_release);
+        m_Position = end;
+    }
+
+    const std::string &getName() const{ return m_Name; }
+
+    //! Shared memory objects are named "/name"
+    static std::string getObjectName(const std::string &name)
+    {
+        return (!name.empty() && name[0] == '/') ? name : ("/" + name);
+    }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void writeWords(uint64_t position, const uint32_t *words, size_t count)
+    {
+        const uint64_t capacity = m_Header->capacity;
+        const size_t offset = (size_t)(position & (capacity - 1));
+        const size_t first = std::min<size_t>(count, (size_t)capacity - offset);
+        std::copy_n(words, first, m_Data + offset);
+        std::copy_n(words + first, count - first, m_Data);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Name;
+    size_t m_Bytes;
+    SpikeStreamHeader *m_Header;
+    uint32_t *m_Data;
+
+    //! Only the producer writes, so it keeps its own copy of the position
+    uint64_t m_Position;
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::SpikeStreamRecord
+//----------------------------------------------------------------------------
+//! One group's spikes in one timestep
+struct SpikeStreamRecord
+{
+    uint64_t step;
+    unsigned int group;
+    std::vector<uint32_t> ids;
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::SpikeStreamConsumer
+//----------------------------------------------------------------------------
+//! Read-only view of a stream which polls for new records without ever
+//! holding up the producer. Reading starts from the newest record.
+class SpikeStreamConsumer
+{
+public:
+    SpikeStreamConsumer(const std::string &name)
+    : m_Name(SpikeStreamPublisher::getObjectName(name)), m_NumRecords(0), m_NumOverruns(0)
+    {
+        const int fd = shm_open(m_Name.c_str(), O_RDONLY, 0);
+        if(fd < 0) {
+            throw std::runtime_error("Cannot open spike stream " + m_Name + ": " + strerror(errno));
+        }
+        struct stat status;
+        void *data = MAP_FAILED;
+        if(fstat(fd, &status) == 0 && (size_t)status.st_size > Detail::getSpikeStreamDataOffset()) {
+            m_Bytes = (size_t)status.st_size;
+            data = mmap(nullptr, m_Bytes, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if(data == MAP_FAILED) {
+            throw std::runtime_error("Cannot map spike stream " + m_Name);
+        }
+
+        m_Header = static_cast<const SpikeStreamHeader*>(data);
+        m_Data = reinterpret_cast<const uint32_t*>(static_cast<const char*>(data) + Detail::getSpikeStreamDataOffset());
+        if(m_Header->streamMagic != SpikeStreamHeader::magic || m_Header->streamVersion != SpikeStreamHeader::version
+           || Detail::getSpikeStreamDataOffset() + m_Header->capacity * sizeof(uint32_t) != m_Bytes)
+        {
+            munmap(const_cast<SpikeStreamHeader*>(m_Header), m_Bytes);
+            throw std::runtime_error(m_Name + " is not a spike stream, or is not ready yet");
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        m_Position = m_Header->published.load(std::memory_order_acquire);
+    }
+
+    ~SpikeStreamConsumer()
+    {
+        munmap(const_cast<SpikeStreamHeader*>(m_Header), m_Bytes);
+    }
+
+    SpikeStreamConsumer(const SpikeStreamConsumer&) = delete;
+    SpikeStreamConsumer &operator=(const SpikeStreamConsumer&) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    //! Copy the next record into record - false if there is none yet
+    bool next(SpikeStreamRecord &record)
+    {
+        const uint64_t capacity = m_Header->capacity;
+        while(true) {
+            const uint64_t published = m_Header->published.load(std::memory_order_acquire);
+            if(m_Position == published) {
+                return false;
+            }
+            if(published - m_Position > capacity) {
+                skipTo(published);
+                continue;
+            }
+
+            uint32_t header[SpikeStreamHeader::recordHeaderWords];
+            readWords(m_Position, header, SpikeStreamHeader::recordHeaderWords);
+            const uint64_t length = SpikeStreamHeader::recordHeaderWords + (uint64_t)header[0];
+            if(length <= published - m_Position) {
+                record.ids.resize(header[0]);
+                readWords(m_Position + SpikeStreamHeader::recordHeaderWords, record.ids.data(), header[0]);
+            }
+
+            // If the producer has since reserved words over the copy, it may be torn
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(length > published - m_Position || m_Header->reserved.load(std::memory_order_relaxed) - m_Position > capacity) {
+                skipTo(m_Header->published.load(std::memory_order_acquire));
+                continue;
+            }
+
+            record.group = header[1];
+            record.step = (uint64_t)header[2] | ((uint64_t)header[3] << 32);
+            m_Position += length;
+            m_NumRecords++;
+            return true;
+        }
+    }
+
+    //! Whether the producer has finished - records may still be waiting to be read
+    bool isFinished() const{ return m_Header->finished.load(std::memory_order_acquire) != 0; }
+
+    unsigned int getNumGroups() const{ return m_Header->numGroups; }
+    std::string getGroupName(unsigned int group) const{ return std::string(m_Header->groupNames[group], strnlen(m_Header->groupNames[group], SpikeStreamHeader::maxNameLength)); }
+    unsigned int getGroupSize(unsigned int group) const{ return m_Header->groupSizes[group]; }
+    double getDT() const{ return m_Header->dt; }
+
+    uint64_t getNumRecords() const{ return m_NumRecords; }
+
+    //! Times the consumer fell behind and skipped to the newest record
+    uint64_t getNumOverruns() const{ return m_NumOverruns; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void skipTo(uint64_t position)
+    {
+        m_Position = position;
+        m_NumOverruns++;
+    }
+
+    void readWords(uint64_t position, uint32_t *words, size_t count) const
+    {
+        const uint64_t capacity = m_Header->capacity;
+        const size_t offset = (size_t)(position & (capacity - 1));
+        const size_t first = std::min<size_t>(count, (size_t)capacity - offset);
+        std::copy_n(m_Data + offset, first, words);
+        std::copy_n(m_Data, count - first, words + first);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    const std::string m_Name;
+    size_t m_Bytes;
+    const SpikeStreamHeader *m_Header;
+    const uint32_t *m_Data;
+
+    uint64_t m_Position;
+    uint64_t m_NumRecords;
+    uint64_t m_NumOverruns;
+};
+}   // namespace BenchUtils
@@ -0,0 +1,64 @@
+"""Reader for the neuron state files written by the CPU engine's StateMonitor.
+
+The file format is described in cpu/state_monitor.h. Each variable is read
+as a (samples, neurons) array; the columns are the monitored neurons in the
+order given by neuron_ids.
+
+    from state_monitor import StateMonitorFile
+    state = StateMonitorFile("../cpu/Build/exc_state.smon")
+    v = state.read("V")    # membrane potentials, one row per sample
+"""
+import numpy as np
+
+_HEADER = np.dtype([("magic", "S4"), ("version", "<u4"), ("num_neurons", "<u4"), ("num_variables", "<u4"),
+                    ("interval_steps", "<u4"), ("padding", "<u4"), ("dt", "<f8")])
+_NAME_LENGTH = 16
+
+
+class StateMonitorFile(object):
+    def __init__(self, filename):
+        self.filename = filename
+        with open(filename, "rb") as f:
+            header = np.fromfile(f, dtype=_HEADER, count=1)
+            if len(header) != 1 or header["magic"][0] != b"SMON" or header["version"][0] != 1:
+                raise ValueError("%s is not a state monitor file" % filename)
+            num_neurons = int(header["num_neurons"][0])
+            num_variables = int(header["num_variables"][0])
+            self.interval_steps = int(header["interval_steps"][0])
+            self.dt = float(header["dt"][0])
+            self.neuron_ids = np.fromfile(f, dtype="<u4", count=num_neurons)
+            names = np.fromfile(f, dtype="S%u" % _NAME_LENGTH, count=num_variables)
+            self.variables = [n.decode("ascii") for n in names]
+
+            # Read every block - a block cut short by a crash is ignored
+            steps = []
+            values = [[] for _ in self.variables]
+            while True:
+                num_samples = np.fromfile(f, dtype="<u8", count=1)
+                if len(num_samples) != 1:
+                    break
+                num_samples = int(num_samples[0])
+                block_steps = np.fromfile(f, dtype="<u8", count=num_samples)
+                block_values = [np.fromfile(f, dtype="<f4", count=num_samples * num_neurons)
+                                for _ in self.variables]
+                if len(block_steps) != num_samples or any(len(b) != num_samples * num_neurons for b in block_values):
+                    break
+                steps.append(block_steps)
+                for v, b in zip(values, block_values):
+                    v.append(b.reshape(num_samples, num_neurons))
+
+        self.steps = np.concatenate(steps) if steps else np.zeros(0, dtype=np.uint64)
+        self._values = {name: (np.concatenate(v) if v else np.zeros((0, num_neurons), dtype=np.float32))
+                        for name, v in zip(self.variables, values)}
+
+    def __len__(self):
+        return len(self.steps)
+
+    @property
+    def times(self):
+        """Sample times in ms"""
+        return self.steps * self.dt
+
+    def read(self, variable):
+        """Values of one variable as a (samples, neurons) float32 array"""
+        return self._values[variable]
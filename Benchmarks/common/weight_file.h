@@ -0,0 +1,221 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// Standard C includes
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//----------------------------------------------------------------------------
+// BenchUtils
+//----------------------------------------------------------------------------
+// Binary weight files (Weights.bin) shared by the frontends. A file is a
+// 32 byte little-endian header followed by the weights as one float array
+// in presynaptic-major order:
+//   char     magic[4]          "WBIN"
+//   uint32_t version           1
+//   uint64_t numSynapses
+//   uint64_t connectivityHash  see ConnectivityHash
+//   uint64_t reserved          0
+// Loading checks the hash so weights are never applied to different connectivity.
+namespace BenchUtils {
+//----------------------------------------------------------------------------
+// BenchUtils::ConnectivityHash
+//----------------------------------------------------------------------------
+//! 64-bit FNV-1a of the population sizes followed by, for each presynaptic
+//! row in order, its length and postsynaptic indices. It consumes a 32-bit
+//! word rather than a byte per round, which keeps hashing a large projection
+//! to a few milliseconds. Padded (ragged) and exact CSR layouts of the same
+//! connectivity hash the same as only the valid entries are visited.
+class ConnectivityHash
+{
+public:
+    ConnectivityHash(unsigned int numPre, unsigned int numPost) : m_Hash(14695981039346656037ull)
+    {
+        addWord(numPre);
+        addWord(numPost);
+    }
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    void addRow(const unsigned int *ind, unsigned int length)
+    {
+        addWord(length);
+        for(unsigned int s = 0; s < length; s++) {
+            addWord(ind[s]);
+        }
+    }
+
+    uint64_t getValue() const{ return m_Hash; }
+
+private:
+    //------------------------------------------------------------------------
+    // Private methods
+    //------------------------------------------------------------------------
+    void addWord(uint32_t word)
+    {
+        m_Hash = (m_Hash ^ word) * 1099511628211ull;
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    uint64_t m_Hash;
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::WeightFileHeader
+//----------------------------------------------------------------------------
+struct WeightFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t numSynapses;
+    uint64_t connectivityHash;
+    uint64_t reserved;
+};
+static_assert(sizeof(WeightFileHeader) == 32, "Weight file header must be packed");
+
+//----------------------------------------------------------------------------
+// BenchUtils::MappedWeightFile
+//----------------------------------------------------------------------------
+//! Read-only private mapping of a weight file. Pages are faulted in up front
+//! so copying out of the mapping runs at memory bandwidth.
+class MappedWeightFile
+{
+public:
+    MappedWeightFile(const std::string &filename) : m_Data(MAP_FAILED), m_Size(0)
+    {
+        const int fd = open(filename.c_str(), O_RDONLY);
+        if(fd < 0) {
+            throw std::runtime_error("Cannot open weight file " + filename + ": " + strerror(errno));
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(WeightFileHeader)) {
+            m_Size = (size_t)st.st_size;
+            m_Data = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        }
+        close(fd);
+        if(m_Data == MAP_FAILED) {
+            throw std::runtime_error("Cannot map weight file " + filename);
+        }
+        madvise(m_Data, m_Size, MADV_SEQUENTIAL);
+
+        const WeightFileHeader &header = getHeader();
+        if(memcmp(header.magic, "WBIN", 4) != 0 || header.version != 1) {
+            munmap(m_Data, m_Size);
+            throw std::runtime_error(filename + " is not a weight file");
+        }
+        if(m_Size != sizeof(WeightFileHeader) + header.numSynapses * sizeof(float)) {
+            munmap(m_Data, m_Size);
+            throw std::runtime_error("Weight file " + filename + " is truncated");
+        }
+    }
+
+    ~MappedWeightFile()
+    {
+        munmap(m_Data, m_Size);
+    }
+
+    MappedWeightFile(const MappedWeightFile&) = delete;
+    MappedWeightFile &operator=(const MappedWeightFile&) = delete;
+
+    //------------------------------------------------------------------------
+    // Public API
+    //------------------------------------------------------------------------
+    size_t getNumSynapses() const{ return (size_t)getHeader().numSynapses; }
+    uint64_t getConnectivityHash() const{ return getHeader().connectivityHash; }
+
+    const float *getWeights() const
+    {
+        return reinterpret_cast<const float*>(static_cast<const char*>(m_Data) + sizeof(WeightFileHeader));
+    }
+
+private:
+    const WeightFileHeader &getHeader() const{ return *static_cast<const WeightFileHeader*>(m_Data); }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    void *m_Data;
+    size_t m_Size;
+};
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Write header and weights with a single gathering system call (repeated only if the kernel writes short)
+inline void saveWeights(const std::string &filename, const float *weights, size_t numSynapses, uint64_t connectivityHash)
+{
+    WeightFileHeader header = {{'W', 'B', 'I', 'N'}, 1, numSynapses, connectivityHash, 0};
+
+    const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        throw std::runtime_error("Cannot create weight file " + filename + ": " + strerror(errno));
+    }
+
+    iovec iov[2] = {{&header, sizeof(header)},
+                    {const_cast<float*>(weights), numSynapses * sizeof(float)}};
+    iovec *remaining = iov;
+    int numRemaining = 2;
+    while(numRemaining > 0) {
+        const ssize_t written = writev(fd, remaining, numRemaining);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            throw std::runtime_error("Cannot write weight file " + filename + ": " + strerror(errno));
+        }
+
+        // Advance past whatever was written
+        size_t advance = (size_t)written;
+        while(numRemaining > 0 && advance >= remaining->iov_len) {
+            advance -= remaining->iov_len;
+            remaining++;
+            numRemaining--;
+        }
+        if(numRemaining > 0) {
+            remaining->iov_base = static_cast<char*>(remaining->iov_base) + advance;
+            remaining->iov_len -= advance;
+        }
+    }
+    if(close(fd) != 0) {
+        throw std::runtime_error("Cannot write weight file " + filename + ": " + strerror(errno));
+    }
+}
+
+//! Check a mapped file matches the connectivity it is about to be loaded into
+inline void checkWeightFile(const MappedWeightFile &file, const std::string &filename,
+                            size_t numSynapses, uint64_t connectivityHash)
+{
+    if(file.getNumSynapses() != numSynapses) {
+        throw std::runtime_error("Weight file " + filename + " has " + std::to_string(file.getNumSynapses())
+                                 + " synapses but the projection has " + std::to_string(numSynapses));
+    }
+    if(file.getConnectivityHash() != connectivityHash) {
+        throw std::runtime_error("Weight file " + filename + " was saved from different connectivity");
+    }
+}
+
+//! Load a contiguous weight array saved by saveWeights
+inline void loadWeights(const std::string &filename, float *weights, size_t numSynapses, uint64_t connectivityHash)
+{
+    const MappedWeightFile file(filename);
+    checkWeightFile(file, filename, numSynapses, connectivityHash);
+    std::copy_n(file.getWeights(), numSynapses, weights);
+}
+}   // namespace BenchUtils
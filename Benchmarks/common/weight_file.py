@@ -0,0 +1,27 @@
+"""Reader for the Weights.bin files written by the CPU engine and GeNN frontends.
+
+The file format is described in weight_file.h. The weights are memory mapped
+rather than read, so loading a file is immediate and only touched pages are
+read from disk.
+
+    from weight_file import load_weights
+    weights = load_weights("../genn/Weights.bin")
+"""
+import numpy as np
+
+_HEADER = np.dtype([("magic", "S4"), ("version", "<u4"), ("num_synapses", "<u8"),
+                    ("connectivity_hash", "<u8"), ("reserved", "<u8")])
+
+
+def read_header(filename):
+    """Returns (number of synapses, connectivity hash) of a weight file"""
+    header = np.fromfile(filename, dtype=_HEADER, count=1)
+    if len(header) != 1 or header["magic"][0] != b"WBIN" or header["version"][0] != 1:
+        raise ValueError("%s is not a weight file" % filename)
+    return int(header["num_synapses"][0]), int(header["connectivity_hash"][0])
+
+
+def load_weights(filename):
+    """Weights as a read-only float32 array in presynaptic-major order"""
+    num_synapses, _ = read_header(filename)
+    return np.memmap(filename, dtype="<f4", mode="r", offset=_HEADER.itemsize, shape=(num_synapses,))
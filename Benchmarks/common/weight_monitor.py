@@ -0,0 +1,96 @@
+"""Reader for the weight snapshot files written by the CPU engine's WeightMonitor.
+
+The file format is described in cpu/weight_monitor.h. Snapshots are rebuilt
+from the nearest preceding keyframe, so reading any one of them only decodes
+the deltas since that keyframe.
+
+    from weight_monitor import WeightMonitorFile
+    snapshots = WeightMonitorFile("../cpu/Build/Weights.wmon")
+    weights = snapshots.read(-1)    # final weights, in presynaptic-major order
+"""
+import numpy as np
+
+_HEADER = np.dtype([("magic", "S4"), ("version", "<u4"), ("num_synapses", "<u8"), ("dt", "<f8")])
+_RECORD = np.dtype([("step", "<u8"), ("type", "u1"), ("payload_bytes", "<u8")])
+_KEYFRAME = 0
+_DELTA = 1
+
+
+def _apply_delta(bits, payload):
+    """XORs a delta payload into the previous snapshot's bits (uint32 array)"""
+    n = len(bits)
+    control = payload[:(n + 1) // 2]
+    num_bytes = np.empty(2 * len(control), dtype=np.uint8)
+    num_bytes[0::2] = control & 0xF
+    num_bytes[1::2] = control >> 4
+    num_bytes = num_bytes[:n].astype(np.int64)
+
+    data = payload[(n + 1) // 2:].astype(np.uint32)
+    if num_bytes.max(initial=0) > 4 or num_bytes.sum() != len(data):
+        raise ValueError("Corrupt weight delta")
+    start = np.cumsum(num_bytes) - num_bytes
+    x = np.zeros(n, dtype=np.uint32)
+    for b in range(4):
+        has_byte = num_bytes > b
+        x[has_byte] |= data[start[has_byte] + b] << np.uint32(8 * b)
+    bits ^= x
+
+
+class WeightMonitorFile(object):
+    def __init__(self, filename):
+        self.filename = filename
+        with open(filename, "rb") as f:
+            header = np.fromfile(f, dtype=_HEADER, count=1)
+            if len(header) != 1 or header["magic"][0] != b"WMON" or header["version"][0] != 1:
+                raise ValueError("%s is not a weight monitor file" % filename)
+            self.num_synapses = int(header["num_synapses"][0])
+            self.dt = float(header["dt"][0])
+
+            # Index records - a record cut short by a crash is ignored
+            f.seek(0, 2)
+            file_size = f.tell()
+            offset = _HEADER.itemsize
+            self._records = []
+            while offset + _RECORD.itemsize <= file_size:
+                f.seek(offset)
+                record = np.fromfile(f, dtype=_RECORD, count=1)[0]
+                payload_offset = offset + _RECORD.itemsize
+                payload_bytes = int(record["payload_bytes"])
+                if payload_offset + payload_bytes > file_size:
+                    break
+                self._records.append((int(record["step"]), int(record["type"]), payload_offset, payload_bytes))
+                offset = payload_offset + payload_bytes
+
+        if self._records and self._records[0][1] != _KEYFRAME:
+            raise ValueError("%s does not start with a keyframe" % filename)
+
+    def __len__(self):
+        return len(self._records)
+
+    @property
+    def steps(self):
+        return np.array([r[0] for r in self._records], dtype=np.uint64)
+
+    @property
+    def times(self):
+        """Snapshot times in ms"""
+        return self.steps * self.dt
+
+    def read(self, snapshot):
+        """Weights of one snapshot as a float32 array (negative indices count from the end)"""
+        snapshot = range(len(self._records))[snapshot]
+        keyframe = snapshot
+        while self._records[keyframe][1] != _KEYFRAME:
+            keyframe -= 1
+
+        bits = None
+        with open(self.filename, "rb") as f:
+            for step, record_type, payload_offset, payload_bytes in self._records[keyframe:snapshot + 1]:
+                f.seek(payload_offset)
+                if record_type == _KEYFRAME:
+                    if payload_bytes != 4 * self.num_synapses:
+                        raise ValueError("Corrupt weight keyframe")
+                    bits = np.fromfile(f, dtype="<u4", count=self.num_synapses)
+                else:
+                    _apply_delta(bits, np.fromfile(f, dtype=np.uint8, count=payload_bytes))
+        return bits.view(np.float32)
@@ -0,0 +1,257 @@
+#pragma once
+
+// Standard C++ includes
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Standard C includes
+#include <cstdio>
+#include <cstdlib>
+
+// Shared includes
+#include "huge_pages.h"
+#include "setup_arena.h"
+
+//----------------------------------------------------------------------------
+// BenchUtils
+//----------------------------------------------------------------------------
+// Loading of the Auryn MatrixMarket (.wmat) connectivity shared by all frontends
+namespace BenchUtils {
+//----------------------------------------------------------------------------
+// BenchUtils::WmatHeader
+//----------------------------------------------------------------------------
+//! Size line of a MatrixMarket coordinate file
+struct WmatHeader
+{
+    unsigned int numPre;
+    unsigned int numPost;
+    size_t numSynapses;
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::CSRConnectivity
+//----------------------------------------------------------------------------
+//! Compressed sparse row connectivity with exact (unpadded) row lengths
+struct CSRConnectivity
+{
+    unsigned int numPre;
+    unsigned int numPost;
+
+    //! Length of the longest row, derived from the data
+    unsigned int maxRowLength;
+
+    //! numPre + 1 offsets into ind and weight
+    std::vector<size_t> rowStart;
+
+    //! Postsynaptic index of each synapse, grouped by presynaptic neuron
+    HugePageVector<unsigned int> ind;
+
+    //! Weight of each synapse, as stored in the file
+    HugePageVector<float> weight;
+
+    size_t getNumSynapses() const{ return ind.size(); }
+    unsigned int getRowLength(unsigned int pre) const{ return (unsigned int)(rowStart[pre + 1] - rowStart[pre]); }
+};
+
+//----------------------------------------------------------------------------
+// BenchUtils::PairwiseConnectivity
+//----------------------------------------------------------------------------
+//! Connectivity as parallel (pre, post, weight) lists in file order, typed to match
+//! Spike's pairwise_connect_* vectors so they can be moved rather than copied
+struct PairwiseConnectivity
+{
+    unsigned int numPre;
+    unsigned int numPost;
+
+    std::vector<int> pre;
+    std::vector<int> post;
+    std::vector<float> weight;
+
+    size_t getNumSynapses() const{ return pre.size(); }
+};
+
+namespace Detail {
+//----------------------------------------------------------------------------
+// BenchUtils::Detail::WmatText
+//----------------------------------------------------------------------------
+//! Whole file read in a single call with the header already parsed. The text,
+//! and any scratch arrays, live in the loader's arena rather than on the heap.
+class WmatText
+{
+public:
+    WmatText(const std::string &filename, SetupArena &arena)
+    : m_Arena(arena)
+    {
+        std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+        if(!file.good()) {
+            throw std::runtime_error("Could not open connectivity file: " + filename
+                                     + " - have you created it as instructed in the README.md?");
+        }
+
+        // Read everything, null terminated so strtoul can't run off the end
+        const std::streamsize size = file.tellg();
+        char *text = (char*)m_Arena.allocate((size_t)size + 1, 1);
+        file.seekg(0);
+        file.read(text, size);
+        text[(size_t)size] = '\0';
+
+        // Skip the banner and comment lines
+        const char *c = text;
+        while(*c == '%') {
+            c = nextLine(c);
+        }
+
+        // First non-comment line gives the matrix dimensions
+        char *end;
+        m_Header.numPre = (unsigned int)strtoul(c, &end, 10);
+        m_Header.numPost = (unsigned int)strtoul(end, &end, 10);
+        m_Header.numSynapses = (size_t)strtoull(end, &end, 10);
+        if(end == c) {
+            throw std::runtime_error("Missing size line in connectivity file: " + filename);
+        }
+        m_Data = nextLine(end);
+    }
+
+    const WmatHeader &getHeader() const{ return m_Header; }
+
+    //! Call f(pre, post, weight) with zero-based indices for every entry
+    template<typename F>
+    void forEachEntry(F f) const
+    {
+        char *c = const_cast<char*>(m_Data);
+        for(size_t s = 0; s < m_Header.numSynapses; s++) {
+            char *end;
+            const unsigned long pre = strtoul(c, &end, 10);
+            const unsigned long post = strtoul(end, &end, 10);
+            const float weight = strtof(end, &end);
+            if(end == c) {
+                throw std::runtime_error("Connectivity file ended after " + std::to_string(s)
+                                         + " of " + std::to_string(m_Header.numSynapses) + " entries");
+            }
+            c = end;
+            f((unsigned int)(pre - 1), (unsigned int)(post - 1), weight);
+        }
+    }
+
+    //! Throw if an entry lies outside the matrix given in the header
+    void checkEntry(unsigned int pre, unsigned int post) const
+    {
+        if(pre >= m_Header.numPre || post >= m_Header.numPost) {
+            throw std::runtime_error("Connectivity entry (" + std::to_string(pre + 1) + ", " + std::to_string(post + 1)
+                                     + ") lies outside the " + std::to_string(m_Header.numPre) + "x"
+                                     + std::to_string(m_Header.numPost) + " matrix");
+        }
+    }
+
+    //! Pre-pass which only counts the number of synapses in each row
+    ArenaVector<size_t> countRowLengths() const
+    {
+        ArenaVector<size_t> rowLength(m_Header.numPre, 0, ArenaAllocator<size_t>(m_Arena));
+        forEachEntry(
+            [this, &rowLength](unsigned int pre, unsigned int post, float)
+            {
+                checkEntry(pre, post);
+                rowLength[pre]++;
+            });
+        return rowLength;
+    }
+
+private:
+    static const char *nextLine(const char *c)
+    {
+        while(*c != '\0' && *c != '\n') {
+            c++;
+        }
+        return (*c == '\0') ? c : (c + 1);
+    }
+
+    //------------------------------------------------------------------------
+    // Members
+    //------------------------------------------------------------------------
+    SetupArena &m_Arena;
+    WmatHeader m_Header;
+    const char *m_Data;
+};
+}   // namespace Detail
+
+//----------------------------------------------------------------------------
+// Free functions
+//----------------------------------------------------------------------------
+//! Length of the longest row in a .wmat file - used to size models at code-generation time
+inline unsigned int getMaxRowLength(const std::string &filename)
+{
+    SetupArena scratch;
+    Detail::WmatText text(filename, scratch);
+    const auto rowLength = text.countRowLengths();
+    return rowLength.empty() ? 0 : (unsigned int)*std::max_element(rowLength.begin(), rowLength.end());
+}
+
+//! Load a .wmat file into compact CSR form - row lengths are counted in a first pass so
+//! every array is allocated exactly once at its final size
+inline CSRConnectivity loadWmatCSR(const std::string &filename)
+{
+    SetupArena scratch;
+    Detail::WmatText text(filename, scratch);
+    const WmatHeader &header = text.getHeader();
+
+    CSRConnectivity csr;
+    csr.numPre = header.numPre;
+    csr.numPost = header.numPost;
+
+    // Pre-pass: exact row lengths give the row offsets
+    const auto rowLength = text.countRowLengths();
+    csr.rowStart.resize(header.numPre + 1);
+    csr.rowStart[0] = 0;
+    csr.maxRowLength = 0;
+    for(unsigned int pre = 0; pre < header.numPre; pre++) {
+        csr.rowStart[pre + 1] = csr.rowStart[pre] + rowLength[pre];
+        csr.maxRowLength = std::max(csr.maxRowLength, (unsigned int)rowLength[pre]);
+    }
+
+    // Second pass: scatter entries into their rows, preserving file order within each row
+    csr.ind.resize(header.numSynapses);
+    csr.weight.resize(header.numSynapses);
+    ArenaVector<size_t> cursor(csr.rowStart.begin(), csr.rowStart.end() - 1, ArenaAllocator<size_t>(scratch));
+    text.forEachEntry(
+        [&csr, &cursor](unsigned int pre, unsigned int post, float weight)
+        {
+            const size_t s = cursor[pre]++;
+            csr.ind[s] = post;
+            csr.weight[s] = weight;
+        });
+
+    printf("Loaded %zu synapses from %s (max row length %u)\n",
+           csr.getNumSynapses(), filename.c_str(), csr.maxRowLength);
+    return csr;
+}
+
+//! Load a .wmat file as pairwise lists - the header's synapse count is used to reserve
+//! every vector at its exact size so nothing is reallocated while parsing
+inline PairwiseConnectivity loadWmatPairwise(const std::string &filename)
+{
+    SetupArena scratch;
+    Detail::WmatText text(filename, scratch);
+    const WmatHeader &header = text.getHeader();
+
+    PairwiseConnectivity pairwise;
+    pairwise.numPre = header.numPre;
+    pairwise.numPost = header.numPost;
+    pairwise.pre.reserve(header.numSynapses);
+    pairwise.post.reserve(header.numSynapses);
+    pairwise.weight.reserve(header.numSynapses);
+    text.forEachEntry(
+        [&text, &pairwise](unsigned int pre, unsigned int post, float weight)
+        {
+            text.checkEntry(pre, post);
+            pairwise.pre.push_back((int)pre);
+            pairwise.post.push_back((int)post);
+            pairwise.weight.push_back(weight);
+        });
+
+    printf("Loaded %zu synapses from %s\n", pairwise.getNumSynapses(), filename.c_str());
+    return pairwise;
+}
+}   // namespace BenchUtils
@@ -0,0 +1,131 @@
+// Live firing-rate monitor
+//
+// Attaches to the shared-memory spike stream of a running simulation - e.g.
+// Brunel10K --spike_stream NAME - and prints each group's mean firing rate
+// over every interval of simulated time. The simulation never waits for the
+// monitor: if it falls a whole ring behind, it skips ahead, and the steps it
+// missed are left out of the rates and reported.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "spike_stream.h"
+
+// Spikes and steps seen of each group in the current interval
+struct Interval
+{
+  unsigned long long index = 0;
+  std::vector<unsigned long long> spikes;
+  std::vector<unsigned long long> steps;
+};
+
+void print_interval(const BenchUtils::SpikeStreamConsumer& consumer, const Interval& interval,
+                    unsigned long long intervalSteps){
+  printf("%10.1f ms:", (double)(interval.index * intervalSteps) * consumer.getDT());
+  unsigned long long minSteps = intervalSteps;
+  for (unsigned int g = 0; g < consumer.getNumGroups(); g++) {
+    const double seconds = (double)interval.steps[g] * consumer.getDT() / 1000.0;
+    const double rate = (seconds > 0.0) ? (double)interval.spikes[g] / ((double)consumer.getGroupSize(g) * seconds) : 0.0;
+    printf(" %s %.2f Hz", consumer.getGroupName(g).c_str(), rate);
+    minSteps = std::min(minSteps, interval.steps[g]);
+  }
+  if (minSteps < intervalSteps)
+    printf(" (only %llu of %llu steps seen)", minSteps, intervalSteps);
+  printf("\n");
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  double intervalMs = 100.0;
+  double waitSeconds = 10.0;
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"interval", 1, nullptr, 0},
+    {"wait", 1, nullptr, 1},
+    {nullptr, 0, nullptr, 0}
+  };
+  // Check the set of options
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+
+    // If none
+    if (-1 == opt) break;
+
+    switch (opt){
+      case 0:
+        printf("Reporting rates every %sms of simulated time\n", optarg);
+        intervalMs = std::stod(optarg);
+        break;
+      case 1:
+        printf("Waiting up to %ss for the stream\n", optarg);
+        waitSeconds = std::stod(optarg);
+        break;
+      default:
+        return(-1);
+    }
+  };
+  if (optind != argc - 1) {
+    printf("Usage: %s [--interval MS] [--wait S] STREAM\n", argv[0]);
+    return(-1);
+  }
+
+  // The simulation may still be loading its connectivity
+  std::unique_ptr<BenchUtils::SpikeStreamConsumer> consumer;
+  const auto waitEnd = std::chrono::steady_clock::now() + std::chrono::duration<double>(waitSeconds);
+  while (!consumer) {
+    try {
+      consumer.reset(new BenchUtils::SpikeStreamConsumer(argv[optind]));
+    } catch (const std::exception& e) {
+      if (std::chrono::steady_clock::now() > waitEnd) {
+        printf("%s\n", e.what());
+        return(-1);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  const unsigned int numGroups = consumer->getNumGroups();
+  const unsigned long long intervalSteps = std::max(1ll, std::llround(intervalMs / consumer->getDT()));
+  printf("Attached to %s: %u groups, %g ms timestep\n", argv[optind], numGroups, consumer->getDT());
+
+  // Poll for records, printing each interval once a later one starts
+  BenchUtils::SpikeStreamRecord record;
+  Interval interval;
+  interval.spikes.assign(numGroups, 0);
+  interval.steps.assign(numGroups, 0);
+  bool started = false;
+  unsigned long long numSpikes = 0;
+  while (true) {
+    const bool finished = consumer->isFinished();
+    if (!consumer->next(record)) {
+      if (finished) break;
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      continue;
+    }
+    if (record.group >= numGroups) continue;
+
+    const unsigned long long index = record.step / intervalSteps;
+    if (started && index != interval.index) {
+      print_interval(*consumer, interval, intervalSteps);
+      std::fill(interval.spikes.begin(), interval.spikes.end(), 0);
+      std::fill(interval.steps.begin(), interval.steps.end(), 0);
+    }
+    started = true;
+    interval.index = index;
+    interval.spikes[record.group] += record.ids.size();
+    interval.steps[record.group]++;
+    numSpikes += record.ids.size();
+  }
+  if (started)
+    print_interval(*consumer, interval, intervalSteps);
+
+  printf("Stream finished: %llu records, %llu spikes, %llu overruns\n",
+         (unsigned long long)consumer->getNumRecords(), numSpikes, (unsigned long long)consumer->getNumOverruns());
+  return 0;
+}
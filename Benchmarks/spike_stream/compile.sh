@@ -0,0 +1,13 @@
+# Make a Build directory
+mkdir -p Build
+cd ./Build
+
+# Now run cmake init
+cmake ../
+
+# Finally compile the rate monitor
+make RateMonitor -j8
+
+# In order to watch a simulation's firing rates while it runs;
+# ../../Brunel/cpu/Build/Brunel10K --spike_stream brunel &
+# ./RateMonitor brunel
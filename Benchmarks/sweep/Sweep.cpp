@@ -0,0 +1,667 @@
+// Parallel benchmark sweep driver
+//
+// Runs every point of a configuration grid, several benchmark binaries at a
+// time, and aggregates their timefile.dat results into one table. Each run is
+// pinned to its own set of physical cores - within one NUMA node, with its
+// memory bound to that node, whenever it fits in one - so concurrent runs do
+// not compete for cores, caches or memory controllers, and runs are only
+// started while their memory estimates fit in the memory budget.
+//
+// A grid file holds one directive per line ('#' starts a comment):
+//   command <shell command>   the benchmark to run, e.g.
+//                             {root}/../cpu/Build/VogelsAbbottNet --fast --simtime {simtime}
+//   param <name> <values...>  a grid dimension; values may be quoted, e.g. "" "--plastic"
+//   cores <n>                 physical cores per run (default 1), e.g. {threads}
+//   memory <MB>               memory estimate per run, e.g. 200*{scale}; without one
+//                             (or with 0), the first run of each configuration runs
+//                             alone to measure it before its other runs fan out
+//   rundir <dir>              where each run executes (default {root}/runs/{run}); the
+//                             benchmarks find their .wmat files relative to it
+//   result <file>             file in the run directory holding the result (default timefile.dat)
+//   collect <file>            also write each configuration's mean result to this file,
+//                             e.g. {root}/Auryn/{scale}.dat for the plotting scripts
+//   table <file>              aggregated results (default {root}/sweep_results.csv)
+//   repeat <n>                runs per configuration (default 1)
+//   retries <n>               times a failed run is retried (default 2)
+//   timeout <s>               runs taking longer are killed and retried (default none)
+// Values substitute {name} for a parameter, {root} for the grid file's
+// directory, {run} for a unique run number and {repeat} for the repeat index.
+// cores and memory may be products such as 200*{scale}.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cpu_topology.h"
+#include "memory_usage.h"
+
+struct Grid
+{
+  std::string root;
+  std::string command;
+  std::vector<std::pair<std::string, std::vector<std::string>>> params;
+  std::string cores = "1";
+  std::string memory = "0";
+  std::string rundir = "{root}/runs/{run}";
+  std::string result = "timefile.dat";
+  std::string collect;
+  std::string table = "{root}/sweep_results.csv";
+  unsigned int repeat = 1;
+  unsigned int retries = 2;
+  double timeout = 0.0;
+};
+
+// One point of the grid
+struct Config
+{
+  std::map<std::string, std::string> values;
+  unsigned int cores;
+  size_t memory;
+  std::vector<double> results;
+  std::vector<double> wallTimes;
+  size_t peakRSS = 0;
+  unsigned int numFailed = 0;
+  unsigned int numAttempts = 0;
+  bool probing = false;
+};
+
+// One execution of a configuration
+struct Run
+{
+  size_t config;
+  unsigned int repeat;
+  std::string rundir;
+  std::string command;
+  unsigned int attempts = 0;
+};
+
+// A run in progress
+struct Slot
+{
+  pid_t pid;
+  size_t run;
+  std::vector<size_t> cores;
+  size_t memory;
+  std::chrono::steady_clock::time_point start;
+  bool timedOut = false;
+};
+
+// Kills and reaps the runs still in progress however the scheduling loop is
+// left, so no process group outlives the sweep
+struct RunningGuard
+{
+  std::vector<Slot>& running;
+
+  ~RunningGuard(){
+    for (const auto& s : running) kill(-s.pid, SIGKILL);
+    for (const auto& s : running) waitpid(s.pid, nullptr, 0);
+  }
+};
+
+volatile sig_atomic_t interrupted = 0;
+
+void handle_interrupt(int){
+  interrupted = 1;
+}
+
+// Splits a line into whitespace-separated tokens, honouring double quotes
+std::vector<std::string> tokenise(const std::string& line){
+  std::vector<std::string> tokens;
+  size_t i = 0;
+  while (true) {
+    while (i < line.size() && isspace((unsigned char)line[i])) i++;
+    if (i >= line.size()) break;
+
+    std::string token;
+    if (line[i] == '"') {
+      const size_t end = line.find('"', i + 1);
+      if (end == std::string::npos)
+        throw std::runtime_error("Unterminated quote in '" + line + "'");
+      token = line.substr(i + 1, end - i - 1);
+      i = end + 1;
+    }
+    else {
+      while (i < line.size() && !isspace((unsigned char)line[i])) token += line[i++];
+    }
+    tokens.push_back(token);
+  }
+  return(tokens);
+}
+
+std::string trim(const std::string& s){
+  const size_t first = s.find_first_not_of(" \t\r");
+  if (first == std::string::npos) return("");
+  return(s.substr(first, s.find_last_not_of(" \t\r") - first + 1));
+}
+
+Grid load_grid(const std::string& filename){
+  std::ifstream file(filename);
+  if (!file.good())
+    throw std::runtime_error("Cannot open grid file '" + filename + "'");
+
+  Grid grid;
+  char* root = realpath(filename.c_str(), nullptr);
+  grid.root = root;
+  free(root);
+  grid.root = grid.root.substr(0, grid.root.rfind('/'));
+
+  std::string line;
+  unsigned int lineNumber = 0;
+  while (std::getline(file, line)) {
+    lineNumber++;
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos) line.resize(comment);
+    line = trim(line);
+    if (line.empty()) continue;
+
+    const size_t space = line.find_first_of(" \t");
+    const std::string directive = line.substr(0, space);
+    const std::string rest = (space == std::string::npos) ? "" : trim(line.substr(space));
+    if (rest.empty())
+      throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": '" + directive + "' needs a value");
+
+    if (directive == "command") grid.command = rest;
+    else if (directive == "cores") grid.cores = rest;
+    else if (directive == "memory") grid.memory = rest;
+    else if (directive == "rundir") grid.rundir = rest;
+    else if (directive == "result") grid.result = rest;
+    else if (directive == "collect") grid.collect = rest;
+    else if (directive == "table") grid.table = rest;
+    else if (directive == "repeat") grid.repeat = std::stoul(rest);
+    else if (directive == "retries") grid.retries = std::stoul(rest);
+    else if (directive == "timeout") grid.timeout = std::stod(rest);
+    else if (directive == "param") {
+      std::vector<std::string> tokens = tokenise(rest);
+      if (tokens.size() < 2)
+        throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": param needs a name and at least one value");
+      const std::string name = tokens.front();
+      tokens.erase(tokens.begin());
+      grid.params.emplace_back(name, tokens);
+    }
+    else {
+      throw std::runtime_error(filename + ":" + std::to_string(lineNumber) + ": unknown directive '" + directive + "'");
+    }
+  }
+
+  if (grid.command.empty())
+    throw std::runtime_error(filename + ": no command given");
+  if (grid.repeat == 0)
+    throw std::runtime_error(filename + ": repeat must be at least 1");
+  return(grid);
+}
+
+// Replaces each {name} with its value
+std::string substitute(const std::string& text, const std::map<std::string, std::string>& values){
+  std::string out;
+  size_t i = 0;
+  while (i < text.size()) {
+    const size_t open = text.find('{', i);
+    if (open == std::string::npos) {
+      out += text.substr(i);
+      break;
+    }
+    const size_t close = text.find('}', open);
+    if (close == std::string::npos)
+      throw std::runtime_error("Unterminated '{' in '" + text + "'");
+
+    const auto value = values.find(text.substr(open + 1, close - open - 1));
+    if (value == values.end())
+      throw std::runtime_error("Unknown placeholder '" + text.substr(open, close - open + 1) + "' in '" + text + "'");
+    out += text.substr(i, open - i) + value->second;
+    i = close + 1;
+  }
+  return(out);
+}
+
+// Evaluates a product of numbers such as "200*4"
+double evaluate_product(const std::string& text){
+  double product = 1.0;
+  std::stringstream stream(text);
+  std::string factor;
+  while (std::getline(stream, factor, '*')) {
+    size_t used;
+    product *= std::stod(trim(factor), &used);
+    if (used != trim(factor).size())
+      throw std::runtime_error("Cannot evaluate '" + text + "'");
+  }
+  return(product);
+}
+
+// Creates a directory and any missing parents
+void make_directories(const std::string& path){
+  for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+    const std::string dir = path.substr(0, slash);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+      throw std::runtime_error("Cannot create directory '" + dir + "'");
+    if (slash == std::string::npos) break;
+  }
+}
+
+// Reads the first number in a result file
+bool read_result(const std::string& filename, double& result){
+  std::ifstream file(filename);
+  return(static_cast<bool>(file >> result));
+}
+
+// Chooses free physical cores for a run: the best fitting single node if
+// the run fits in one, otherwise (for runs larger than any node) the
+// nodes with the most free cores
+bool place(unsigned int numCores, const std::vector<BenchUtils::PhysicalCore>& physicalCores,
+           const std::vector<bool>& coreUsed, std::vector<size_t>& placement){
+  std::map<unsigned int, std::vector<size_t>> freeByNode;
+  std::map<unsigned int, size_t> sizeByNode;
+  for (size_t c = 0; c < physicalCores.size(); c++) {
+    sizeByNode[physicalCores[c].node]++;
+    if (!coreUsed[c]) freeByNode[physicalCores[c].node].push_back(c);
+  }
+
+  const std::vector<size_t>* best = nullptr;
+  for (const auto& n : freeByNode) {
+    if (n.second.size() >= numCores && (best == nullptr || n.second.size() < best->size()))
+      best = &n.second;
+  }
+  if (best != nullptr) {
+    placement.assign(best->begin(), best->begin() + numCores);
+    return(true);
+  }
+
+  // Only spread across nodes if waiting could never give a single node
+  size_t largestNode = 0;
+  for (const auto& n : sizeByNode) largestNode = std::max(largestNode, n.second);
+  if (numCores <= largestNode) return(false);
+
+  std::vector<std::vector<size_t>> nodes;
+  size_t numFree = 0;
+  for (const auto& n : freeByNode) {
+    nodes.push_back(n.second);
+    numFree += n.second.size();
+  }
+  if (numFree < numCores) return(false);
+  std::sort(nodes.begin(), nodes.end(),
+            [](const std::vector<size_t>& a, const std::vector<size_t>& b){ return a.size() > b.size(); });
+  placement.clear();
+  for (const auto& n : nodes) {
+    for (size_t c : n) {
+      if (placement.size() == numCores) return(true);
+      placement.push_back(c);
+    }
+  }
+  return(true);
+}
+
+// Forks a run pinned to the given physical cores, with its memory bound to
+// (or, across several, interleaved over) their nodes
+pid_t launch(const Run& run, const std::vector<size_t>& placement,
+             const std::vector<BenchUtils::PhysicalCore>& physicalCores, bool smt, bool numa){
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  unsigned long nodeMask = 0;
+  for (size_t c : placement) {
+    const auto& core = physicalCores[c];
+    for (size_t s = 0; s < (smt ? core.cpus.size() : 1); s++)
+      CPU_SET(core.cpus[s], &cpus);
+    nodeMask |= 1ul << core.node;
+  }
+  const bool singleNode = (nodeMask & (nodeMask - 1)) == 0;
+
+  // Any buffered output would otherwise be written by the child too
+  fflush(nullptr);
+  const pid_t pid = fork();
+  if (pid < 0)
+    throw std::runtime_error("Cannot fork run");
+  else if (pid == 0) {
+    // Own process group, so a timeout can kill e.g. mpirun and all its ranks
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+
+    if (chdir(run.rundir.c_str()) != 0) _exit(127);
+    const int output = open("output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output >= 0) {
+      dup2(output, STDOUT_FILENO);
+      dup2(output, STDERR_FILENO);
+      close(output);
+    }
+
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpus) != 0) _exit(127);
+    if (numa && syscall(SYS_set_mempolicy, singleNode ? MPOL_BIND : MPOL_INTERLEAVE,
+                        &nodeMask, sizeof(nodeMask) * CHAR_BIT) != 0) {
+      _exit(127);
+    }
+    execl("/bin/sh", "sh", "-c", run.command.c_str(), (char*)nullptr);
+    _exit(127);
+  }
+  setpgid(pid, pid);
+  return(pid);
+}
+
+double mean(const std::vector<double>& values){
+  double sum = 0.0;
+  for (double v : values) sum += v;
+  return(values.empty() ? NAN : sum / values.size());
+}
+
+double stddev(const std::vector<double>& values){
+  if (values.size() < 2) return(0.0);
+  const double m = mean(values);
+  double sum = 0.0;
+  for (double v : values) sum += (v - m) * (v - m);
+  return(std::sqrt(sum / (values.size() - 1)));
+}
+
+std::string quote_csv(const std::string& s){
+  if (s.find_first_of(",\"") == std::string::npos && !s.empty()) return(s);
+  std::string quoted = "\"";
+  for (char c : s) quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+  return(quoted + "\"");
+}
+
+int main (int argc, char *argv[]){
+  // Getting options:
+  double memoryBudgetMB = 0.0;
+  std::string cpuList;
+  bool smt = false;
+  bool dryRun = false;
+  const char* const short_opts = "";
+  const option long_opts[] = {
+    {"memory_budget", 1, nullptr, 0},
+    {"cpus", 1, nullptr, 1},
+    {"smt", 0, nullptr, 2},
+    {"dry_run", 0, nullptr, 3},
+    {nullptr, 0, nullptr, 0}
+  };
+  // Check the set of options
+  while (true) {
+    const auto opt = getopt_long(argc, argv, short_opts, long_opts, nullptr);
+
+    // If none
+    if (-1 == opt) break;
+
+    switch (opt){
+      case 0:
+        printf("Memory budget: %sMB\n", optarg);
+        memoryBudgetMB = std::stod(optarg);
+        break;
+      case 1:
+        printf("Using CPUs: %s\n", optarg);
+        cpuList = optarg;
+        break;
+      case 2:
+        printf("Runs also use the SMT siblings of their cores\n");
+        smt = true;
+        break;
+      case 3:
+        printf("Dry run - showing the schedule only\n");
+        dryRun = true;
+        break;
+      default:
+        return(-1);
+    }
+  };
+  if (optind != argc - 1) {
+    printf("Usage: %s [--memory_budget MB] [--cpus LIST] [--smt] [--dry_run] GRID\n", argv[0]);
+    return(-1);
+  }
+
+  try {
+    const Grid grid = load_grid(argv[optind]);
+
+    // Restrict ourselves (and so the topology) to the requested CPUs
+    if (!cpuList.empty()) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      for (unsigned int c : BenchUtils::parseCPUList(cpuList)) CPU_SET(c, &cpus);
+      if (sched_setaffinity(0, sizeof(cpu_set_t), &cpus) != 0)
+        throw std::runtime_error("Cannot use CPUs " + cpuList);
+    }
+    const std::vector<BenchUtils::PhysicalCore> physicalCores = BenchUtils::getPhysicalCores();
+    std::map<unsigned int, unsigned int> nodeSizes;
+    for (const auto& c : physicalCores) nodeSizes[c.node]++;
+    const bool numa = (nodeSizes.size() > 1);
+    printf("%zu physical cores on %zu NUMA node(s)\n", physicalCores.size(), nodeSizes.size());
+
+    size_t memoryBudget = (size_t)(memoryBudgetMB * 1024.0 * 1024.0);
+    if (memoryBudget == 0) {
+      memoryBudget = BenchUtils::getProcFieldBytes("/proc/meminfo", "MemAvailable");
+      printf("Memory budget: %.0fMB (currently available)\n", (double)memoryBudget / (1024.0 * 1024.0));
+    }
+
+    // Expand the grid, first parameter varying slowest
+    std::vector<Config> configs(1);
+    for (const auto& p : grid.params) {
+      std::vector<Config> expanded;
+      for (const auto& c : configs) {
+        for (const auto& v : p.second) {
+          expanded.push_back(c);
+          expanded.back().values[p.first] = v;
+        }
+      }
+      configs.swap(expanded);
+    }
+
+    std::vector<Run> runs;
+    for (size_t c = 0; c < configs.size(); c++) {
+      auto values = configs[c].values;
+      values["root"] = grid.root;
+      configs[c].cores = (unsigned int)evaluate_product(substitute(grid.cores, values));
+      configs[c].memory = (size_t)(evaluate_product(substitute(grid.memory, values)) * 1024.0 * 1024.0);
+      if (configs[c].cores == 0 || configs[c].cores > physicalCores.size())
+        throw std::runtime_error("Configuration " + std::to_string(c) + " needs " + std::to_string(configs[c].cores)
+                                 + " cores but " + std::to_string(physicalCores.size()) + " are available");
+      if (configs[c].memory > memoryBudget)
+        throw std::runtime_error("Configuration " + std::to_string(c) + " needs more memory than the budget");
+
+      for (unsigned int r = 0; r < grid.repeat; r++) {
+        char runName[16];
+        snprintf(runName, sizeof(runName), "%04zu", runs.size());
+        values["run"] = runName;
+        values["repeat"] = std::to_string(r);
+        Run run;
+        run.config = c;
+        run.repeat = r;
+        run.rundir = substitute(grid.rundir, values);
+        run.command = substitute(grid.command, values);
+        runs.push_back(run);
+      }
+    }
+    printf("%zu configurations, %zu runs\n", configs.size(), runs.size());
+
+    // Configurations without a memory estimate first, as their first runs are
+    // probes which run alone, then the biggest runs, so they are not left
+    // waiting for the whole machine at the end
+    std::deque<size_t> pending;
+    for (size_t r = 0; r < runs.size(); r++) pending.push_back(r);
+    std::stable_sort(pending.begin(), pending.end(),
+                     [&](size_t a, size_t b){
+                       const Config& ca = configs[runs[a].config];
+                       const Config& cb = configs[runs[b].config];
+                       if ((ca.memory == 0) != (cb.memory == 0)) return (ca.memory == 0);
+                       return (ca.cores == cb.cores) ? (ca.memory > cb.memory) : (ca.cores > cb.cores);
+                     });
+
+    if (dryRun) {
+      for (size_t r : pending) {
+        const Config& config = configs[runs[r].config];
+        const std::string memory = (config.memory == 0) ? std::string("unknown memory")
+          : std::to_string((long long)std::llround((double)config.memory / (1024.0 * 1024.0))) + "MB";
+        printf("Run %04zu: %u core(s), %s in %s: %s\n", r, config.cores, memory.c_str(),
+               runs[r].rundir.c_str(), runs[r].command.c_str());
+      }
+      return(0);
+    }
+
+    // Runs are in their own process groups, so pass Ctrl-C on ourselves
+    signal(SIGINT, handle_interrupt);
+    signal(SIGTERM, handle_interrupt);
+
+    std::vector<bool> coreUsed(physicalCores.size(), false);
+    size_t memoryUsed = 0;
+    std::vector<Slot> running;
+    RunningGuard runningGuard{running};
+    const auto sweepStart = std::chrono::steady_clock::now();
+    while (!pending.empty() || !running.empty()) {
+      if (interrupted) {
+        printf("Interrupted\n");
+        return(-1);
+      }
+
+      // Start every pending run which fits. A run of a configuration whose
+      // memory is not yet known reserves the whole budget, so it runs alone
+      // and its peak RSS becomes the estimate for the configuration's other runs
+      for (auto p = pending.begin(); p != pending.end();) {
+        const Run& run = runs[*p];
+        Config& config = configs[run.config];
+        const bool probe = (config.memory == 0);
+        const size_t memory = probe ? memoryBudget : config.memory;
+        std::vector<size_t> placement;
+        if ((probe && config.probing) || memoryUsed + memory > memoryBudget
+            || !place(config.cores, physicalCores, coreUsed, placement)) {
+          ++p;
+          continue;
+        }
+
+        make_directories(run.rundir);
+        unlink((run.rundir + "/" + grid.result).c_str());
+
+        Slot slot;
+        slot.pid = launch(run, placement, physicalCores, smt, numa);
+        slot.run = *p;
+        slot.cores = placement;
+        slot.memory = memory;
+        slot.start = std::chrono::steady_clock::now();
+        for (size_t c : placement) coreUsed[c] = true;
+        memoryUsed += memory;
+        config.probing = probe;
+        running.push_back(slot);
+        p = pending.erase(p);
+      }
+      if (running.empty())
+        throw std::runtime_error("Pending runs can never be scheduled");
+
+      // Wait for a run to finish, killing any which overrun
+      int status;
+      rusage usage;
+      const pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+      if (pid == 0 || (pid < 0 && errno == EINTR)) {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& s : running) {
+          if (grid.timeout > 0.0 && !s.timedOut
+              && std::chrono::duration<double>(now - s.start).count() > grid.timeout) {
+            kill(-s.pid, SIGKILL);
+            s.timedOut = true;
+          }
+        }
+        usleep(20000);
+        continue;
+      }
+      else if (pid < 0) {
+        throw std::runtime_error("Cannot wait for runs");
+      }
+
+      const auto slot = std::find_if(running.begin(), running.end(), [pid](const Slot& s){ return s.pid == pid; });
+      if (slot == running.end()) continue;
+      const double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - slot->start).count();
+      Run& run = runs[slot->run];
+      Config& config = configs[run.config];
+      run.attempts++;
+      config.numAttempts++;
+
+      // ru_maxrss covers the run's largest process, in kB
+      const size_t peakRSS = (size_t)usage.ru_maxrss * 1024;
+      std::vector<unsigned int> cpus;
+      for (size_t c : slot->cores) cpus.push_back(physicalCores[c].cpus.front());
+
+      double result;
+      std::string outcome;
+      if (slot->timedOut) outcome = "timed out";
+      else if (WIFSIGNALED(status)) outcome = "killed by signal " + std::to_string(WTERMSIG(status));
+      else if (WEXITSTATUS(status) != 0) outcome = "exited with status " + std::to_string(WEXITSTATUS(status));
+      else if (!read_result(run.rundir + "/" + grid.result, result)) outcome = "wrote no result";
+
+      for (size_t c : slot->cores) coreUsed[c] = false;
+      memoryUsed -= slot->memory;
+      config.probing = false;
+      const size_t runIndex = slot->run;
+      running.erase(slot);
+
+      if (outcome.empty()) {
+        config.results.push_back(result);
+        config.wallTimes.push_back(wallTime);
+        config.peakRSS = std::max(config.peakRSS, peakRSS);
+
+        // Later repeats reserve what this one actually used
+        config.memory = std::max(config.memory, std::min(peakRSS, memoryBudget));
+        printf("Run %04zu on CPUs %s: %g in %.1fs, peak RSS %.0fMB\n", runIndex,
+               BenchUtils::formatCPUList(cpus).c_str(), result, wallTime, (double)peakRSS / (1024.0 * 1024.0));
+      }
+      else if (run.attempts <= grid.retries) {
+        printf("Run %04zu on CPUs %s %s, retrying (see %s/output.txt)\n", runIndex,
+               BenchUtils::formatCPUList(cpus).c_str(), outcome.c_str(), run.rundir.c_str());
+        pending.push_front(runIndex);
+      }
+      else {
+        printf("Run %04zu on CPUs %s %s after %u attempts (see %s/output.txt)\n", runIndex,
+               BenchUtils::formatCPUList(cpus).c_str(), outcome.c_str(), run.attempts, run.rundir.c_str());
+        config.numFailed++;
+      }
+    }
+    printf("Sweep took %.1fs\n", std::chrono::duration<double>(std::chrono::steady_clock::now() - sweepStart).count());
+
+    // Aggregate into one table, one row per configuration
+    std::map<std::string, std::string> rootValues = {{"root", grid.root}};
+    const std::string tableFilename = substitute(grid.table, rootValues);
+    std::ofstream table(tableFilename);
+    table << std::setprecision(10);
+    for (const auto& p : grid.params) table << quote_csv(p.first) << ",";
+    table << "Runs,Failed,Attempts,Result mean,Result min,Result stddev,Wall time mean [s],Peak RSS [MB]" << std::endl;
+
+    unsigned int numFailed = 0;
+    for (const auto& c : configs) {
+      for (const auto& p : grid.params) table << quote_csv(c.values.at(p.first)) << ",";
+      const double minResult = c.results.empty() ? NAN : *std::min_element(c.results.begin(), c.results.end());
+      table << c.results.size() << "," << c.numFailed << "," << c.numAttempts << ","
+            << mean(c.results) << "," << minResult << "," << stddev(c.results) << ","
+            << mean(c.wallTimes) << "," << (double)c.peakRSS / (1024.0 * 1024.0) << std::endl;
+      numFailed += c.numFailed;
+
+      if (!grid.collect.empty() && !c.results.empty()) {
+        auto values = c.values;
+        values["root"] = grid.root;
+        const std::string collectFilename = substitute(grid.collect, values);
+        make_directories(collectFilename.substr(0, collectFilename.rfind('/')));
+        std::ofstream collect(collectFilename);
+        collect << std::setprecision(10) << mean(c.results);
+      }
+    }
+    printf("Results written to %s\n", tableFilename.c_str());
+    if (numFailed > 0) {
+      printf("%u runs failed\n", numFailed);
+      return(-1);
+    }
+  } catch (const std::exception& e) {
+    printf("%s\n", e.what());
+    return(-1);
+  }
+  return(0);
+}
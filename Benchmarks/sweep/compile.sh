@@ -0,0 +1,13 @@
+# Make a Build directory
+mkdir -p Build
+cd ./Build
+
+# Now run cmake init
+cmake ../
+
+# Finally compile the sweep driver
+make Sweep -j8
+
+# In order to run a sweep;
+# ./Sweep ../../VogelsAbbott/_results/scalingspeed/cpu.sweep
+# ./Sweep --dry_run ../../Brunel/_results/auryn_multithreaded/auryn.sweep